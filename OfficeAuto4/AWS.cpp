@@ -1,20 +1,24 @@
 // aws.cpp
 #include "aws.h"
+#include "profiler.h"
+#include "frames.h"
+#include "credentials.h"
+#include "metrics.h"
+
+// the session is a plain struct of BearSSL parameters (session id, cipher suite, master secret), copied as it is
+static_assert (sizeof(BearSSL::Session) <= 4*31, "the TLS session does not fit its RTC slot");
 
-void callback(char* topic, byte* payload, unsigned int length); // forward declaration
 // external callback function defined in the main .ino:
 extern void notify_command (const char* command);
 extern void notify_get_param (const char* param);
 extern void notify_set_param (const char* param, const char *value);
+extern void notify_batch (const char* const* commands, short count);
+extern void notify_ack (unsigned short seq);
 
 // Defining the following objects within the AWS class results in errors; possibly clash among similar libraries
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP, "pool.ntp.org", 55*360);  // UTC offset=5.5 hours * 3600 seconds
 WiFiClientSecure espClient;
 PubSubClient client(AWS_END_POINT, MQTT_PORT, callback, espClient); //set  MQTT port number to 8883 as per standard  
-
-char command_str[MAX_COMMAND_LENGTH];
-char value_str[MAX_LONG_STRING_LENGTH];
+Credentials credentials;  // parsed once, and kept for all the reconnections
 
 // MQTT callback
 // no need for the static keyword in the function definition, if it is part of the AWS class
@@ -26,260 +30,296 @@ void callback(char* topic, byte* payload, unsigned int length) {
     SERIAL_PRINTLN(F("]: "));
     SERIAL_PRINT(F("Length: "));
     SERIAL_PRINTLN(length);  
-    // long messages are anyway dropped by PubSubClient !
-    //if (length > MAX_MSG_LENGTH) return;  // MAX_MSG_LENGTH refers to the full json formatted payload
     /**/
-    for (int i = 0; i < length; i++) 
+    for (unsigned int i = 0; i < length; i++) 
         SERIAL_PRINT((char)payload[i]);
     SERIAL_PRINTLN();
     /**/
-    //SERIAL_PRINTLN ((char *)payload); // this prints a corrupted string ! TODO: study this further
+    //SERIAL_PRINTLN ((char *)payload); // this prints a corrupted string: the payload is not null terminated
 #endif
-  
-    StaticJsonDocument<MAX_MSG_LENGTH> doc;  // stack
-    //DynamicJsonDocument doc(MAX_MSG_LENGTH);   // heap
-    DeserializationError error = deserializeJson(doc, (char *)payload); //  
+    // PubSubClient drops packets larger than its own buffer; this guards against the rest, before any parsing.
+    // The payload is not null terminated, so nothing may read beyond length.
+    metrics.note_rx();
+    if (length > MAX_MSG_LENGTH) {  // MAX_MSG_LENGTH refers to the full json formatted payload
+        prof.rejected_messages++;
+        metrics.rx_dropped++;
+        SERIAL_PRINTLN(F("--- Message too long; rejected ---"));
+        return;
+    }
+    if (is_binary_frame(payload, length)) {  // see frames.h
+        handle_frame(payload, length);
+        return;
+    }
+    StaticJsonDocument<JSON_PARSE_DOC_SIZE> doc;  // stack
+    prof.begin_parse();
+#ifdef COPYING_JSON_PARSE
+    DeserializationError error = deserializeJson(doc, (const char *)payload, length); // strings are copied into doc
+#else
+    // zero copy: ArduinoJson unescapes and null terminates the strings inside the payload, and doc points to them.
+    // So the pointers below are valid only till this function returns; the command queue keeps its own copy.
+    DeserializationError error = deserializeJson(doc, (char *)payload, length);
+#endif
+    prof.end_parse();
     if (error) {
       SERIAL_PRINT(F("Json deserialization failed: "));
       SERIAL_PRINTLN(error.c_str());
       return;
     }
+    dispatch_message(doc);
+}
+
+// a parsed json message, short (from the callback) or long (from the assembler, in the main loop)
+void dispatch_message (JsonDocument& doc) {
+    if (doc.containsKey("E")) {  // our own echo, back from the broker: {"E":millis}
+        metrics.note_echo(doc["E"].as<unsigned long>());
+        return;
+    }
+    if (doc.containsKey("K")) {  // the cloud acknowledges an event: {"K":12}
+        notify_ack(doc["K"].as<unsigned short>());
+        return;
+    }
     if (doc.containsKey("G")) {  // get parameter
-        safe_strncpy (command_str, doc["G"], MAX_COMMAND_LENGTH);
-        if (strlen(command_str) > 0) 
-            notify_get_param((const char*)command_str);          
+        const char* param = doc["G"];
+        if (param != NULL && param[0] != '\0') 
+            notify_get_param(param);          
         return;
     }    
     if (doc.containsKey("S")) {  // set parameter
-        safe_strncpy (command_str, doc["S"]["P"], MAX_COMMAND_LENGTH);
-        safe_strncpy (value_str, doc["S"]["V"], MAX_LONG_STRING_LENGTH);
-        if (strlen(command_str) > 0) 
-            notify_set_param((const char*)command_str, (const char*)value_str);        
+        const char* param = doc["S"]["P"];
+        const char* value = doc["S"]["V"];
+        if (param != NULL && param[0] != '\0') 
+            notify_set_param(param, (value==NULL) ? "" : value);        
         return;
     }
     if (!doc.containsKey("C")) { // TODO: Now only the "C" key is allowed. Provide other possible keys also.
       SERIAL_PRINTLN(F("invalid command"));
       return;
     }
-    //const char* cmd = doc["C"];  // do not hold on to the jsondoc object for long!
-    safe_strncpy (command_str, doc["C"], MAX_COMMAND_LENGTH); // COMMAND_LENGTH is for the inner string, without json formatting artifacts.
-    if (strlen(command_str) > 0) 
-       notify_command((const char*)command_str); // notify_command() is defined in the main .ino file
+    if (doc["C"].is<JsonArray>()) {  // batch of commands: {"C":["ON0","ON1","STA"]}
+        JsonArray list = doc["C"].as<JsonArray>();
+        const char* commands[MAX_BATCH_COMMANDS];
+        short count = 0;
+        for (JsonVariant item : list) {
+            const char* c = item.as<const char*>();
+            if (c == NULL || c[0] == '\0')
+                continue;
+            if (count >= MAX_BATCH_COMMANDS) {  // a long message can carry more; they go in successive batches
+                notify_batch(commands, count);
+                count = 0;
+            }
+            commands[count++] = c;
+        }
+        if (count > 0)
+            notify_batch(commands, count);
+        return;
+    }
+    const char* command = doc["C"];  // do not hold on to the jsondoc object for long!
+    if (command != NULL && command[0] != '\0') 
+       notify_command(command); // notify_command() is defined in the main .ino file
 }
 //------------------------------------------------------------------------------------------------
 AWS::AWS() {
   ////SERIAL_PRINTLN(F("AWS object created.")); there is no serial port when this object is created!
 }
 
-short AWS::init(Config *configptr) {
-   return (init(configptr, false));
+short AWS::init(Config *configptr, TimeManager *timeptr) {
+   return (init(configptr, timeptr, false));
 }
 
-short AWS::init(Config *configptr, bool restart) {
+short AWS::init(Config *configptr, TimeManager *timeptr, bool restart) {
   this->pC = configptr;
+  this->pTime = timeptr;
   this->restart = restart;
-  if (!init_time_client())       // first initialize time client, then load certificates:    
-      return TIME_SERVER_FAILED; // it can at least work as a time based automatic relay
+  bool time_valid = init_time_client();  // does not wait for the time server
+  if (time_valid)
+      prof.mark_boot(BOOT_TIME);
   if (!init_file_system())  
       return TLS_CERTIFICATE_FAILED;  
+  prof.mark_boot(BOOT_CERTS);
+  espClient.setTimeout(CONNECT_TIMEOUT);
+  session_cached = rtc_load(RTC_SLOT_TLS, &tls_session, sizeof(tls_session));  // left by the last boot, if it was a soft reset
+  SERIAL_PRINTLN(session_cached ? F("TLS session found in RTC memory.") : F("No TLS session in RTC memory."));
+  espClient.setSession(&tls_session);  // the client offers it, and updates it after every handshake
   // NOTE: without a time server, you cannot connect to AWS. You get the message:
   // "WiFiClientSecure SSL error: Certificate is expired or not yet valid".
-  bool mqtt_connection_result = reconnect(); //  priming connection to MQTT
-  if (!mqtt_connection_result)
+  if (!time_valid) {
+      link = LINK_WAITING_TIME;  // update() makes the first attempt; meanwhile it works as a time/light based relay
+      return TIME_SERVER_FAILED;
+  }
+  //  priming connection to MQTT; only one attempt, the caller retries later (repair_comm)
+  if (!try_connect()) {
+      schedule_retry();
       return AWS_CONNECT_FAILED;
+  }
+  announce_and_subscribe();
+  prof.mark_boot(BOOT_MQTT);
   return AWS_CONNECT_SUCCESS;
 }
 
+// AWS checks the dates of the certificates; so the clock must be valid before connecting. After a soft reset
+// the clock is carried over in RTC memory. After a power on, TimeManager::update() asks the time server in the
+// background; this does not wait for the answer: the loop keeps running, and update() connects once it comes.
 bool AWS::init_time_client() {
-    SERIAL_PRINTLN(F("Connecting to Time Server..."));
-    timeClient.begin();
-    while(!timeClient.update()){
-      timeClient.forceUpdate();
-      SERIAL_PRINT(F("-"));
-      delay(100);  // this is very small, but update() or forceUpdate() takes long time to return
-      time_attempts++;
-      if (time_attempts > MAX_TIME_ATTEMPTS) {
-        if (restart) {
-            SERIAL_PRINTLN(F("\n*** Failed to initialize time server client. Restarting..."));
-            delay(2000);
-            ESP.restart();
-        }
-        else {
-            SERIAL_PRINTLN(F("\n*** Failed to initialize time server client! ***"));
-            delay(1000);
-            return (false);
-        }
-      }
-    }
-    SERIAL_PRINTLN(F("\nTime server client initialized."));
-    delay(1000); // delay is needed to stablize ?
-    get_current_time();
     espClient.setBufferSizes(512, 512);  // TODO: find another suitable place to put this  
-    espClient.setX509Time(timeClient.getEpochTime());  
-    delay(1000); // delay is needed to stablize ?
+    if (!pTime->is_valid()) {
+        SERIAL_PRINTLN(F("*** Time is not valid yet; AWS will connect when the time server answers ***"));
+        return (false);
+    }
+    SERIAL_PRINTLN(F("Time is valid."));
+    espClient.setX509Time(pTime->get_epoch());  
     return (true);
 }  
 
+// mounts the file system (once), and loads the TLS credentials into RAM (once); see credentials.h
 bool AWS::init_file_system() {
-    bool result = true;
-    SERIAL_PRINTLN(F("Mounting the file system.."));
-    print_heap();
-    if (!SPIFFS.begin()) {
-        SERIAL_PRINTLN(F("--- Failed to mount file system. ---"));
+    if (!credentials.load())
         return false;
-    }
-    SERIAL_PRINTLN(F("File system mounted."));
-    print_heap(); 
-    // Load certificate file
-    File cert = SPIFFS.open("/cert.der", "r"); //replace cert.crt eith your uploaded file name
-    if (!cert) {
-      SERIAL_PRINTLN(F("--- Failed to open certificate file. ---"));
-      result = false;
-    }
-    else
-      SERIAL_PRINT(F("Opened device certificate.."));
-    delay(1000); // the delay seems to be necessary ?! it is from the original example
-    if (espClient.loadCertificate(cert))
-        SERIAL_PRINTLN(F("Loaded certificate."));
-    else {
-        SERIAL_PRINTLN(F("---- Device cert could not be loaded. ---"));
-        result = false;
-    }
-    File private_key = SPIFFS.open("/private.der", "r"); //replace private eith your uploaded file name
-    if (!private_key) {
-        SERIAL_PRINTLN(F("--- Failed to open private key file. ---"));
-      result = false;
-    }        
-    else
-        SERIAL_PRINT(F("Opened private key.."));
-    delay(1000); // the delay seems to be necessary ?!
-    if (espClient.loadPrivateKey(private_key))
-        SERIAL_PRINTLN(F("Loaded private key."));
-    else {
-        SERIAL_PRINTLN(F("--- Private key could not be loaded. ---"));
-        result = false;
-    }        
-    // Load CA file
-    File ca = SPIFFS.open("/ca.der", "r"); //replace ca eith your uploaded file name
-    if (!ca) {
-        SERIAL_PRINTLN(F("--- Failed to open root CA. ---"));
-        result = false;
-    }        
-    else
-        SERIAL_PRINT(F("Opened root CA..."));
-    delay(1000); // is this a necessary delay ?
-    if(espClient.loadCACert(ca))
-        SERIAL_PRINTLN(F("Loaded root CA."));
-    else {
-        SERIAL_PRINTLN(F("--- Failed to load root CA. ---"));
-        result = false;
-    }        
-    print_heap();
-    return (result);
+    credentials.apply(&espClient);
+    return true;
 }
 
 // Ensure to call this update() method in your main loop. Otherwise MQTT will starve of CPU
 // we assume WiFi is available. The caller (main loop) has to ensure that, and restart wifi if needed
+// While the client is disconnected, every call is one step of the reconnect state machine: it returns at once
+// during the back off, and makes at most one connection attempt (bounded by CONNECT_TIMEOUT) otherwise.
+// So the timers and the motion logic keep running through a broker outage, and while the time server is awaited.
 void AWS::update() {
-  if (!client.connected()) {
-     SERIAL_PRINTLN(F("AWS loop: client is not connected."));
-     yield();
-     delay(5000);  // to avoid repeated triggers ?
-     reconnect();   
+  if (client.connected()) {
+      if (link == LINK_SUBSCRIBING) 
+          announce_and_subscribe();  // in a step of its own, after the connection step
+      client.loop();
+      return;
   }
-  client.loop();
+  switch (link) {
+      case LINK_UP:
+      case LINK_SUBSCRIBING:
+          SERIAL_PRINTLN(F("AWS loop: client is not connected."));
+          disconnections++;
+          connection_attempts = 0;
+          schedule_retry();
+          break;
+      case LINK_BACKOFF:
+          if (millis() - backoff_start < backoff_ms)
+              break;
+          if (try_connect()) {
+              link = LINK_SUBSCRIBING;
+              break;
+          }
+          if (connection_attempts > MAX_CONNECTION_ATTEMPTS && restart) {
+              SERIAL_PRINTLN(F("*** Failed to connect to AWS! Restarting... ***"));
+              delay(2000);
+              ESP.restart();
+          }
+          schedule_retry();
+          break;
+      case LINK_WAITING_TIME:
+          if (!pTime->is_valid())
+              break;
+          SERIAL_PRINTLN(F("Time is valid; connecting to AWS.."));
+          backoff_ms = 0;  // the first attempt, in the next step
+          backoff_start = millis();
+          link = LINK_BACKOFF;
+          break;
+  }
+}
+
+// exponential back off with random jitter: the wait is between half and all of BACKOFF_MIN * 2^failures
+void AWS::schedule_retry() {
+    unsigned long ceiling = BACKOFF_MIN;
+    for (int i=0; i<connection_attempts && ceiling < BACKOFF_MAX; i++)
+        ceiling *= 2;
+    if (ceiling > BACKOFF_MAX)
+        ceiling = BACKOFF_MAX;
+    backoff_ms = ceiling/2 + ESP.random() % (ceiling/2 + 1);
+    backoff_start = millis();
+    link = LINK_BACKOFF;
+    SERIAL_PRINT(F("Next AWS connection attempt in (mSec): "));
+    SERIAL_PRINTLN(backoff_ms);
+}
+
+// a single connection attempt; returns true if connected
+bool AWS::try_connect() {
+    SERIAL_PRINTLN(F("Attempting MQTT connection..."));
+    // Generate random client ID. otherwise it keeps connecting & disconnecting !!!
+    // see  https://github.com/mqttjs/MQTT.js/issues/684 for client id collision problem, and  
+    // https://www.cloudmqtt.com/blog/2018-11-21-mqtt-what-is-client-id.html      
+    char client_id[MAX_CLIENT_ID_LENGTH]; // MQTT standard allows max 23 characters for client id
+    //snprintf (client_id, MAX_CLIENT_ID_LENGTH-1, "%s%x%x",pC->mqtt_client_prefix,random(0xffff), random(0xffff));
+    snprintf (client_id, MAX_CLIENT_ID_LENGTH-1, "%s_%s",pC->mqtt_client_prefix, pC->mac_address);
+    SERIAL_PRINT(F("client ID: "));
+    SERIAL_PRINTLN(client_id);
+    WiFi.mode(WIFI_STA);  // see https://github.com/knolleary/pubsubclient/issues/138 
+                          // improves stability
+    espClient.setX509Time(pTime->get_epoch());  // the local clock; kept by TimeManager
+    BearSSL::Session offered = tls_session;  // a resumed session comes back unchanged; a full handshake makes a new one
+    unsigned long start = millis();
+    if (client.connect(client_id)) {  
+        unsigned long elapsed = millis() - start;
+        bool resumed = session_cached && memcmp(&offered, &tls_session, sizeof(tls_session)) == 0;
+        handshake_stats* hs = resumed ? &resumed_handshakes : &full_handshakes;
+        hs->count++;
+        hs->total_ms += elapsed;
+        hs->last_ms = elapsed;
+        last_handshake_ms = elapsed;
+        SERIAL_PRINT(resumed ? F("connected to AWS cloud (TLS session resumed), mSec: ") : F("connected to AWS cloud, mSec: "));
+        SERIAL_PRINTLN(elapsed);
+        session_cached = rtc_save(RTC_SLOT_TLS, &tls_session, sizeof(tls_session));
+        connection_attempts = 0;
+        return (true);
+    }
+    SERIAL_PRINT(F("AWS connection failed, rc="));
+    SERIAL_PRINTLN(client.state());
+    char buf[256];
+    int ssl_error = espClient.getLastSSLError(buf,256);
+    if (ssl_error != 0) {
+        tls_errors++;
+        last_ssl_error = ssl_error;
+    }
+    SERIAL_PRINT(F("WiFiClientSecure SSL error: "));
+    SERIAL_PRINTLN(buf);
+    connection_attempts++;
+    failed_attempts++;
+    return (false);
 }
 
-bool AWS::reconnect() {
-    SERIAL_PRINTLN(F("\n(Re)connecting to AWS..."));  
+void AWS::announce_and_subscribe() {
     char  priming_msg[MAX_SHORT_STRING_LENGTH];
     snprintf (priming_msg, MAX_SHORT_STRING_LENGTH-1, "{\"B\":\"%s [%s] V 2.%d starting..\"}", 
               pC->app_name, pC->mac_address, pC->current_firmware_version);
-    // block until we're reconnected to AWS server/times out
-    while (!client.connected()) {
-        SERIAL_PRINTLN(F("Attempting MQTT connection..."));
-        // Generate random client ID. otherwise it keeps connecting & disconnecting !!!
-        // see  https://github.com/mqttjs/MQTT.js/issues/684 for client id collision problem, and  
-        // https://www.cloudmqtt.com/blog/2018-11-21-mqtt-what-is-client-id.html      
-        char client_id[MAX_CLIENT_ID_LENGTH]; // MQTT standard allows max 23 characters for client id
-        //snprintf (client_id, MAX_CLIENT_ID_LENGTH-1, "%s%x%x",pC->mqtt_client_prefix,random(0xffff), random(0xffff));
-        snprintf (client_id, MAX_CLIENT_ID_LENGTH-1, "%s_%s",pC->mqtt_client_prefix, pC->mac_address);
-        SERIAL_PRINT(F("client ID: "));
-        SERIAL_PRINTLN(client_id);
-        WiFi.mode(WIFI_STA);  // see https://github.com/knolleary/pubsubclient/issues/138 
-                              // improves stability
-        if (client.connect(client_id)) {  
-          SERIAL_PRINTLN(F("connected to AWS cloud."));
-          // Once connected, publish an announcement...
-          SERIAL_PRINT(F("Publishing to "));
-          SERIAL_PRINT (pC->mqtt_pub_topic);
-          SERIAL_PRINTLN(F(" : "));
-          SERIAL_PRINTLN(priming_msg);
-          client.publish(pC->mqtt_pub_topic, priming_msg);
-          // ... and resubscribe
-          client.subscribe(pC->mqtt_sub_topic);
-          SERIAL_PRINT(F("Subscribed to: "));
-          SERIAL_PRINTLN(pC->mqtt_sub_topic);
-          client.subscribe(pC->mqtt_broadcast_topic);          
-          SERIAL_PRINT(F("Subscribed to (broadcast): "));
-          SERIAL_PRINTLN(pC->mqtt_broadcast_topic);
-        } else {
-          SERIAL_PRINT(F("AWS connection failed, rc="));
-          SERIAL_PRINTLN(client.state());
-          SERIAL_PRINTLN(F("Trying again in 30 seconds..."));
-          char buf[256];
-          espClient.getLastSSLError(buf,256);
-          SERIAL_PRINT(F("WiFiClientSecure SSL error: "));
-          SERIAL_PRINTLN(buf);
-          connection_attempts++;
-          if (connection_attempts > MAX_CONNECTION_ATTEMPTS) {
-              if (restart) {
-                SERIAL_PRINTLN(F("*** Failed to connect to AWS! Restarting... ***"));
-                delay(2000);
-                ESP.restart();
-              } else {
-                SERIAL_PRINTLN(F("*** Failed to connect to AWS! ***"));
-                return (false);
-              }
-           } // max attempts exceeded         
-          // Wait 30 seconds before retrying; TODO: revisit all the timings & reconnect logic
-          delay(RETRY_DELAY);
-        } // else
-    } // while
-    return (true);
+    // Once connected, publish an announcement... but not on the first connection: the boot event 
+    // is already waiting in the outbox (see Main.ino), and goes out from there
+    if (full_handshakes.count + resumed_handshakes.count > 1) {
+        SERIAL_PRINT(F("Publishing to "));
+        SERIAL_PRINT (pC->mqtt_pub_topic);
+        SERIAL_PRINTLN(F(" : "));
+        SERIAL_PRINTLN(priming_msg);
+        client.publish(pC->mqtt_pub_topic, priming_msg);
+    }
+    // ... and resubscribe
+    client.subscribe(pC->mqtt_sub_topic);
+    SERIAL_PRINT(F("Subscribed to: "));
+    SERIAL_PRINTLN(pC->mqtt_sub_topic);
+    client.subscribe(pC->mqtt_broadcast_topic);          
+    SERIAL_PRINT(F("Subscribed to (broadcast): "));
+    SERIAL_PRINTLN(pC->mqtt_broadcast_topic);
+    link = LINK_UP;
 }
 
-PubSubClient* AWS::getPubSubClient() {
-    return (&client);  // any one can use the pointer to publish messages
+bool AWS::is_session_cached() {
+    return session_cached;
 }
 
-// Time related utilities:
-// The AWS class is the custodian of Time Server connection (TODO: create a separate TimeManager class)
-// This updates global hour and minute variables  
-void AWS::get_current_time() {
-    current_hour = -1;  // to detect time server failure
-    current_minute = -1;
-    current_hour = timeClient.getHours();  
-    current_minute = timeClient.getMinutes();
-    //SERIAL_PRINT(F("Time: "));
-    //SERIAL_PRINTLN(timeClient.getFormattedTime());    
+// the next connection makes a full handshake; for comparing the timings
+void AWS::clear_tls_session() {
+    tls_session = BearSSL::Session();
+    session_cached = false;
+    rtc_clear(RTC_SLOT_TLS);
 }
 
-// The output is ternary: day,night,unknown
-// this is called every 10 minutes and switch the primary light on schedule
-short AWS::is_night_time() {  
-    get_current_time();
-    if (current_hour < 0 || current_minute < 0) {   
-      SERIAL_PRINTLN(F("Could not get time from Time Server"));
-      return TIME_UNKNOWN;
-    }
-    if (current_hour > pC->night_start_hour  || current_hour < pC->night_end_hour) 
-        return TIME_NIGHT;
-    if (current_hour == pC->night_start_hour && current_minute >= pC->night_start_minute)  
-        return TIME_NIGHT;        
-    if (current_hour == pC->night_end_hour && current_minute <= pC->night_end_minute)  
-        return TIME_NIGHT;
-    return TIME_DAY;
+byte AWS::get_link_state() {
+    return link;
 }
 
- 
+PubSubClient* AWS::getPubSubClient() {
+    return (&client);  // any one can use the pointer to publish messages
+}
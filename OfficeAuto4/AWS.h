@@ -5,42 +5,77 @@
 #include "common.h" 
 #include "config.h"
 #include "utilities.h"
+#include "rtcStore.h"
+#include "timeManager.h"
 #include <PubSubClient.h>       // https://github.com/knolleary/pubsubclient 
 #include <ESP8266WiFi.h>
-#include <NTPClient.h>        // https://github.com/arduino-libraries/NTPClient
-#include <WiFiUdp.h>         // built in: /esp8266/Arduino/blob/master/libraries/ESP8266WiFi/
 #include  <ArduinoJson.h>    // Blanchon, https://github.com/bblanchon/ArduinoJson
- 
+
+// MQTT Rx, for both the AWS and the LAN links (see transport.h); defined in aws.cpp
+void callback(char* topic, byte* payload, unsigned int length);
+void dispatch_message (JsonDocument& doc);   // the keys of a parsed message: E, K, G, S, C
+
+// the MQTT link, as seen by the reconnect state machine in AWS::update()
+enum link_state {
+    LINK_UP,
+    LINK_BACKOFF,     // disconnected; waiting for the next attempt
+    LINK_SUBSCRIBING, // connected; the announcement and subscriptions are due in the next step
+    LINK_WAITING_TIME // the clock is not valid yet (a cold boot); the first attempt is made as soon as it is
+};
+
+// connection times (TLS handshake + MQTT CONNECT) since boot
+struct handshake_stats {
+    unsigned long count;
+    unsigned long total_ms;
+    unsigned long last_ms;
+};
+
 class AWS {
 public : 
   //static char command_str[MAX_COMMAND_LENGTH];
   //static void callback(char* topic, byte* payload, unsigned int length);
   bool restart = false;
   AWS();
-  short init(Config *configptr);
-  short init(Config *configptr, bool restart);
+  short init(Config *configptr, TimeManager *timeptr);
+  short init(Config *configptr, TimeManager *timeptr, bool restart);
   void update();
   PubSubClient* getPubSubClient();
-  short  is_night_time(); 
+  byte get_link_state();
+  unsigned long disconnections = 0;   // since boot
+  unsigned long failed_attempts = 0;  // since boot
+  handshake_stats full_handshakes = {0, 0, 0};
+  handshake_stats resumed_handshakes = {0, 0, 0};  // the TLS session was resumed from the cache
+  unsigned long tls_errors = 0;       // failed attempts with a BearSSL error (the rest failed at TCP or MQTT level)
+  int last_ssl_error = 0;             // BearSSL error code of the last failed attempt
+  unsigned long last_handshake_ms = 0;
+  bool is_session_cached();
+  void clear_tls_session();
 private:
   Config *pC;
-  short current_hour = -1;  // to detect time server failure
-  short current_minute = -1;
+  TimeManager *pTime;
     
   // TODO: revisit the following block of constants and reduce them:
   // The device should be able to work without an AWS connection, only periodically trying to connect
-  // for time server connection:
-  const int MAX_TIME_ATTEMPTS = 20;  // each attempt takes several seconds
-  int time_attempts = 0;
-  // for AWS connection
-  const int RETRY_DELAY = 30000;  // mSec
-  const int MAX_CONNECTION_ATTEMPTS = 10;  // 10*30 sec= at least 5 minutes
-  int connection_attempts = 0;
+  // for AWS connection: the wait before each attempt doubles, from BACKOFF_MIN upto BACKOFF_MAX, 
+  // and a random part of it is dropped, so that a fleet of devices does not retry in step after a broker outage
+  const unsigned long BACKOFF_MIN = 2000;     // mSec
+  const unsigned long BACKOFF_MAX = 300000;   // mSec; 5 minutes
+  const unsigned long CONNECT_TIMEOUT = 5000; // mSec; bounds the time a single attempt can hold the loop
+  const int MAX_CONNECTION_ATTEMPTS = 10;     // only if restart is set: reboot after this many failures in a row
+  int connection_attempts = 0;                // failures in a row
+  byte link = LINK_BACKOFF;
+  unsigned long backoff_start = 0;
+  unsigned long backoff_ms = 0;
+  // TLS session cache: a reconnect offers the last session, and if the broker still knows it, the
+  // handshake skips the key exchange. The session is kept in RTC memory, so a soft reset can resume it too.
+  BearSSL::Session tls_session;
+  bool session_cached = false;
 
   bool init_time_client();
   bool init_file_system();
-  bool reconnect();
-  void get_current_time(); 
+  bool try_connect();
+  void announce_and_subscribe();
+  void schedule_retry();
 
 /*
 https://www.esp8266.com/viewtopic.php?p=82086
@@ -50,8 +85,6 @@ The IDE uses the version in the Arduino folder.
 I deleted the WIFI library in Arduino folder and now I cam able to ompile my code.
 */
 /*
-  WiFiUDP ntpUDP;
-  NTPClient timeClient(ntpUDP, "pool.ntp.org", 55*360);  // UTC offset=5.5 hours * 3600 seconds
   WiFiClientSecure espClient;
   PubSubClient client(AWS_END_POINT, MQTT_PORT, callback, espClient); //set  MQTT port number to 8883 as per standard  
 */
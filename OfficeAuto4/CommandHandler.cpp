@@ -2,6 +2,10 @@
  
 #include "CommandHandler.h" 
 #include "hardware.h"
+#include "aws.h"
+#include "transport.h"
+#include "outbox.h"
+#include "metrics.h"
 
 const char* modes[] = {"AUTO", "MANUAL"};  // NOTE: boolean manual_override is used as index into this array
 
@@ -17,26 +21,56 @@ bool is_night_now(); // this gets the cached value in main .ino
 CommandHandler::CommandHandler() {
 }
  
-void CommandHandler::init(Config *pconfig, PubSubClient *pclient, Hardware *phardware) {
+void CommandHandler::init(Config *pconfig, Transport *ptransport, Outbox *poutbox, Hardware *phardware, Spool *pspool, AWS *paws) {
     pC = pconfig;
-    pClient = pclient;
+    pTransport = ptransport;
+    pOutbox = poutbox;
     pHard = phardware;
+    pSpool = pspool;
+    pAws = paws;
+    build_command_index();
 }
  
 // takes the global status message and publishes it
 // NOTE: You MUST set up the status_message before calling this !
-void CommandHandler::publish_message () {
+// returns false if the message could not be handed over to the MQTT client
+bool CommandHandler::publish_message () {
     SERIAL_PRINT(F("Publishing: "));
     SERIAL_PRINTLN(status_msg);
-    pClient->publish(pC->mqtt_pub_topic, status_msg);
+    prof.note_publish(strlen(status_msg));
+    return (pTransport->publish(pC->mqtt_pub_topic, status_msg));
+}
+
+// binary counterpart of publish_message(), used when the BIN parameter is set; see frames.h
+bool CommandHandler::publish_frame (const byte* frame, short length) {
+    SERIAL_PRINT(F("Publishing frame: "));
+    SERIAL_PRINT(length);
+    SERIAL_PRINTLN(F(" bytes"));
+    prof.note_publish(length);
+    return (pTransport->publish(pC->mqtt_pub_topic, frame, length));
 }
 
 // TODO: In the following two cases, add additional overloaded methods: they should
 // take the status or data as function arguments (push model)
 void CommandHandler::send_status () {  
+    if (in_batch)  // handle_batch() sends one status at the end
+        return;
     // this is pull model; in response to an MQTT command
+    // a relay event; held until delivered (see outbox.h). A frame has no room for the sequence number;
+    // so with ACK set, the status goes as json
+    if (pC->binary_frames && !pC->ack_events) {
+        byte frame[STATUS_FRAME_LENGTH];
+        short length = encode_status_frame(frame, pHard->getStatus());
+        SERIAL_PRINT(F("Publishing event frame: "));
+        SERIAL_PRINT(length);
+        SERIAL_PRINTLN(F(" bytes"));
+        pOutbox->send(frame, length);
+        return;
+    }
     snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"S\":\"%s\"}", pHard->getStatus());    
-    publish_message();
+    SERIAL_PRINT(F("Publishing event: "));
+    SERIAL_PRINTLN(status_msg);
+    pOutbox->send(status_msg);
 }
 
 void CommandHandler::send_data () { // TODO: take the status as an argument?
@@ -44,10 +78,188 @@ void CommandHandler::send_data () { // TODO: take the status as an argument?
         send_paused_msg();
         return; 
     }
-    // TODO: introduce num_relays into the following !   
     const data* dat = pHard->getData();  // this is pull model; in response to an MQTT command; gets the last known values (not current)
-    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"D\":{\"S\":\"%s\",\"T\":%.1f,\"H\":%.1f,\"I\":%.1f,\"L\":%d,\"P\":%d,\"R\":%d}}",  
-              pHard->getStatus(),dat->temperature, dat->humidity, dat->hindex, dat->light, dat->pir_hits, dat->radar_hits);    
+    if (pC->binary_frames) {
+        byte frame[DATA_FRAME_LENGTH];
+        publish_frame (frame, encode_data_frame(frame, pHard->getStatus(), dat));
+        return;
+    }
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"D\":{\"S\":\"%s\",\"T\":%.1f,\"H\":%.1f,\"I\":%.1f,\"L\":%d,\"P\":%d,\"R\":%d,\"N\":%u}}",  
+              pHard->getStatus(),dat->temperature, dat->humidity, dat->hindex, dat->light, dat->pir_hits, dat->radar_hits,
+              dat->window);    
+    publish_message();
+}
+
+// the longest text a format can produce, when every conversion in it prints a 16 bit integer (at most 6 characters)
+constexpr size_t max_formatted_length (const char* format) {
+    return (*format == '\0') ? 0 : (*format == '%') ? 6 + max_formatted_length(format+2) : 1 + max_formatted_length(format+1);
+}
+
+#define  STATS_MSG_FORMAT   "{\"W\":{\"N\":%u,\"%c\":[%u,%d,%d,%d,%d,%d]}}"
+static_assert (max_formatted_length(STATS_MSG_FORMAT) <= MAX_MSG_LENGTH-2, "the window statistics do not fit a message");
+
+// Statistics of the last report window (see stats.h), sent after the data; one message per sensor:
+// {"W":{"N":window,"T":[n,min,max,mean,stddev,last]}}, then "H" and "L". T,H in tenths; L in the scale of the data message.
+// N is the window number of the data message they belong to.
+void CommandHandler::send_stats () {
+    if (data_paused) {
+        send_paused_msg();
+        return; 
+    }
+    const stats_summary* st = pHard->getStats();
+    unsigned short window = pHard->getData()->window;
+    if (pC->binary_frames) {
+        byte frame[STATS_FRAME_LENGTH(NUM_STATS)];
+        publish_frame (frame, encode_stats_frame(frame, window, st, NUM_STATS));
+        return;
+    }
+    const char keys[NUM_STATS] = {'T', 'H', 'L'};  // in the order of STATS_TEMPERATURE, STATS_HUMIDITY, STATS_LIGHT
+    for (byte i=0; i<NUM_STATS; i++) {
+        const stats_summary* s = &st[i];
+        snprintf (status_msg, MAX_MSG_LENGTH-1, STATS_MSG_FORMAT, 
+                  window, keys[i], s->count, s->min, s->max, s->mean, s->stddev, s->last);
+        publish_message();
+    }
+}
+
+#define  TENTHS_LENGTH   8   // "-3276.8"
+
+// a reading in tenths, as json: null if the sensor failed, as the binary frame is decoded (see frames.py)
+static const char* json_tenths (char* buffer, short value) {
+    if (value == FRAME_NO_VALUE)
+        return "null";
+    snprintf (buffer, TENTHS_LENGTH, "%.1f", value/10.0);
+    return buffer;
+}
+
+// Publishes samples from the spool, as many as fit in one message: {"Y":[[stamp,"01",T,H,I,L,P,R],...]}
+// T,H,I are null for a failed reading. Returns the number of samples sent; 0 if the message could not be published
+short CommandHandler::send_history (const spool_sample* batch, short count) {
+    if (data_paused || count <= 0)
+        return 0;
+    if (pC->binary_frames) {
+        byte frame[HISTORY_FRAME_LENGTH(SPOOL_BATCH_SAMPLES)];
+        if (count > SPOOL_BATCH_SAMPLES)
+            count = SPOOL_BATCH_SAMPLES;
+        return (publish_frame (frame, encode_history_frame(frame, batch, count)) ? count : 0);
+    }
+    char sample[MAX_SHORT_STRING_LENGTH];
+    char relays[MAX_RELAYS+1];
+    char temperature[TENTHS_LENGTH], humidity[TENTHS_LENGTH], hindex[TENTHS_LENGTH];
+    safe_strncpy (status_msg, "{\"Y\":[", MAX_MSG_LENGTH);
+    short n = 0;
+    for (; n<count; n++) {
+        const spool_sample* s = &batch[n];
+        for (short r=0; r<NUM_RELAYS; r++)
+            relays[r] = (s->relays & (1 << (NUM_RELAYS-1-r))) ? '1' : '0';
+        relays[NUM_RELAYS] = '\0';
+        snprintf (sample, MAX_SHORT_STRING_LENGTH-1, "%s[%lu,\"%s\",%s,%s,%s,%u,%u,%u]", (n>0) ? "," : "",
+                  s->stamp, relays, json_tenths(temperature, s->temperature), json_tenths(humidity, s->humidity),
+                  json_tenths(hindex, s->hindex), s->light, s->pir_hits, s->radar_hits);
+        if (strlen(status_msg) + strlen(sample) + 3 > MAX_MSG_LENGTH-1)  // room for the closing "]}"
+            break;
+        strcat (status_msg, sample);
+    }
+    if (n == 0)
+        return 0;
+    strcat (status_msg, "]}");
+    return (publish_message() ? n : 0);
+}
+
+// a 16 bit field of a message; a larger value shows as 65535
+static unsigned short saturate16 (unsigned long value) {
+    return (value > 65535UL) ? 65535 : (unsigned short)value;
+}
+
+#define  MOTION_MSG_FORMAT  "{\"E\":{\"P\":[%u,%u,%u,%u],\"R\":[%u,%u,%u,%u]}}"
+static_assert (max_formatted_length(MOTION_MSG_FORMAT) <= MAX_MSG_LENGTH-2, "the motion report does not fit a message");
+
+// motion sensor edges in the current report window: hits, seconds since the first and the latest rising edge,
+// and the longest pulse in mSec: {"E":{"P":[hits,first,last,pulse],"R":[hits,first,last,pulse]}}
+void CommandHandler::send_motion() {
+    motion_channel pir, radar;
+    pHard->get_motion(&pir, &radar);
+    unsigned long now = millis();
+    snprintf (status_msg, MAX_MSG_LENGTH-1, MOTION_MSG_FORMAT,
+              pir.hits, saturate16(pir.hits ? (now-pir.first_edge)/1000 : 0), saturate16(pir.hits ? (now-pir.last_edge)/1000 : 0),
+              saturate16(pir.max_pulse),
+              radar.hits, saturate16(radar.hits ? (now-radar.first_edge)/1000 : 0), saturate16(radar.hits ? (now-radar.last_edge)/1000 : 0),
+              saturate16(radar.max_pulse));
+    publish_message();
+}
+
+// Time between two passes of the main loop since the last LAT command (the max shows the longest stall),
+// and the count of background DHT22 conversions and failures: {"T":{"N","A","X","D","E"}}
+void CommandHandler::send_loop_latency() {
+    unsigned long conversions, failures;
+    pHard->get_dht_stats(&conversions, &failures);
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"T\":{\"N\":%lu,\"A\":%lu,\"X\":%lu,\"D\":%lu,\"E\":%lu}}",
+              prof.loop_gap.count, prof.average_us(&prof.loop_gap), prof.loop_gap.max_us, conversions, failures);
+    publish_message();
+    prof.reset_loop();
+}
+
+// Connection times since boot, for full and resumed TLS handshakes, and whether a session is cached:
+// {"X":{"F":[count,avg ms,last ms],"R":[count,avg ms,last ms],"V":cached}}
+void CommandHandler::send_tls_stats() {
+    const handshake_stats* f = &pAws->full_handshakes;
+    const handshake_stats* r = &pAws->resumed_handshakes;
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"X\":{\"F\":[%lu,%lu,%lu],\"R\":[%lu,%lu,%lu],\"V\":%d}}",
+              f->count, (f->count > 0) ? f->total_ms/f->count : 0, f->last_ms,
+              r->count, (r->count > 0) ? r->total_ms/r->count : 0, r->last_ms, pAws->is_session_cached());
+    publish_message();
+}
+
+// Duration of each phase of the first boot, mSec; 0 for a phase that was not reached (eg. no wifi):
+// {"Z":{"H":hardware,"C":config,"W":wifi,"T":time server,"K":certificates,"M":mqtt,"D":total setup()}}
+void CommandHandler::send_boot_times() {
+    unsigned long duration[NUM_BOOT_PHASES];
+    unsigned long previous = 0;
+    for (byte i=0; i<NUM_BOOT_PHASES; i++) {
+        duration[i] = (prof.boot_ms[i] == 0) ? 0 : prof.boot_ms[i] - previous;
+        if (prof.boot_ms[i] != 0)
+            previous = prof.boot_ms[i];
+    }
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"Z\":{\"H\":%lu,\"C\":%lu,\"W\":%lu,\"T\":%lu,\"K\":%lu,\"M\":%lu,\"D\":%lu}}",
+              duration[BOOT_HARDWARE], duration[BOOT_CONFIG], duration[BOOT_WIFI], duration[BOOT_TIME], 
+              duration[BOOT_CERTS], duration[BOOT_MQTT], prof.boot_ms[BOOT_DONE]);
+    publish_message();
+}
+
+// both MQTT links: {"N":{"A":[up,disconnections,failed attempts],"L":[up,connections,failures],"F":failovers}}
+void CommandHandler::send_link_stats() {
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"N\":{\"A\":[%d,%lu,%lu],\"L\":[%d,%lu,%lu],\"F\":%lu}}",
+              pTransport->cloud_connected(), pAws->disconnections, pAws->failed_attempts,
+              pTransport->local_connected(), pTransport->local_connections, pTransport->local_failures, 
+              pTransport->failovers);
+    publish_message();
+}
+
+// Connection health, all since boot except the Rx rate, which is since the last periodic report (MET does not reset it):
+// {"M":{"R":broker round trip ms,"C":[disconnections,failed attempts],"H":last handshake ms,
+// "E":[TLS errors,last BearSSL code],"F":publish failures,"I":Rx per hour,"D":Rx dropped,"W":RSSI}}
+// NOTE: the MAC reply also uses "M", with a string instead of an object
+void CommandHandler::send_metrics() {
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"M\":{\"R\":%lu,\"C\":[%lu,%lu],\"H\":%lu,\"E\":[%lu,%d],\"F\":%lu,\"I\":%lu,\"D\":%lu,\"W\":%ld}}",
+              metrics.last_rtt_ms, pAws->disconnections, pAws->failed_attempts, pAws->last_handshake_ms,
+              pAws->tls_errors, pAws->last_ssl_error, pTransport->publish_failures, metrics.rx_per_hour(),
+              metrics.rx_dropped + queue.dropped, (long)WiFi.RSSI());
+    publish_message();
+    pTransport->send_echo();  // the next report shows its round trip
+}
+
+// events waiting, high water, acknowledged, sent again, dropped, and the delay of the acknowledgement (mSec)
+void CommandHandler::send_outbox_stats() {
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"R\":{\"D\":%d,\"W\":%d,\"A\":%lu,\"T\":%lu,\"X\":%lu,\"L\":[%lu,%lu]}}",
+              pOutbox->depth(), pOutbox->high_water, pOutbox->acked, pOutbox->retransmits, pOutbox->dropped,
+              (pOutbox->acked > 0) ? pOutbox->latency_total_ms/pOutbox->acked : 0, pOutbox->latency_max_ms);
+    publish_message();
+}
+
+// spooled samples waiting, appended, sent and dropped since boot
+void CommandHandler::send_spool_stats() {
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"U\":{\"N\":%ld,\"A\":%lu,\"T\":%lu,\"X\":%lu}}",
+              pSpool->size(), pSpool->appended, pSpool->sent, pSpool->dropped);
     publish_message();
 }
 
@@ -136,6 +348,33 @@ void CommandHandler::send_mode() {
     publish_message();
 }
 
+// Publishes the profiler readings of the current window and starts a new window
+void CommandHandler::send_profile() {
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"F\":{\"N\":%lu,\"A\":%lu,\"X\":%lu,\"B\":%d,\"Z\":%d,\"H\":%ld,\"K\":%ld}}",
+              prof.dispatch.count, prof.average_us(&prof.dispatch), prof.dispatch.max_us, 
+              prof.max_publish_length, MAX_MSG_LENGTH, prof.min_free_heap, prof.max_heap_loss);
+    publish_message();
+    new_profile_window = true;  // see handle_command()
+}
+
+// Json parse time in the MQTT callback, the size of the json document on the stack, the lowest free stack 
+// seen so far (the stack is painted at boot; this is a high water mark), the count of over-length messages,
+// and the long messages received in parts: completed, parts accepted, errors
+void CommandHandler::send_parse_profile() {
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"J\":{\"N\":%lu,\"A\":%lu,\"X\":%lu,\"D\":%d,\"S\":%lu,\"R\":%lu,\"L\":[%lu,%lu,%lu]}}",
+              prof.parse.count, prof.average_us(&prof.parse), prof.parse.max_us, 
+              (int)JSON_PARSE_DOC_SIZE, (unsigned long)ESP.getFreeContStack(), prof.rejected_messages,
+              assembler.messages, assembler.parts, assembler.errors);
+    publish_message();
+}
+
+// Depth, high water mark, dropped and executed counts of the incoming command queue
+void CommandHandler::send_queue_stats() {
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"Q\":{\"D\":%d,\"W\":%d,\"X\":%lu,\"E\":%lu}}",
+              queue.depth(), queue.high_water, queue.dropped, queue.executed);
+    publish_message();
+}
+
 // Downloads TLS certificates and config.txt file. If success, restarts the device
 void CommandHandler::download_certificates(){
     print_heap();
@@ -155,19 +394,122 @@ void CommandHandler::download_certificates(){
 } 
 //--------------------------------------------------------------------------------------
 
-#define  NUM_COMMANDS    21  // excluding on and off commands; index runs from 0 to NUM_COMMANDS-1
-// NOTE: If you change the order of the following strings, you must change the switch cases also !
-const char* commands[] = { "STA", "VER", "MAC", "GRO", "ORG", "HEA", "REB", "DEL", "UPD", "AUT", 
-                           "MAN", "MOD", "BL0", "BL1", "DAT", "CER", "LOJ", "ISN", "OCC", "PAU", "RES" };
+// Commands are always 3 characters; packed into one integer, they are looked up in the command table below
+// through a perfect hash, instead of a linear scan of strcmp() calls. (ONx and OFx are parsed before that.)
+constexpr uint32_t command_key (const char* s) {
+    return (((uint32_t)(byte)s[0] << 16) | ((uint32_t)(byte)s[1] << 8) | (uint32_t)(byte)s[2]);
+}
+
+constexpr byte command_slot (uint32_t key) {
+    return (byte)((uint32_t)(key * COMMAND_HASH_MULTIPLIER) >> (32 - COMMAND_SLOT_BITS));
+}
+
+// The command table. One line per command: its name and the method that runs it.
+#define  CMD(name, method)   { command_key(name), &CommandHandler::method }
+
+constexpr command_entry CommandHandler::command_registry[] = {
+    CMD("STA", send_status),
+    CMD("VER", send_version),
+    CMD("MAC", send_mac_address),
+    CMD("GRO", send_group),
+    CMD("ORG", send_org),
+    CMD("HEA", send_heap),
+    CMD("REB", reboot),
+    CMD("DEL", delete_wifi),
+    CMD("UPD", update_firmware),
+    CMD("AUT", auto_mode),
+    CMD("MAN", manual_mode),
+    CMD("MOD", send_mode),
+    CMD("BL0", blink_led0),
+    CMD("BL1", blink_led1),
+    CMD("DAT", send_data),               // on-demand data
+    CMD("WIN", send_stats),              // of the last report window
+    CMD("CER", download_certificates),   // TLS certificates and config.txt file
+    CMD("LOJ", send_active_onoff),       // on/off logic levels
+    CMD("ISN", send_is_night),
+    CMD("OCC", send_is_occupied),
+    CMD("PAU", pause_data),
+    CMD("RES", resume_data),
+    CMD("PRF", send_profile),
+    CMD("JSN", send_parse_profile),
+    CMD("BOT", send_boot_times),
+    CMD("TLS", send_tls_stats),
+    CMD("TLC", clear_tls_session),
+    CMD("MET", send_metrics),
+    CMD("OUT", send_outbox_stats),
+    CMD("NET", send_link_stats),
+    CMD("LAT", send_loop_latency),
+    CMD("MOT", send_motion),
+    CMD("SPL", send_spool_stats),
+    CMD("QUE", send_queue_stats),
+#ifdef LOOKUP_BENCHMARK
+    CMD("BEN", send_lookup_benchmark),
+#endif
+};
+#define  NUM_REGISTERED_COMMANDS   (sizeof(CommandHandler::command_registry)/sizeof(command_entry))
+#define  NO_COMMAND                0xFF
+
+// true if one of the first n entries hashes to the slot
+constexpr bool slot_taken (const command_entry* table, size_t n, byte slot) {
+    return (n > 0) && (command_slot(table[n-1].key) == slot || slot_taken(table, n-1, slot));
+}
+
+constexpr bool collision_free (const command_entry* table, size_t n) {
+    return (n == 0) || (!slot_taken(table, n-1, command_slot(table[n-1].key)) && collision_free(table, n-1));
+}
+
+void CommandHandler::build_command_index() {
+    static_assert (NUM_REGISTERED_COMMANDS < NO_COMMAND && NUM_REGISTERED_COMMANDS <= COMMAND_SLOTS, "COMMAND_SLOTS is too small");
+    static_assert (collision_free(command_registry, NUM_REGISTERED_COMMANDS), 
+                   "two commands share a slot; choose another COMMAND_HASH_MULTIPLIER");
+    memset (command_index, NO_COMMAND, sizeof(command_index));
+    for (size_t i=0; i<NUM_REGISTERED_COMMANDS; i++)
+        command_index[command_slot(command_registry[i].key)] = (byte)i;
+}
+
+const command_entry* CommandHandler::find_command (uint32_t key) {
+    byte i = command_index[command_slot(key)];
+    if (i == NO_COMMAND || command_registry[i].key != key)
+        return NULL;
+    return &command_registry[i];
+}
 
+// every command is timed by the profiler; the PRF command reports the readings
 void CommandHandler::handle_command(const char* command_string) {
+    prof.begin_command();
+    dispatch_command(command_string);
+    prof.end_command();
+    if (new_profile_window) {
+        prof.reset();
+        new_profile_window = false;
+    }
+}
+
+// Executes a comma separated list of commands in one go, eg: "ON0,ON1,STA"
+// The relays publish their status after every switching; within a batch, only one status goes out at the end
+void CommandHandler::handle_batch(char* command_list) {
+    in_batch = true;
+    char* next = command_list;
+    while (next != NULL) {
+        char* command = next;
+        next = strchr(command, ',');
+        if (next != NULL)
+            *next++ = '\0';
+        if (strlen(command) > 0)
+            handle_command(command);
+    }
+    in_batch = false;
+    send_status();
+}
+
+void CommandHandler::dispatch_command(const char* command_string) {
     if (strlen (command_string) < 3) {
         SERIAL_PRINTLN(F("Command can be: STA,UPD,VER,MAC,HEA,DEL,GRO,ORG,RES,ONx,OFx etc"));
         return;
     }
     // ON commands: ON0, ON1 etc
     if (command_string[0]=='O' && command_string[1]=='N') { 
-        if (command_string[2] < '0' ||  command_string[2] >= num_relays+'0') 
+        if (command_string[2] < '0' ||  command_string[2] >= pHard->relay_count()+'0') 
             SERIAL_PRINTLN(F("-- Error: Invalid relay number --"));
         else
             pHard->relay_on(command_string[2] - '0'); // this sends the status also 
@@ -176,98 +518,85 @@ void CommandHandler::handle_command(const char* command_string) {
     }
     // OFF commands: OF0, OF1 etc.
     if (command_string[0]=='O' && command_string[1]=='F') { 
-        if (command_string[2] < '0' ||  command_string[2] >= num_relays+'0') 
+        if (command_string[2] < '0' ||  command_string[2] >= pHard->relay_count()+'0') 
             SERIAL_PRINTLN(F("-- Error: Invalid relay number --"));
         else
             pHard->relay_off(command_string[2] - '0'); // this sends the status also 
         print_heap();
         return;
     }
-    int command_index = -1;
-    for (int i=0; i<NUM_COMMANDS; i++) {
-        if (strcmp(command_string, commands[i]) == 0) {
-            command_index = i;
-            break;
-        }
-    }
-    if (command_index < 0) {
+    if (command_string[3] != '\0') {  // all the other commands are exactly 3 characters
        SERIAL_PRINTLN(F("-- Error: Invalid command --"));
        print_heap();
        return;
     }
-    switch (command_index) {
-        case 0: // STA
-            send_status();
-            break;
-        case 1: // VER
-            send_version();
-            break;
-        case 2: // MAC
-            send_mac_address();
-            break;     
-        case 3:  // GRO
-            send_group();
-            break;
-        case 4: // ORG
-            send_org();
-            break;
-        case 5:  // HEA
-            send_heap();
-            break;   
-        case 6:  // REB
-            reboot();
-            break;
-        case 7:  // DEL
-            reset_wifi();
-            break;
-        case 8:  // UPD
-            check_for_updates();
-            break;     
-        case 9:  // AUT
-            auto_mode();
-            break;
-        case 10: // MAN
-            manual_mode();
-            break;                
-        case 11: // MOD
-            send_mode();
-            break;               
-        case 12: // BL0
-            pHard->blink_led(0, BLINK_COUNT);
-            break;                
-        case 13: // BL1
-            pHard->blink_led(1, BLINK_COUNT);
-            break;       
-        case 14: // DAT
-            send_data(); // on-demand data
-            break;            
-        case 15: // CER
-            download_certificates(); // TLS certificates and config.txt file
-            break;                        
-        case 16: // LOJ : on/off logic levels
-            send_active_onoff();
-            break;
-        case 17: // ISN
-            send_is_night();
-            break;
-        case 18: // OCC
-            send_is_occupied();
-            break;
-        case 19: // PAU            
-            data_paused = true;
-            break;
-        case 20: // RES            
-            data_paused = false;
-            break;            
-        default :
-            SERIAL_PRINTLN(F("-- Error: Invalid command index --"));
-            break;                              
-    }
+    const command_entry* e = find_command(command_key(command_string));
+    if (e == NULL)
+        SERIAL_PRINTLN(F("-- Error: Invalid command --"));
+    else
+        (this->*(e->handler))();
     print_heap();
 }
 
+void CommandHandler::delete_wifi() {
+    reset_wifi();
+}
+
+void CommandHandler::update_firmware() {
+    check_for_updates();
+}
+
+void CommandHandler::blink_led0() {
+    pHard->blink_led(0, BLINK_COUNT);
+}
+
+void CommandHandler::blink_led1() {
+    pHard->blink_led(1, BLINK_COUNT);
+}
 
+void CommandHandler::pause_data() {
+    data_paused = true;
+}
 
+void CommandHandler::resume_data() {
+    data_paused = false;
+}
 
+// the next reconnect (or reboot) makes a full handshake
+void CommandHandler::clear_tls_session() {
+    pAws->clear_tls_session();
+}
 
- 
+#ifdef LOOKUP_BENCHMARK
+// The original linear lookup is kept here only to measure it against the command table.
+#define  NUM_COMMANDS    22
+const char* commands[] = { "STA", "VER", "MAC", "GRO", "ORG", "HEA", "REB", "DEL", "UPD", "AUT", 
+                           "MAN", "MOD", "BL0", "BL1", "DAT", "CER", "LOJ", "ISN", "OCC", "PAU", "RES", "PRF" };
+
+static short linear_lookup (const char* command_string) {
+    for (short i=0; i<NUM_COMMANDS; i++) 
+        if (strcmp(command_string, commands[i]) == 0) 
+            return i;
+    return -1;
+}
+
+// Looks up every command name LOOKUP_ROUNDS times with each method; publishes the total times in usec
+#define  LOOKUP_ROUNDS   100
+void CommandHandler::send_lookup_benchmark() {
+    volatile short sink = 0;  // keeps the optimizer from discarding the loops
+    unsigned long start = micros();
+    for (int r=0; r<LOOKUP_ROUNDS; r++)
+        for (int i=0; i<NUM_COMMANDS; i++)
+            sink += linear_lookup(commands[i]);
+    unsigned long linear_us = micros() - start;
+    yield();
+    start = micros();
+    for (int r=0; r<LOOKUP_ROUNDS; r++)
+        for (int i=0; i<NUM_COMMANDS; i++)
+            sink += (find_command(command_key(commands[i])) != NULL);
+    unsigned long packed_us = micros() - start;
+    snprintf (status_msg, MAX_MSG_LENGTH-1, "{\"F\":{\"R\":%d,\"LIN\":%lu,\"KEY\":%lu}}", 
+              LOOKUP_ROUNDS*NUM_COMMANDS, linear_us, packed_us);
+    publish_message();
+}
+#endif
@@ -7,20 +7,47 @@
 #include "settings.h"
 #include "utilities.h"
 #include "config.h"
-#include <PubSubClient.h>       // https://github.com/knolleary/pubsubclient 
+#include "profiler.h"
+#include "assembler.h"
+#include "CommandQueue.h"
+#include "frames.h"
+#include "spool.h"
 
 class Hardware;  // required forward declaration
+class AWS;
+class Transport;
+class Outbox;
+struct command_entry;  // defined below, after CommandHandler
+
+// The command index: every 3 character command hashes to its own slot (checked at compile time), so a lookup
+// is one multiplication and one comparison. A new command that collides needs another odd multiplier.
+#define  COMMAND_SLOT_BITS        6
+#define  COMMAND_SLOTS            (1 << COMMAND_SLOT_BITS)
+#define  COMMAND_HASH_MULTIPLIER  0xBDECE619U
 
 class CommandHandler  {
 public:
     // manual_override is public because it is accessed frequently in main .ino 
     bool manual_override = false; // for remote commands, set this to true
+    CommandQueue queue;  // filled by the MQTT callback, drained by the main loop
     CommandHandler();
-    void init (Config *pC, PubSubClient *pClient, Hardware *phardware);
+    void init (Config *pC, Transport *ptransport, Outbox *poutbox, Hardware *phardware, Spool *pspool, AWS *paws);
     void handle_command(const char* command_string);    
-    void publish_message ();
+    void handle_batch(char* command_list);
+    bool publish_message ();
+    bool publish_frame (const byte* frame, short length);
     void send_status ();
     void send_data ();
+    void send_stats ();
+    short send_history (const spool_sample* batch, short count);
+    void send_spool_stats ();
+    void send_motion ();
+    void send_loop_latency ();
+    void send_tls_stats ();
+    void send_boot_times ();
+    void send_link_stats ();
+    void send_outbox_stats ();
+    void send_metrics ();
     void send_version();
     void send_is_night();
     void send_is_occupied();
@@ -36,14 +63,42 @@ public:
     void download_certificates();
     void send_paused_msg();
     void get_param(const char *param);
+    void send_profile();
+    void send_parse_profile();
+    void send_queue_stats();
+#ifdef LOOKUP_BENCHMARK
+    void send_lookup_benchmark();
+#endif
 
 private:
     char status_msg[MAX_MSG_LENGTH];   // Tx message
-    int num_relays = NUM_RELAYS;
     bool data_paused = false;
+    bool in_batch = false;   // while executing a batch, status replies are held back and sent once at the end
+    bool new_profile_window = false;  // set by PRF; the window restarts after PRF itself has been timed
     Config *pC;
-    PubSubClient *pClient;
+    Transport *pTransport;
+    Outbox *pOutbox;
     Hardware *pHard;    
+    Spool *pSpool;
+    AWS *pAws;
+    static const command_entry command_registry[];
+    byte command_index[COMMAND_SLOTS];   // slot -> position in command_registry; built by init()
+    void build_command_index();
+    const command_entry* find_command (uint32_t key);
+    void dispatch_command(const char* command_string);
+    // the commands that are not a call of one of the methods above
+    void delete_wifi();
+    void update_firmware();
+    void blink_led0();
+    void blink_led1();
+    void pause_data();
+    void resume_data();
+    void clear_tls_session();
+};
+
+struct command_entry {
+    uint32_t key;                         // command_key() of the name
+    void (CommandHandler::*handler)();
 };
 
 #endif 
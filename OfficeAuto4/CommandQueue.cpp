@@ -0,0 +1,65 @@
+// CommandQueue.cpp
+
+#include "CommandQueue.h"
+#include "utilities.h"
+
+CommandQueue::CommandQueue() {
+}
+
+// head and tail run freely and wrap around at 65536; the slot index is taken modulo the (power of 2) size
+bool CommandQueue::push (byte kind, const char* command, const char* value) {
+    if ((unsigned short)(head - tail) >= COMMAND_QUEUE_SIZE) {
+        dropped++;
+        SERIAL_PRINTLN(F("--- Command queue full; command dropped ---"));
+        return false;
+    }
+    queued_command* slot = &slots[head & (COMMAND_QUEUE_SIZE-1)];
+    slot->kind = kind;
+    safe_strncpy (slot->command, command, MAX_COMMAND_LENGTH);
+    safe_strncpy (slot->value, (value==NULL) ? "" : value, MAX_LONG_STRING_LENGTH);
+    head = head + 1;  // publish the slot only after it is completely written
+    short d = depth();
+    if (d > high_water)
+        high_water = d;
+    return true;
+}
+
+// the batch commands arrive as pointers into the MQTT buffer; the slot is the only copy made of them
+bool CommandQueue::push_batch (const char* const* commands, short count) {
+    if ((unsigned short)(head - tail) >= COMMAND_QUEUE_SIZE) {
+        dropped++;
+        SERIAL_PRINTLN(F("--- Command queue full; batch dropped ---"));
+        return false;
+    }
+    queued_command* slot = &slots[head & (COMMAND_QUEUE_SIZE-1)];
+    slot->kind = CMD_BATCH;
+    slot->command[0] = '\0';
+    slot->value[0] = '\0';
+    for (short i=0; i<count; i++) {
+        if (i > 0)
+            safe_strncat (slot->value, ",", MAX_LONG_STRING_LENGTH);
+        safe_strncat (slot->value, commands[i], MAX_LONG_STRING_LENGTH);
+    }
+    head = head + 1;
+    short d = depth();
+    if (d > high_water)
+        high_water = d;
+    return true;
+}
+
+queued_command* CommandQueue::front() {
+    if (head == tail)
+        return NULL;
+    return (&slots[tail & (COMMAND_QUEUE_SIZE-1)]);
+}
+
+void CommandQueue::release() {
+    if (head == tail)
+        return;
+    tail = tail + 1;
+    executed++;
+}
+
+short CommandQueue::depth() {
+    return ((unsigned short)(head - tail));
+}
@@ -0,0 +1,45 @@
+// CommandQueue.h
+// Commands received in the MQTT callback are copied into this ring buffer, and executed later from the main loop.
+// This keeps long handlers (OTA, certificate download) and their publishing out of client.loop().
+// Single producer (MQTT callback), single consumer (main loop); no locks are needed.
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include "common.h"
+
+#define  COMMAND_QUEUE_SIZE    8    // must be a power of 2
+#define  COMMAND_TIME_BUDGET   20   // mSec; the main loop stops draining the queue after this, until the next iteration
+
+enum command_kind {
+    CMD_COMMAND,   // {"C":"STA"}
+    CMD_GET,       // {"G":"param"}
+    CMD_SET,       // {"S":{"P":"param", "V":"value"}}
+    CMD_BATCH      // {"C":["ON0","ON1","STA"]}; the value holds the comma separated list
+};
+
+struct queued_command {
+    byte kind;
+    char command[MAX_COMMAND_LENGTH];
+    char value[MAX_LONG_STRING_LENGTH];
+};
+
+class CommandQueue {
+public:
+    CommandQueue();
+    bool push (byte kind, const char* command, const char* value);  // producer side; false if the queue is full
+    bool push_batch (const char* const* commands, short count);     // joins the commands straight into the slot
+    queued_command* front();  // consumer side; NULL if the queue is empty
+    void release();           // consumer side; frees the slot returned by front()
+    short depth();
+    // counters
+    short high_water = 0;     // maximum depth seen
+    unsigned long dropped = 0;
+    unsigned long executed = 0;
+private:
+    queued_command slots[COMMAND_QUEUE_SIZE];
+    volatile unsigned short head = 0;  // written only by the producer
+    volatile unsigned short tail = 0;  // written only by the consumer
+};
+
+#endif
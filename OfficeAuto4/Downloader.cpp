@@ -24,7 +24,7 @@ int Downloader::download_files() {
         if (result != CODE_OK) // 0
             return result;  // bubble it up
     }
-    if (!SPIFFS.begin()) {
+    if (!mount_file_system()) {
         Serial.println("--- Failed to mount file system. ---");
         return SPIFF_FAILED; 
     }
@@ -41,7 +41,6 @@ int Downloader::download_files() {
     SERIAL_PRINTLN(F("Config file contents: ")); 
     print_file(pC->file_names[0]); // NOTE: config.txt must be the first file in the list
     list_files();
-    SPIFFS.end();  
     return CODE_OK;  // 0
 }
 
@@ -180,7 +179,6 @@ void Downloader::list_files() {
         f.close();  // this is needed. see:
     }
     //dir.close(); // this call does not exist. 
-    //SPIFFS.end(); // TODO: revisit
 }
 
 void Downloader::print_file (const char* file_name) {
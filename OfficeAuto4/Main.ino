@@ -10,10 +10,8 @@
        NOTE: set() overwrites the parameter temporarily. To save it to Flash, download a new settings.txt file.
    TODO: some web interface (use WiFi Manager's getParam()) to see/edit config.txt and save
    TODO: increment pir/radar hit counts (after implementing Button interface)
-   TODO: command handler runs on the MQTT thread; move this to the main loop
-   The AWS class is the custodian of Time Server connection (TODO: create a separate TimeManager class)
+   The TimeManager class keeps the wall clock; NTP runs in the background, and the time is carried over soft resets
    TODO: Start_wifi_manager_portal() with a push button
-   TODO: in sevaral files we have hard coded values for NUM_RELAYS; introduce it as a variable 
    ---------------------------------------------------------------------------------
    Difference between bathroom and portico controllers:
    Change the app name, app_id etc.  -- settings.h, config.txt
@@ -30,7 +28,6 @@
    https://github.com/copercini/esp8266-aws_iot/blob/master/examples/mqtt_x509_DER/mqtt_x509_DER.ino
    Dependencies:
    https://github.com/esp8266/arduino-esp8266fs-plugin
-   https://github.com/arduino-libraries/NTPClient
    https://github.com/knolleary/pubsubclient 
    
    Cloud configuration:
@@ -38,6 +35,8 @@
    give it AWS IoT permissions and download its certificates (in pem format).
    OTA files can be accessed from S3 now. They are of the form:
    https://my-bucket.s3.us-east-2.amazonaws.com/my-folder/my-file.jpg
+   Put <app_id>-<old version>.delta (python/make_delta.py) next to <app_id>.bin; the devices on that old version
+   then download only the changes. Without a matching delta, the full image is downloaded as before.
    
    Transforming the certificates:
    Use OpenSSL (install it for Windows) to convert the certificates to DER format:
@@ -77,9 +76,12 @@ Hardware hard;
 OtaHelper ota; // TODO: create this only when needed ?
 Timer T;
 AWS aws;
+TimeManager time_mgr;  // wall clock: NTP in the background, carried over soft resets in RTC memory
 MyFiManager myfi;
 CommandHandler cmd;
-PubSubClient* pClient;
+Spool spool;  // sensor data held back during a connection outage
+Transport transport;  // publishes go over AWS and the LAN broker, whichever are up
+Outbox outbox;        // events held until delivered
 
 enum { COMM_OK, COMM_BROKEN } comm_status;
 #ifndef PORTICO_VERSION   
@@ -92,27 +94,68 @@ bool is_night = true;   // Global variable; periodically updated using the Time
 bool pir_status, radar_status;
 
 //-------------------------------------------------------------------------
-// these are invoked from MQTT callback
+// these are invoked from MQTT callback; they only queue the command, which is executed later in the main loop
+// the strings point into the MQTT receive buffer, and are valid only until they return
 void notify_command (const char* command) {
     SERIAL_PRINTLN(command);
-    // there is no manual override_check here; remote commands will work even in auto mode.
-    cmd.handle_command(command); // TODO: this runs on the MQTT thread; move this to the main loop
+    cmd.queue.push(CMD_COMMAND, command, NULL);
 }
 
 void notify_get_param (const char* param) {
-    cmd.get_param(param); // TODO: this runs on the MQTT thread; move this to the main loop  
+    cmd.queue.push(CMD_GET, param, NULL);
 }
 
 void notify_set_param (const char* param, const char *value){
-  // TODO: this runs on the MQTT thread; move this to the main loop 
-    bool result = C.set_param(param, value); // this returns true if there was an error
-    if (result) {
-        SERIAL_PRINTLN (F("--- SET Failed ---"));
-        pClient->publish(C.mqtt_pub_topic, "{\"I\":\"SET-ERROR\"}");
+    cmd.queue.push(CMD_SET, param, value);
+}
+
+void notify_batch (const char* const* commands, short count) {
+    cmd.queue.push_batch(commands, count);
+}
+
+void notify_ack (unsigned short seq) {
+    outbox.ack(seq);
+}
+
+void notify_part (const byte* frame, unsigned int length) {
+    assembler.add_part(frame, length);
+}
+
+// runs in the main loop thread
+void execute_command (queued_command* qc) {
+    switch (qc->kind) {
+      case CMD_COMMAND:
+        // there is no manual override_check here; remote commands will work even in auto mode.
+        cmd.handle_command(qc->command); 
+        break;
+      case CMD_GET:
+        cmd.get_param(qc->command);
+        break;
+      case CMD_SET:
+        if (C.set_param(qc->command, qc->value)) { // this returns true if there was an error
+            SERIAL_PRINTLN (F("--- SET Failed ---"));
+            transport.publish(C.mqtt_pub_topic, "{\"I\":\"SET-ERROR\"}");
+        }
+        else {
+            SERIAL_PRINTLN (F("SET: OK"));
+            transport.publish(C.mqtt_pub_topic, "{\"C\":\"SET-OK\"}");    
+        }
+        break;
+      case CMD_BATCH:
+        cmd.handle_batch(qc->value);  // NOTE: this splits the list in place
+        break;
     }
-    else {
-        SERIAL_PRINTLN (F("SET: OK"));
-        pClient->publish(C.mqtt_pub_topic, "{\"C\":\"SET-OK\"}");    
+}
+
+// drains the command queue, but yields back to the loop once the time budget is spent
+void run_command_queue() {
+    unsigned long start = millis();
+    queued_command* qc;
+    while ((qc = cmd.queue.front()) != NULL) {
+        execute_command(qc);
+        cmd.queue.release();
+        if (millis() - start >= COMMAND_TIME_BUDGET)
+            break;
     }
 }
 //-------------------------------------------------------------------------
@@ -120,11 +163,15 @@ void notify_set_param (const char* param, const char *value){
 void setup() {
     // Note that C.init is called *after* hard.init; so C.active_low is not available at the time of hardware.init()
     hard.init(&C, &T, &cmd);  // this initializes LEDs and serial port; all the following lines need serial port
+    prof.mark_boot(BOOT_HARDWARE);
     hard.blink1();   // this needs LEDs to be initialized
     if (!C.init())            // TLS certificates not found
         enter_fiasco_mode();  // this is an infinite loop **
     hard.release_all_relays();  // this uses the correctly initialized value of C.OFF
     C.dump();    
+    time_mgr.init(&C);  // after a soft reset, the time is valid from here on
+    spool.init();  // samples left from an outage before the last reboot are sent once connected
+    prof.mark_boot(BOOT_CONFIG);
 
     check_day_or_night (true);  // initialize based on light; this will be overridden by Time Server
     SERIAL_PRINT (F("Light-based time: "));
@@ -132,16 +179,32 @@ void setup() {
 #ifndef PORTICO_VERSION       
     MAX_BUCKETS = C.get_auto_off_ticks();
 #endif    
+    transport.init(&C, &aws);
+    outbox.init(&C, &transport);
+    queue_boot_event();
+    cmd.init(&C, &transport, &outbox, &hard, &spool, &aws);  // commands can also come from the LAN broker, before AWS is up
+    ota.init(&C, &transport);
     comm_status = COMM_BROKEN;
-    if (init_wifi())
+    if (init_wifi()) {
+        prof.mark_boot(BOOT_WIFI);
         if (init_cloud())
             comm_status = COMM_OK;
+    }
     if (comm_status == COMM_OK)
         hard.blink2(); // green
     else      
         hard.blink3();  // red
     init_timers();       
     print_heap(); 
+    prof.mark_boot(BOOT_DONE);
+}
+    
+// the boot event waits in the outbox until a link is up
+void queue_boot_event() {
+    char  boot_msg[MAX_SHORT_STRING_LENGTH];
+    snprintf (boot_msg, MAX_SHORT_STRING_LENGTH-1, "{\"B\":\"%s [%s] V 2.%d starting..\"}", 
+              C.app_name, C.mac_address, C.current_firmware_version);
+    outbox.send(boot_msg);
 }
     
 bool init_wifi() {    
@@ -174,7 +237,7 @@ bool init_wifi() {
  
 bool init_cloud() {
     SERIAL_PRINTLN(F("\nConnecting to AWS cloud..."));
-    int result = aws.init(&C, false);  // this initializes Time Server, needed for the next two steps; 
+    int result = aws.init(&C, &time_mgr, false);  // this does not wait for the time server; see AWS::init_time_client()
     switch (result) {
       case AWS_CONNECT_SUCCESS:
         SERIAL_PRINTLN(F("Connected to AWS successfully."));
@@ -184,19 +247,16 @@ bool init_cloud() {
         return false;  // will not reach here
         break;    
       case TIME_SERVER_FAILED: 
-        SERIAL_PRINTLN(F("Time server failed."));    
-        return false;  // NOTE: you cannot connect to AWS without time server 
+        // NOTE: you cannot connect to AWS without time server; aws.update() connects as soon as it answers
+        SERIAL_PRINTLN(F("Time server has not answered yet."));    
         break;
       case AWS_CONNECT_FAILED:
         SERIAL_PRINTLN(F("Could not connect to AWS."));
         return false;
         break;
     }  
-    pClient = aws.getPubSubClient(); 
-    cmd.init(&C, pClient, &hard);
-    ota.init(&C, pClient);  // OTA; this needs the pubsub client from AWS class    
-    // priming read, based on time server
-    check_day_or_night(false);  
+    // priming read, based on time server (on the light, until it answers)
+    check_day_or_night(!time_mgr.is_valid());  
     SERIAL_PRINT (F("Time server-based time: "));
     SERIAL_PRINTLN(is_night ? "NIGHT": "DAY");    
     ////cmd.send_status(); status will be known only after the main loop starts
@@ -204,8 +264,10 @@ bool init_cloud() {
 }
 
 void init_timers() {
-    T.every(C.tick_interval, tick);
     T.every(C.sensor_interval, one_minute_logic);
+    T.every(SPOOL_DRAIN_INTERVAL, drain_spool);
+    if (C.metrics_minutes > 0)
+        T.every(60000L*C.metrics_minutes, send_metrics);
 #ifndef PORTICO_VERSION    
     T.every(C.check_interval, ten_second_logic);  // leaky bucket; for occupancy monitor only  
 #endif    
@@ -213,11 +275,22 @@ void init_timers() {
 }
   
 void loop() {
+    prof.note_loop();  // loop latency; see the LAT command
+    hard.update();     // background sensor conversions
+    if (hard.motion_pending())  // an edge from the PIR/radar interrupts
+        on_motion();
     T.update();
+    time_mgr.update();  // NTP in the background; returns at once
     // ASSUMPTION: if wifi connection is lost, it will auto connect after some time
-    if (WiFi.status()==WL_CONNECTED && comm_status==COMM_OK)   
-        aws.update();   
-    // TODO: if command_received flag is set, handle the command here, in this thread
+    if (WiFi.status()==WL_CONNECTED) {
+        if (comm_status==COMM_OK)   
+            aws.update();   
+        transport.update();  // the LAN broker; it also works when AWS could not be initialized
+        outbox.update();     // retransmissions
+    }
+    if (assembler.is_complete())
+        handle_long_message();
+    run_command_queue();  // commands received during aws.update() are executed here, outside the MQTT callback
 }
 //-------------------------------------------------------------------------------------------------
 
@@ -229,9 +302,9 @@ void restart_ESP () {
 void reset_wifi() {
     SERIAL_PRINTLN(F("\n*** ERASING ALL WI-FI CREDENTIALS ! ***"));   
     SERIAL_PRINTLN(F("You must configure WiFi after restarting"));
-    pClient->publish(C.mqtt_pub_topic, "{\"I\":\"Erasing all WiFi credentials !\"}");
+    transport.publish(C.mqtt_pub_topic, "{\"I\":\"Erasing all WiFi credentials !\"}");
     delay(500);
-    pClient->publish(C.mqtt_pub_topic, "{\"C\":\"Configure WiFi after restarting\"}");  
+    transport.publish(C.mqtt_pub_topic, "{\"C\":\"Configure WiFi after restarting\"}");  
     myfi.erase_wifi_credentials(true); // true = reboot ESP
 }
 
@@ -274,7 +347,7 @@ void check_day_or_night (bool light_based) {
     if (light_based)
         time_code = hard.is_night_time();  // This returns a ternary: day,night,unknown
     else    
-        time_code = aws.is_night_time();   // This *assumes* aws and time server are working
+        time_code = time_mgr.is_night_time();   // the local clock; unknown only if the time server never answered
            
     if (time_code == TIME_NIGHT)  {
         is_night = true;
@@ -305,29 +378,81 @@ void check_day_or_night (bool light_based) {
  }
 
 // one_minute_logic() is called every 1 minute by the Timer
-// Reads temperature, light etc. every one minute
+// Reads temperature, light etc. every one minute; sends them only if they changed, or the heartbeat is due
 // Contacts Time Server once in 5 minutes,  and stores it in the global variable is_night
 void one_minute_logic() {
-    bool time_for_status = hard.read_sensors(); //<- this returns true if it is time to send a status report, ie, 5 minutes elapsed
-    if (!time_for_status)
-        return;
-    if (comm_status == COMM_OK) {  // if AWS and time server were properly initialized at the beginning
-        check_day_or_night (false);  // this stores it in global variable is_night
-    #ifndef PORTICO_VERSION 
-        handle_transition();  // handle that one special case of day break
-    #endif
-        cmd.send_data();  // NOTE: pubsubclient.reconnect() is regulary called in aws.update()
-    } else {    // status is COMM_BROKEN
-        check_day_or_night (true);  // fall back on light based determination
+    bool time_for_data = hard.read_sensors(); //<- this returns true if a reading moved out of its deadband, or on heartbeat
+    bool time_for_status = hard.is_check_time(); //<- this returns true once in 5 minutes
+    if (comm_status == COMM_OK) {  // if AWS was properly initialized at the beginning (it may still await the time server)
+        if (time_for_status) {
+            check_day_or_night (!time_mgr.is_valid());  // this stores it in global variable is_night
+        #ifndef PORTICO_VERSION 
+            handle_transition();  // handle that one special case of day break
+        #endif
+        }
+    } else if (time_for_status) {    // status is COMM_BROKEN
+        check_day_or_night (!time_mgr.is_valid());  // the clock survives a cloud outage; else fall back on light
         repair_comm();    // this is to repair AWS initialization failure in init_cloud() at the beginning 
     }
+    if (time_for_data) {
+        if (!is_cloud_connected())    // the window statistics are not spooled
+            spool.append(hard.getData(), time_mgr.get_epoch());  // sent to AWS later by drain_spool()
+        if (transport.connected()) {  // AWS, or the LAN broker during an AWS outage
+            cmd.send_data();  // NOTE: pubsubclient.reconnect() is regulary called in aws.update()
+            cmd.send_stats();
+        }
+    }
+}
+
+bool is_cloud_connected() {
+    return (comm_status == COMM_OK && WiFi.status() == WL_CONNECTED && transport.cloud_connected());
+}
+
+// A message that came in parts: a config push {"P":{...}} (same keys as config.txt), or anything the
+// MQTT callback takes, such as a long batch. It is parsed in place; the strings point into the arena.
+void handle_long_message() {
+    DynamicJsonDocument doc(ASSEMBLY_DOC_SIZE);
+    DeserializationError error = deserializeJson(doc, assembler.message(), assembler.length());
+    if (error) {
+        SERIAL_PRINT(F("Long message: json deserialization failed: "));
+        SERIAL_PRINTLN(error.c_str());
+        transport.publish(C.mqtt_pub_topic, "{\"I\":\"MESSAGE-ERROR\"}");
+    }
+    else if (doc.containsKey("P")) {
+        if (C.apply_config(doc["P"]) == 0)
+            transport.publish(C.mqtt_pub_topic, "{\"C\":\"CONFIG-OK\"}");
+        else
+            transport.publish(C.mqtt_pub_topic, "{\"I\":\"CONFIG-ERROR\"}");
+    }
+    else
+        dispatch_message(doc);  // commands are queued, and run just after this
+    assembler.release();
+}
+
+// periodic connection health report; see metrics.h. Each report covers the Rx rate since the last one
+void send_metrics() {
+    if (!transport.connected())
+        return;
+    cmd.send_metrics();
+    metrics.start_window();
 }
 
-void tick() {
-    pir_status = hard.showPirStatus(); // this displays it on the LED and also returns the status 
-    radar_status = hard.showRadarStatus(); 
+// Sends the samples spooled during an outage, one small batch every SPOOL_DRAIN_INTERVAL;
+// so that a reconnect after a long outage does not flood the broker
+void drain_spool() {
+    if (spool.is_empty() || !is_cloud_connected())
+        return;
+    spool_sample batch[SPOOL_BATCH_SAMPLES];
+    short count = spool.read(batch, SPOOL_BATCH_SAMPLES, time_mgr.get_epoch());
+    spool.consume(cmd.send_history(batch, count));  // only what fitted into the message, and was published
+}
+
+// Called from the loop as soon as a motion sensor changes (the edge is captured by the GPIO interrupt),
+// and from ten_second_logic() while a sensor stays high. The LEDs are updated by the interrupt itself.
+void on_motion() {
+    pir_status = hard.getPir();
+    radar_status = hard.getRadar(); 
 #ifndef PORTICO_VERSION    
-    // TODO: increment hit counts (after implementing Button interface)
     if (!(pir_status || radar_status))  // no motion detected, nothing to do
         return;
     if ((!is_night) || cmd.manual_override)
@@ -368,6 +493,10 @@ void ten_second_logic() {
         return;      
     if (cmd.manual_override) 
         return;
+    if (hard.getPir() || hard.getRadar()) {  // there is no new edge while a sensor stays high; refill the bucket here
+        on_motion();
+        return;  // the bucket is full again; leaking it now would switch off one interval early
+    }
     leaky_bucket--;
     if (leaky_bucket > 0) // not yet timed out
         return;
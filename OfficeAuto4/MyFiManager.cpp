@@ -11,11 +11,63 @@ bool MyFiManager::init(Config *configptr) {
     SERIAL_PRINTLN(soft_AP_SSID);
     SERIAL_PRINT(F("Portal time out: "));
     SERIAL_PRINTLN(WIFI_PORTAL_TIMEOUT);    
+    if (fast_connect())
+        return true;
     bool wifi_result = wifi_manager_auto_connect();
     // TODO: tryagain with a different backup AP ?
+    if (wifi_result)
+        save_association();
     return wifi_result;
 }
 
+// Connects straight to the access point of the last session, on its channel: no scan. The address comes from
+// DHCP as usual. The credentials are the ones WiFiManager saved in the SDK's flash area.
+bool MyFiManager::fast_connect() {
+    wifi_record rec;
+    if (!rtc_load(RTC_SLOT_WIFI, &rec, sizeof(rec)))
+        return false;
+    String ssid = WiFi.SSID();
+    if (ssid.length() == 0)
+        return false;
+    SERIAL_PRINT(F("[WiFiMan] Fast connect to the last access point, channel "));
+    SERIAL_PRINTLN(rec.channel);
+    unsigned long start = millis();
+    WiFi.persistent(false);  // the BSSID and channel need not be written to flash on every boot
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(ssid.c_str(), WiFi.psk().c_str(), rec.channel, rec.bssid, true);
+    while (WiFi.status() != WL_CONNECTED) {
+        if (millis() - start > FAST_CONNECT_TIMEOUT) {
+            SERIAL_PRINTLN(F("[WiFiMan] Fast connect failed; falling back on a full scan"));
+            forget_association();
+            WiFi.disconnect();  // not persistent: the saved credentials stay
+            WiFi.persistent(true);
+            return false;
+        }
+        delay(10);
+    }
+    WiFi.persistent(true);
+    fast_connected = true;
+    save_association();  // the access point may have moved to another channel
+    SERIAL_PRINT(F("[WiFiMan] Connected in mSec: "));
+    SERIAL_PRINTLN(millis() - start);
+    SERIAL_PRINT(F("Local IP address: "));
+    SERIAL_PRINTLN(WiFi.localIP());     
+    return true;
+}
+
+void MyFiManager::save_association() {
+    wifi_record rec;
+    memcpy (rec.bssid, WiFi.BSSID(), sizeof(rec.bssid));
+    rec.channel = WiFi.channel();
+    rec.reserved = 0;
+    rtc_save(RTC_SLOT_WIFI, &rec, sizeof(rec));
+}
+
+// the next boot does a full scan
+void MyFiManager::forget_association() {
+    rtc_clear(RTC_SLOT_WIFI);
+}
+
 bool MyFiManager::wifi_manager_auto_connect() {
     // WiFiManager local intialization. Once its business is done, there is no need to keep it around
     WiFiManager wifiManager;
@@ -111,6 +163,7 @@ void MyFiManager::erase_wifi_credentials(bool reboot=true) {
     WiFiManager wifiManager;
     // erase all the stored wifi credentials:
     wifiManager.resetSettings();
+    forget_association();
     SERIAL_PRINTLN(F("WiFi credentials erased."));
     SERIAL_PRINTLN(F("Connect to INTOF_xxx AP and point your browser to 192.168.4.1"));   // TODO: use SOFT_AP_SSID
     if (reboot) {
@@ -6,18 +6,35 @@
 #include "common.h" 
 #include "config.h"
 #include "keys.h" 
+#include "rtcStore.h"
 #include <ESP8266WiFi.h>
 #include <WiFiManager.h>     // https://github.com/tzapu/WiFiManager 
  
+#define  FAST_CONNECT_TIMEOUT   3000   // mSec; a direct association and DHCP normally take well under a second
+
+// The last good association, kept in RTC memory: it survives a soft reset, an OTA restart and deep sleep,
+// but not a power cycle. Only the access point is kept, not the IP lease: the address always comes from DHCP,
+// so that it is renewed as the lease requires. (The RTC counter wraps every few hours, and cannot age a lease.)
+struct wifi_record {
+    byte     bssid[6];
+    byte     channel;
+    byte     reserved;
+};
+
 class  MyFiManager {
 public : 
+  bool fast_connected = false;  // this boot skipped the scan
+  
   bool init(Config *configptr);
   bool wifi_manager_auto_connect(); 
   void start_wifi_manager_portal();
   void erase_wifi_credentials (bool reboot);
+  void forget_association();
 
 private:
   Config *pC;
   char soft_AP_SSID[MAX_TINY_STRING_LENGTH];
+  bool fast_connect();
+  void save_association();
 };
 #endif
@@ -0,0 +1,79 @@
+// assembler.cpp
+
+#include "assembler.h"
+
+// the device's command topics are kept in MAX_SHORT_STRING_LENGTH buffers; even the longest must take a part
+static_assert (MAX_PART_DATA(MAX_SHORT_STRING_LENGTH-1) > 0, "no room for a part on the longest command topic");
+
+Assembler assembler;
+
+void Assembler::add_part (const byte* frame, unsigned int length) {
+    if (complete) {
+        errors++;
+        SERIAL_PRINTLN(F("--- Long message still pending; part refused ---"));
+        return;
+    }
+    if (length < PART_HEADER_LENGTH) {
+        errors++;
+        SERIAL_PRINTLN(F("--- Invalid part frame ---"));
+        return;
+    }
+    byte part_id = frame[2];
+    byte index = frame[3];
+    byte part_count = frame[4];
+    unsigned int data_length = length - PART_HEADER_LENGTH;
+    if (next_index != 0 && millis() - start_ms > ASSEMBLY_TIMEOUT)
+        abandon();  // timed out
+    if (index == 0) {
+        if (next_index != 0)
+            abandon();  // the sender started over
+        id = part_id;
+        count = part_count;
+        used = 0;
+        start_ms = millis();
+    } else if (next_index == 0 || part_id != id || index != next_index || part_count != count) {
+        if (next_index != 0)
+            abandon();  // a part went missing
+        else
+            errors++;   // the rest of a message that was already abandoned
+        return;
+    }
+    if (count == 0 || used + data_length >= ASSEMBLY_ARENA_SIZE) {  // room for the terminator
+        abandon();  // too long
+        return;
+    }
+    memcpy (arena + used, frame + PART_HEADER_LENGTH, data_length);
+    used += data_length;
+    parts++;
+    next_index = index + 1;
+    if (next_index == count) {
+        arena[used] = '\0';
+        next_index = 0;
+        complete = true;
+        messages++;
+    }
+}
+
+void Assembler::abandon() {
+    SERIAL_PRINTLN(F("--- Long message abandoned ---"));
+    errors++;
+    next_index = 0;
+    used = 0;
+}
+
+bool Assembler::is_complete() {
+    return complete;
+}
+
+char* Assembler::message() {
+    return arena;
+}
+
+unsigned int Assembler::length() {
+    return used;
+}
+
+void Assembler::release() {
+    complete = false;
+    used = 0;
+}
@@ -0,0 +1,53 @@
+// assembler.h
+// Messages longer than MAX_MSG_LENGTH (config pushes, long batches) arrive in parts, each one a small binary frame
+// that PubSubClient can take:
+//   B1 'P' id index count data...    index 0..count-1; data upto MAX_PART_DATA(topic length) bytes (python: frames.encode_parts)
+// A part must fit PubSubClient's packet with the MQTT header and the topic, not just MAX_MSG_LENGTH: PubSubClient
+// silently drops a longer packet. So the longer the topic, the smaller the parts.
+// The parts are copied into one fixed arena as they arrive, so memory is bounded whatever the sender does.
+// MQTT keeps the order of the messages on a topic, so the parts must come in order: a gap, a new id or a new
+// index 0 abandons the message under assembly. A complete message stays in the arena until the main loop has
+// handled it (see handle_long_message() in Main.ino); parts that arrive meanwhile are refused.
+
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include "common.h"
+#include <PubSubClient.h>       // MQTT_MAX_PACKET_SIZE
+
+#define  ASSEMBLY_ARENA_SIZE    2048    // bytes; the longest message, plus its terminator
+#define  ASSEMBLY_TIMEOUT       10000   // mSec; a message not completed in this time is abandoned
+#define  PART_HEADER_LENGTH     5       // magic, 'P', id, index, count
+#define  MQTT_PACKET_OVERHEAD   7       // fixed header (PubSubClient reserves 5 bytes) and the topic length (2)
+#define  MQTT_PAYLOAD_ROOM(topic_length)  (MQTT_MAX_PACKET_SIZE - MQTT_PACKET_OVERHEAD - (topic_length))
+#define  MAX_PART_DATA(topic_length)  ((MQTT_PAYLOAD_ROOM(topic_length) < MAX_MSG_LENGTH ? \
+                                        MQTT_PAYLOAD_ROOM(topic_length) : MAX_MSG_LENGTH) - PART_HEADER_LENGTH)
+#define  ASSEMBLY_DOC_SIZE      1536    // json nodes of a long message; the strings stay in the arena
+
+class Assembler {
+public:
+    unsigned long messages = 0;   // completed
+    unsigned long parts = 0;      // accepted
+    unsigned long errors = 0;     // parts refused or messages abandoned
+
+    void add_part (const byte* frame, unsigned int length);  // from the MQTT callback
+    bool is_complete();
+    char* message();              // null terminated; valid until release()
+    unsigned int length();
+    void release();
+
+private:
+    char  arena[ASSEMBLY_ARENA_SIZE];
+    unsigned int used = 0;
+    byte  id = 0;
+    byte  next_index = 0;         // 0 = no message under assembly
+    byte  count = 0;
+    bool  complete = false;
+    unsigned long start_ms = 0;
+    void abandon();
+};
+
+// filled by the MQTT callback (through notify_part in Main.ino), emptied by the main loop; JSN reports the counts
+extern Assembler assembler;
+
+#endif
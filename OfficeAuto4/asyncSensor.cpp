@@ -0,0 +1,39 @@
+// asyncSensor.cpp
+
+#include "asyncSensor.h"
+
+bool AsyncSensor::start() {
+    if (is_busy())
+        return false;
+    state = begin_conversion();
+    state_time = micros();
+    return true;
+}
+
+bool AsyncSensor::poll() {
+    if (!is_busy())
+        return false;
+    byte next = advance(state, micros() - state_time);
+    if (next == state)
+        return false;
+    state = next;
+    state_time = micros();
+    if (state == SENSOR_READY) {
+        conversions++;
+        last_result_time = millis();
+        return true;
+    }
+    if (state == SENSOR_FAILED) {
+        failures++;
+        return true;
+    }
+    return false;
+}
+
+bool AsyncSensor::is_busy() {
+    return (state == SENSOR_STARTING || state == SENSOR_CAPTURING);
+}
+
+byte AsyncSensor::get_state() {
+    return state;
+}
@@ -0,0 +1,38 @@
+// asyncSensor.h
+// Base class for slow sensors that are read without blocking the loop.
+// A conversion is started with start(); the main loop then calls poll() on every pass. poll() runs
+// the sensor specific advance() step, which returns at once, until it reports the result ready or failed.
+// Time critical parts (eg. capturing a bit stream) belong in an interrupt routine of the derived class.
+
+#ifndef ASYNC_SENSOR_H
+#define ASYNC_SENSOR_H
+
+#include "common.h"
+
+enum async_sensor_state {
+    SENSOR_IDLE,
+    SENSOR_STARTING,   // eg. the start pulse is being sent
+    SENSOR_CAPTURING,  // eg. the interrupt routine is collecting the response
+    SENSOR_READY,      // a new result is available
+    SENSOR_FAILED      // the last conversion failed; the previous result is still available
+};
+
+class AsyncSensor {
+public:
+    unsigned long conversions = 0;
+    unsigned long failures = 0;
+    unsigned long last_result_time = 0;  // millis() of the latest good result; 0 = none yet
+
+    bool start();  // false if a conversion is already running
+    bool poll();   // true once, when a conversion has just ended (ready or failed)
+    bool is_busy();
+    byte get_state();
+
+protected:
+    byte state = SENSOR_IDLE;
+    unsigned long state_time = 0;  // micros() when the current state was entered
+    virtual byte begin_conversion() = 0;  // returns the first state (SENSOR_STARTING or SENSOR_CAPTURING)
+    virtual byte advance (byte current_state, unsigned long elapsed_us) = 0;  // returns the next state
+};
+
+#endif
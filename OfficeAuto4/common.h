@@ -19,6 +19,7 @@ extern "C" {
 
 // keep MQTT Rx messages short (~100 bytes); PubSubClient silently drops long messages !
 #define  MAX_MSG_LENGTH              96  // MQTT message boxy (usully a json.dumps() string)
+#define  MAX_BATCH_COMMANDS          8   // {"C":["ON0","ON1","STA"]} is executed as one batch, with a single status reply
 // The following constants override those in PubSubClient
 #define  MQTT_KEEPALIVE              120  // override for PubSubClient keep alive, in seconds
 /////#define  MQTT_MAX_PACKET_SIZE   256  // PubSubClient default is 128, including headers
@@ -26,6 +27,19 @@ extern "C" {
 // comment out this line to disable some informative messages
 /////////#define  VERBOSE_MODE 
 
+// enable this line to compile the BEN command, which times the old strcmp() command lookup against the command table
+// (the host build in host/ always defines it)
+/////////#define  LOOKUP_BENCHMARK
+
+// Rx json is parsed in place: the document holds only the tree nodes; the strings stay in the MQTT buffer.
+// enable this line to go back to the copying parser (eg. to compare the two with the JSN command)
+/////////#define  COPYING_JSON_PARSE
+#ifdef COPYING_JSON_PARSE
+  #define  JSON_PARSE_DOC_SIZE  (MAX_MSG_LENGTH + JSON_ARRAY_SIZE(MAX_BATCH_COMMANDS))
+#else
+  #define  JSON_PARSE_DOC_SIZE  (2*JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(MAX_BATCH_COMMANDS))  // {"S":{"P":..,"V":..}}
+#endif
+
 // comment out this line to disable all serial messages
 #define ENABLE_DEBUG
 
@@ -45,8 +59,7 @@ extern "C" {
 #define  TIME_NIGHT     1
 #define  TIME_UNKNOWN   2
 
-#define  MAX_RELAYS     8  // assumption: there will not be more than 8 relays
-                           // TODO: in sevaral files you have hard coded values for NUM_RELAYS
+#define  MAX_RELAYS     8  // assumption: there will not be more than 8 relays (the relay state is a byte mask)
 
 struct data {
     char  relay_status[MAX_RELAYS+1]; 
@@ -56,6 +69,7 @@ struct data {
     int   light;
     int   pir_hits;
     int   radar_hits;
+    unsigned short window;  // number of the report window; the window statistics carry it too
 } ;
 
 enum {green=0, red=1}; // we use this as array index, so they have to be 0 and 1 only
@@ -83,7 +97,10 @@ enum connection_result {
     FILE_OPEN_ERROR,
     FILE_WRITE_ERROR,
     FILE_TOO_LARGE,
-    JSON_PARSE_ERROR
+    JSON_PARSE_ERROR,
+
+    PATCH_MISMATCH,   // no delta for the running build; the full image is downloaded instead
+    PATCH_FAILED
 } ;
 
 #endif
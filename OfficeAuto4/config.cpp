@@ -7,7 +7,106 @@
  subscribe: intof/bath/cmd/G1/0
  */
 
+// The parameter registry. One line per parameter: remote key, config.txt key, type, flags, member, bounds.
+// Adding a parameter here makes it available to GET/SET, dump() and load_config() at no extra lookup cost.
+#define  KEY(k)              k, param_hash(k)
+#define  NO_KEY              NULL, 0
+#define  MEMBER(m)           (unsigned short)offsetof(Config, m), (unsigned short)sizeof(((Config*)0)->m)
+#define  NO_MEMBER           0, 0
+#define  NO_BOUNDS           0, 0
+
+static constexpr param_entry param_registry[] = {
+    // the URL prefixes: SET changes the prefix, GET returns the full URL built from it
+    { KEY("OTAP"),   "OTA1",  -1, PARAM_PREFIX, 0, MEMBER(firmware_primary_prefix),      NO_BOUNDS, &Config::get_primary_OTA_url },
+    { KEY("OTAS"),   "OTA2",  -1, PARAM_PREFIX, 0, MEMBER(firmware_secondary_prefix),    NO_BOUNDS, &Config::get_secondary_OTA_url },
+    { KEY("CERTP"),  "CERT1", -1, PARAM_PREFIX, 0, MEMBER(certificate_primary_prefix),   NO_BOUNDS, &Config::get_primary_config_url },
+    { KEY("CERTS"),  "CERT2", -1, PARAM_PREFIX, 0, MEMBER(certificate_secondary_prefix), NO_BOUNDS, &Config::get_secondary_config_url },
+    { KEY("OTAPV"),  NULL,    -1, PARAM_GETTER, PARAM_READ_ONLY, NO_MEMBER, NO_BOUNDS, &Config::get_primary_version_url },
+    { KEY("OTASV"),  NULL,    -1, PARAM_GETTER, PARAM_READ_ONLY, NO_MEMBER, NO_BOUNDS, &Config::get_secondary_version_url },
+    { KEY("OTAPD"),  NULL,    -1, PARAM_GETTER, PARAM_READ_ONLY, NO_MEMBER, NO_BOUNDS, &Config::get_primary_delta_url },
+    { KEY("OTASD"),  NULL,    -1, PARAM_GETTER, PARAM_READ_ONLY, NO_MEMBER, NO_BOUNDS, &Config::get_secondary_delta_url },
+    { KEY("CERTPV"), NULL,    -1, PARAM_GETTER, PARAM_READ_ONLY, NO_MEMBER, NO_BOUNDS, &Config::get_primary_certificate_version_url },
+    { KEY("CERTSV"), NULL,    -1, PARAM_GETTER, PARAM_READ_ONLY, NO_MEMBER, NO_BOUNDS, &Config::get_secondary_certificate_version_url },
+    // MAC address spoofing - use it only for testing purposes ! MAC is used in MQTT client ID
+    // Warning: any duplicate MQTT client IDs will result in malfunctioning, rebooting etc
+    { KEY("MAC"),    NULL,    -1, PARAM_STRING, PARAM_DERIVED, MEMBER(mac_address), NO_BOUNDS, NULL },
+    // TODO: resubscribe to the new topic when these change; until then ORG and APP are read only 
+    { KEY("ORG"),    "ORG",   -1, PARAM_STRING, PARAM_DERIVED | PARAM_READ_ONLY, MEMBER(org_id), NO_BOUNDS, NULL },
+    { KEY("GRP"),    "GRP",   -1, PARAM_STRING, PARAM_DERIVED, MEMBER(group_id), NO_BOUNDS, NULL },
+    { KEY("APP"),    "APP",   -1, PARAM_STRING, PARAM_DERIVED | PARAM_READ_ONLY, MEMBER(app_id), NO_BOUNDS, NULL },
+    // the LAN broker; a change takes effect at the next connection to it
+    { KEY("LBRK"),   "LOCAL_BROKER", -1, PARAM_STRING, 0, MEMBER(local_broker), NO_BOUNDS, NULL },
+    { KEY("LPORT"),  "LOCAL_PORT",   -1, PARAM_INT,    0, MEMBER(local_port), 1, 65535, NULL },
+    { KEY("LUSER"),  "LOCAL_USER",   -1, PARAM_STRING, 0, MEMBER(local_user), NO_BOUNDS, NULL },
+    { KEY("LPASS"),  "LOCAL_PASS",   -1, PARAM_STRING, PARAM_SECRET, MEMBER(local_password), NO_BOUNDS, NULL },
+    { KEY("CERTV"),  "CERT_VER",   -1, PARAM_SHORT, PARAM_READ_ONLY, MEMBER(current_certificate_version), 0, 32767, NULL },
+    { KEY("ACTL"),   "ACTIVE_LOW", -1, PARAM_BOOL,  PARAM_DERIVED, MEMBER(active_low), 0, 1, NULL },
+    { KEY("PRIREL"), "PRIMARY_REL",-1, PARAM_SHORT, 0, MEMBER(primary_relay), 0, NUM_RELAYS-1, NULL },
+    { KEY("RTRIG"),  "RADAR_TRIG", -1, PARAM_BOOL,  0, MEMBER(radar_triggers), 0, 1, NULL },
+    // telemetry format, negotiated per device: the cloud sets BIN once it can decode the frames
+    { KEY("BIN"),    "BINARY",     -1, PARAM_BOOL,  0, MEMBER(binary_frames), 0, 1, NULL },
+    // connection health; the period takes effect only from the config file (the timer is set up at start)
+    { KEY("METM"),   "METRICS_MIN", -1, PARAM_INT,  PARAM_READ_ONLY, MEMBER(metrics_minutes), 0, 1440, NULL },
+    { KEY("ECHO"),   "RTT_ECHO",    -1, PARAM_BOOL, 0, MEMBER(rtt_echo), 0, 1, NULL },
+    // likewise, the cloud sets ACK once it acknowledges the events
+    { KEY("ACK"),    "ACK_EVENTS", -1, PARAM_BOOL,  0, MEMBER(ack_events), 0, 1, NULL },
+    // the auto off ticks are computed once at start up; so these two take effect only from the config file
+    { KEY("STATF"),  "STAT_FREQ_MIN", -1, PARAM_INT,   PARAM_READ_ONLY, MEMBER(status_report_frequency), 1, 1440, NULL },
+    { KEY("AOFF"),   "AUTO_OFF_MIN",  -1, PARAM_FLOAT, PARAM_READ_ONLY, MEMBER(auto_off_minutes), 0.1, 1440, NULL },
+    // telemetry deadbands; they take effect from the next reading
+    { KEY("HBEAT"),  "HEARTBEAT_MIN", -1, PARAM_INT,   0, MEMBER(heartbeat_minutes),    1, 1440, NULL },
+    { KEY("TDB"),    "TEMP_DB",       -1, PARAM_FLOAT, 0, MEMBER(temperature_deadband), 0, 50, NULL },
+    { KEY("HDB"),    "HUMI_DB",       -1, PARAM_FLOAT, 0, MEMBER(humidity_deadband),    0, 100, NULL },
+    { KEY("LDB"),    "LIGHT_DB",      -1, PARAM_INT,   0, MEMBER(light_deadband),       0, 1023, NULL },
+    { KEY("HITDB"),  "HIT_DB",        -1, PARAM_INT,   0, MEMBER(hit_deadband),         1, 32767, NULL },
+    { KEY("NHRS"),   NULL,    -1, PARAM_STRING, PARAM_READ_ONLY, MEMBER(night_hours_str), NO_BOUNDS, NULL },
+    { NO_KEY,        "NIGHT_HRS",   0, PARAM_SHORT, PARAM_DERIVED, MEMBER(night_start_hour),   0, 23, NULL },
+    { NO_KEY,        "NIGHT_HRS",   1, PARAM_SHORT, PARAM_DERIVED, MEMBER(night_start_minute), 0, 59, NULL },
+    { NO_KEY,        "NIGHT_HRS",   2, PARAM_SHORT, PARAM_DERIVED, MEMBER(night_end_hour),     0, 23, NULL },
+    { NO_KEY,        "NIGHT_HRS",   3, PARAM_SHORT, PARAM_DERIVED, MEMBER(night_end_minute),   0, 59, NULL },
+    { KEY("LTH"),    NULL,    -1, PARAM_GETTER, PARAM_READ_ONLY, NO_MEMBER, NO_BOUNDS, &Config::get_light_thresholds },
+    { NO_KEY,        "DAY_LIGHT",   -1, PARAM_INT, 0, MEMBER(day_light_threshold),   0, 1023, NULL },
+    { NO_KEY,        "NIGHT_LIGHT", -1, PARAM_INT, 0, MEMBER(night_light_threshold), 0, 1023, NULL }
+};
+#define  NUM_PARAMS   (sizeof(param_registry)/sizeof(param_registry[0]))
+
+// the entries that have a remote key, ie. the ones in the hash index
+constexpr byte count_keyed_params (const param_entry* e, byte n) {
+    return (n == 0) ? 0 : (e->key != NULL) + count_keyed_params(e+1, n-1);
+}
+#define  NUM_KEYED_PARAMS   count_keyed_params(param_registry, NUM_PARAMS)
+// the index must never fill up: find_param() stops only at an empty slot. At most half full, the probes stay short.
+static_assert (2*NUM_KEYED_PARAMS <= PARAM_SLOTS, "PARAM_SLOTS is too small for the registry");
+static_assert ((PARAM_SLOTS & (PARAM_SLOTS-1)) == 0, "PARAM_SLOTS must be a power of 2");
+
 Config::Config(){
+    build_param_index();
+}
+
+// places every remotely accessible parameter in a hash slot (open addressing, linear probing)
+void Config::build_param_index() {
+    memset (param_index, 0, sizeof(param_index));
+    for (byte i=0; i<NUM_PARAMS; i++) {
+        if (param_registry[i].key == NULL)
+            continue;
+        int slot = param_registry[i].hash & (PARAM_SLOTS-1);
+        while (param_index[slot] != 0)
+            slot = (slot+1) & (PARAM_SLOTS-1);
+        param_index[slot] = i+1;
+    }
+}
+
+// returns NULL for an unknown key
+const param_entry* Config::find_param (const char* key) {
+    uint32_t h = param_hash(key);
+    int slot = h & (PARAM_SLOTS-1);
+    while (param_index[slot] != 0) {
+        const param_entry* e = &param_registry[param_index[slot]-1];
+        if (e->hash == h && strcmp(e->key, key) == 0)
+            return e;
+        slot = (slot+1) & (PARAM_SLOTS-1);
+    }
+    return NULL;
 }
 
 // returns false if TLS certificates are missing; true in all other scenarios 
@@ -21,6 +120,9 @@ bool Config::init() {
     safe_strncpy (app_id, APP_ID, MAX_TINY_STRING_LENGTH);
     safe_strncpy (org_id, ORG_ID, MAX_TINY_STRING_LENGTH);
     safe_strncpy (group_id, GROUP_ID, MAX_TINY_STRING_LENGTH);    
+    safe_strncpy (local_broker, LOCAL_BROKER, MAX_SHORT_STRING_LENGTH);
+    safe_strncpy (local_user, LOCAL_BROKER_USER, MAX_TINY_STRING_LENGTH);
+    safe_strncpy (local_password, LOCAL_BROKER_PASSWORD, MAX_SHORT_STRING_LENGTH);
     // the firmware URLs will later be concatenated with the intervening slash; so remove them if present
     safe_strncpy_remove_slash (firmware_primary_prefix,  FW_PRIMARY_PREFIX, MAX_LONG_STRING_LENGTH);
     safe_strncpy_remove_slash (firmware_secondary_prefix, FW_BACKUP_PREFIX, MAX_LONG_STRING_LENGTH);    
@@ -40,6 +142,12 @@ bool Config::init() {
     return true;
 }
 
+// snprintf() returns the length it would have written; a topic or a URL that was cut short is wrong, not just short
+static void check_length (int length, int size) {
+    if (length >= size-1)
+        SERIAL_PRINTLN(F("***** String is too long !! TRUNCATED ******"));
+}
+
 // parameters that depend on other parameters initialized earlier
 void Config::make_derived_params() {
     ON  = active_low ? 0 : 1;
@@ -47,17 +155,23 @@ void Config::make_derived_params() {
     snprintf(night_hours_str, MAX_TINY_STRING_LENGTH-1, "%d:%d - %d:%d", night_start_hour, night_start_minute,
              night_end_hour,night_end_minute);
              
-    snprintf (mqtt_pub_topic, MAX_SHORT_STRING_LENGTH-1, "%s/%s/%s/%s/%s", org_id, app_id, PUB_TOPIC_PREFIX, group_id, mac_address); 
-    snprintf (mqtt_sub_topic, MAX_SHORT_STRING_LENGTH-1, "%s/%s/%s/%s/%s", org_id, app_id, SUB_TOPIC_PREFIX, group_id, mac_address);
-    snprintf (mqtt_broadcast_topic, MAX_SHORT_STRING_LENGTH-1, "%s/%s/%s/%s/%s", org_id, app_id, SUB_TOPIC_PREFIX, group_id,
-              UNIVERSAL_DEVICE_ID);    
+    check_length (snprintf (mqtt_pub_topic, MAX_SHORT_STRING_LENGTH-1, "%s/%s/%s/%s/%s", org_id, app_id, PUB_TOPIC_PREFIX, group_id, mac_address), MAX_SHORT_STRING_LENGTH); 
+    check_length (snprintf (mqtt_sub_topic, MAX_SHORT_STRING_LENGTH-1, "%s/%s/%s/%s/%s", org_id, app_id, SUB_TOPIC_PREFIX, group_id, mac_address), MAX_SHORT_STRING_LENGTH);
+    check_length (snprintf (mqtt_broadcast_topic, MAX_SHORT_STRING_LENGTH-1, "%s/%s/%s/%s/%s", org_id, app_id, SUB_TOPIC_PREFIX, group_id,
+              UNIVERSAL_DEVICE_ID), MAX_SHORT_STRING_LENGTH);    
+}
+
+// the value of a registry entry in the parsed config file; NIGHT_HRS is an array
+static JsonVariant json_value (JsonVariant root, const param_entry* e) {
+    if (e->json_index < 0)
+        return root[e->json_key];
+    return root[e->json_key][e->json_index];
 }
 
 int Config::load_config() {
     SERIAL_PRINTLN(F("Loading config from Flash..."));
-    if (!SPIFFS.begin()) {
+    if (!mount_file_system()) {  // it stays mounted; see utilities.cpp
         SERIAL_PRINTLN(F("--- Failed to mount file system. ---"));
-        ///SPIFFS.end();
         return SPIFF_FAILED;
     }
     // quick check if security certificates are at least present
@@ -66,7 +180,6 @@ int Config::load_config() {
         SERIAL_PRINTLN (file_names[i]);
         if (!SPIFFS.exists(file_names[i])) {
             SERIAL_PRINTLN(F("*** TLS certificate file missing ! ***"));
-            SPIFFS.end();
             return TLS_CERTIFICATE_FAILED;
         }
     }
@@ -75,7 +188,6 @@ int Config::load_config() {
     File configFile = SPIFFS.open(CONFIG_FILE_NAME, "r");
     if (!configFile) {
         SERIAL_PRINTLN(F("--- Failed to open config file. ---"));
-        SPIFFS.end();
         return FILE_OPEN_ERROR;
     }
     size_t size = configFile.size();
@@ -83,7 +195,6 @@ int Config::load_config() {
     SERIAL_PRINTLN(size);    
     if (size > CONFIG_FILE_SIZE) {
         SERIAL_PRINTLN(F("--- Config file size is too large. ---"));
-        SPIFFS.end();
         return FILE_TOO_LARGE;
     }
     // Allocate a buffer to store file contents ***
@@ -98,46 +209,44 @@ int Config::load_config() {
     SERIAL_PRINTLN (error.c_str());
     if (error) {
         SERIAL_PRINTLN(F("--- Failed to parse config file. ---"));
-        SPIFFS.end();
         return JSON_PARSE_ERROR;
     }
-    // string variables
-    char *tmp;
-    tmp = (char *)(doc["OTA1"] | FW_PRIMARY_PREFIX); 
-    safe_strncpy_remove_slash (firmware_primary_prefix, tmp, MAX_LONG_STRING_LENGTH);
-    tmp = (char *)(doc["OTA2"] | FW_BACKUP_PREFIX); 
-    safe_strncpy_remove_slash (firmware_secondary_prefix, tmp, MAX_LONG_STRING_LENGTH);   
-    tmp = (char *)(doc["CERT1"] | CERTIFICATE_PRIMARY_PREFIX); 
-    safe_strncpy_remove_slash (certificate_primary_prefix, tmp, MAX_LONG_STRING_LENGTH);
-    tmp = (char *)(doc["CERT2"] | CERTIFICATE_BACKUP_PREFIX); 
-    safe_strncpy_remove_slash (certificate_secondary_prefix, tmp, MAX_LONG_STRING_LENGTH); 
-    
-    tmp = (char *)(doc["GRP"] | GROUP_ID); 
-    safe_strncpy (group_id, tmp, MAX_TINY_STRING_LENGTH);
-    tmp = (char *)(doc["ORG"] | ORG_ID); 
-    safe_strncpy (org_id, tmp, MAX_TINY_STRING_LENGTH);
-    tmp = (char *)(doc["APP"] | APP_ID); 
-    safe_strncpy (app_id, tmp, MAX_TINY_STRING_LENGTH); 
-    
-    // Non-string variables       
-    current_certificate_version = doc["CERT_VER"] | CERTIFICATE_VERSION;
-    active_low = doc["ACTIVE_LOW"] | ACTIVE_LOW_RELAY; 
-    primary_relay = doc["PRIMARY_REL"] | PRIMARY_RELAY; 
-    radar_triggers = doc["RADAR_TRIG"] | RADAR_TRIGGERS; 
-    status_report_frequency = doc["STAT_FREQ_MIN"] | STATUS_FREQUENCEY; 
-    auto_off_minutes = doc["AUTO_OFF_MIN"] | AUTO_OFF_TIME_MIN;   
-    night_start_hour = doc["NIGHT_HRS"][0] | NIGHT_START_HOUR; 
-    night_start_minute = doc["NIGHT_HRS"][1] | NIGHT_START_MINUTE; 
-    night_end_hour = doc["NIGHT_HRS"][2] | NIGHT_END_HOUR; 
-    night_end_minute = doc["NIGHT_HRS"][3] | NIGHT_END_MINUTE; 
-    day_light_threshold = doc["DAY_LIGHT"] | DAY_LIGHT_THRESHOLD;
-    night_light_threshold = doc["NIGHT_LIGHT"] | NIGHT_LIGHT_THRESHOLD;   
-     
+    // a missing key leaves the default (from settings.h and keys.h) in place
+    load_params(doc.as<JsonVariant>(), false);
+    return CODE_OK;
+}
+
+int Config::apply_config (JsonVariant params) {
+    if (!params.is<JsonObject>())
+        return 1;
+    return load_params(params, true);
+}
+
+// a missing key leaves the current value in place; returns the number of invalid values
+int Config::load_params (JsonVariant root, bool remote) {
+    int errors = 0;
+    for (byte i=0; i<NUM_PARAMS; i++) {
+        const param_entry* e = &param_registry[i];
+        if (e->json_key == NULL)
+            continue;
+        JsonVariant v = json_value(root, e);
+        if (v.isNull())
+            continue;
+        if (remote && (e->flags & PARAM_READ_ONLY)) {
+            SERIAL_PRINT(F("--- Read only parameter: "));
+            SERIAL_PRINTLN(e->json_key);
+            errors++;
+            continue;
+        }
+        if (load_param(e, v)) {
+            SERIAL_PRINT(F("--- Invalid value in config for: "));
+            SERIAL_PRINTLN(e->json_key);
+            errors++;
+        }
+    }
     // now that the main parameters are in place, set up the derived parameters:
     make_derived_params();
-    
-    SPIFFS.end();  // unmount file system
-    return CODE_OK;
+    return errors;
 }
 
 void Config::dump() {
@@ -195,26 +304,15 @@ void Config::dump() {
     SERIAL_PRINT(F("Broadcast topic (sub): "));
     SERIAL_PRINTLN (mqtt_broadcast_topic);  
     SERIAL_PRINTLN();
-    // the autonomous relay, which is triggered by movement, time of the day etc.
-    SERIAL_PRINT(F("primary (autonomous) realy number: "));
-    SERIAL_PRINTLN (primary_relay);   
-    // some relay modules need active LOW signals, ie, logic 0 operates the relay and 1 releases it
-    SERIAL_PRINT(F("active LOW relays ?: "));
-    SERIAL_PRINTLN (active_low? "Yes":"No");          
-    // to transition from unoccupied to occupied status, should radar also fire ? (0=only PIR; 1=both radar & PIR need to fire)
-    SERIAL_PRINT(F("radar triggers occupancy?: "));
-    SERIAL_PRINTLN (radar_triggers ? "Yes":"No");   
-    // time based automatic lights; hour and minute in 24 hour format 
-    SERIAL_PRINT(F("Night hours: "));
-    SERIAL_PRINTLN (night_hours_str); 
-    SERIAL_PRINT(F("Day/Night Light threshold: "));
-    SERIAL_PRINT (day_light_threshold);
-    SERIAL_PRINT(F(" / "));
-    SERIAL_PRINTLN(night_light_threshold); 
-    SERIAL_PRINT(F("status report frequency (minutes): "));
-    SERIAL_PRINTLN (status_report_frequency);        
-    SERIAL_PRINT(F("auto off minutes: "));
-    SERIAL_PRINTLN (auto_off_minutes);      
+    SERIAL_PRINTLN(F("Parameters:"));
+    for (byte i=0; i<NUM_PARAMS; i++) {
+        const param_entry* e = &param_registry[i];
+        if (e->key == NULL || e->type == PARAM_GETTER)  // the URLs are already listed above
+            continue;
+        SERIAL_PRINT(e->key);
+        SERIAL_PRINT(F(": "));
+        SERIAL_PRINTLN(format_param(e));
+    }
     SERIAL_PRINT(F("auto off ticks: "));
     SERIAL_PRINTLN (get_auto_off_ticks());             
     yield();
@@ -241,49 +339,62 @@ int Config::get_auto_off_ticks() {
 // NOTE: the following two functions introduce a slash between the prefix and the file name; so this should not
 // be added in the prefix string (it would have been removed, if present)
 const char* Config::get_primary_certificate_version_url() {
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s?X=%d", certificate_primary_prefix, CERT_VERSION_FILE, random(0,1000));  
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s?X=%ld", certificate_primary_prefix, CERT_VERSION_FILE, random(0,1000)), MAX_LONG_STRING_LENGTH);  
     return ((const char*) reusable_string);
 }
 
 const char* Config::get_secondary_certificate_version_url(){
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s?X=%d", certificate_secondary_prefix, CERT_VERSION_FILE, random(0,1000));  
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s?X=%ld", certificate_secondary_prefix, CERT_VERSION_FILE, random(0,1000)), MAX_LONG_STRING_LENGTH);  
     return ((const char*) reusable_string);
 }
 
 // NOTE: the following two functions do not add a slash between the prefix and the file name, since the SPIFF file name
 // already should have a mandatory leading slash.
 const char* Config::get_primary_certificate_url (short file_number){
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s%s?X=%d", certificate_primary_prefix, file_names[file_number], random(0,1000));  
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s%s?X=%ld", certificate_primary_prefix, file_names[file_number], random(0,1000)), MAX_LONG_STRING_LENGTH);  
     return ((const char*) reusable_string);
 }
 
 const char* Config::get_secondary_certificate_url (short file_number){
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s%s?X=%d", certificate_secondary_prefix, file_names[file_number], random(0,1000));  
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s%s?X=%ld", certificate_secondary_prefix, file_names[file_number], random(0,1000)), MAX_LONG_STRING_LENGTH);  
     return ((const char*) reusable_string);
 }
 
 // NOTE: these functions introduce the slash again;so  the prefix should not have it.
 const char*  Config::get_primary_OTA_url() {
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.bin?X=%d", firmware_primary_prefix, app_id, 
-    random(0,1000));  
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.bin?X=%ld", firmware_primary_prefix, app_id, 
+    random(0,1000)), MAX_LONG_STRING_LENGTH);  
     return ((const char*) reusable_string);
 }
 
 const char*  Config::get_primary_version_url() {
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.txt?X=%d", firmware_primary_prefix, app_id, 
-    random(0,1000));
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.txt?X=%ld", firmware_primary_prefix, app_id, 
+    random(0,1000)), MAX_LONG_STRING_LENGTH);
     return ((const char*) reusable_string);    
 }
 
 const char*  Config::get_secondary_OTA_url() {
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.bin?X=%d", firmware_secondary_prefix, app_id, 
-    random(0,1000));
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.bin?X=%ld", firmware_secondary_prefix, app_id, 
+    random(0,1000)), MAX_LONG_STRING_LENGTH);
     return ((const char*) reusable_string);    
 }
 
 const char*  Config::get_secondary_version_url() {
-    snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.txt?X=%d", firmware_secondary_prefix, app_id, 
-    random(0,1000));
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s.txt?X=%ld", firmware_secondary_prefix, app_id, 
+    random(0,1000)), MAX_LONG_STRING_LENGTH);
+    return ((const char*) reusable_string);    
+}
+
+// the delta from the running version to the latest one: python/make_delta.py names it <app_id>-<from version>.delta
+const char*  Config::get_primary_delta_url() {
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s-%d.delta?X=%ld", firmware_primary_prefix, app_id, 
+    current_firmware_version, random(0,1000)), MAX_LONG_STRING_LENGTH);
+    return ((const char*) reusable_string);    
+}
+
+const char*  Config::get_secondary_delta_url() {
+    check_length (snprintf (reusable_string, MAX_LONG_STRING_LENGTH-1, "%s/%s-%d.delta?X=%ld", firmware_secondary_prefix, app_id, 
+    current_firmware_version, random(0,1000)), MAX_LONG_STRING_LENGTH);
     return ((const char*) reusable_string);    
 }
 
@@ -344,62 +455,129 @@ const char* Config::get_error_message (int error_code) {
         return ("FILE_TOO_LARGE"); break;      
     case JSON_PARSE_ERROR:
         return ("JSON_PARSE_ERROR"); break;                               
+    case PATCH_MISMATCH:
+        return ("PATCH_MISMATCH"); break;
+    case PATCH_FAILED:
+        return ("PATCH_FAILED"); break;
     default:
         return("UNCONFIGURED ERROR !"); break;
   }
 }
 
+const char* Config::get_primary_config_url() {
+    return (get_primary_certificate_url(0));  // config.txt is the first file
+}
+
+const char* Config::get_secondary_config_url() {
+    return (get_secondary_certificate_url(0));
+}
+
+const char* Config::get_light_thresholds() {
+    snprintf(reusable_string, MAX_TINY_STRING_LENGTH, "Day:%d , Night:%d", day_light_threshold,night_light_threshold);
+    return ((const char*)reusable_string);
+}
+
+// renders the current value of a parameter into reusable_string (or returns the member string itself)
+const char* Config::format_param (const param_entry* e) {
+    if (e->getter != NULL)
+        return ((this->*(e->getter))());
+    if (e->flags & PARAM_SECRET)
+        return ("***");
+    byte* member = (byte*)this + e->offset;
+    switch (e->type) {
+        case PARAM_STRING:
+        case PARAM_PREFIX:
+            return ((const char*)member);
+        case PARAM_BOOL:
+            return (*(bool*)member ? "1" : "0");
+        case PARAM_SHORT:
+            itoa (*(short*)member, reusable_string, 10);
+            break;
+        case PARAM_INT:
+            itoa (*(int*)member, reusable_string, 10);
+            break;
+        case PARAM_FLOAT:
+            snprintf(reusable_string, MAX_TINY_STRING_LENGTH, "%.2f", *(float*)member);
+            break;
+    }
+    return ((const char*)reusable_string);
+}
+
+// parses and stores a value; * returns true if there was an error, false otherwise *
+bool Config::store_param (const param_entry* e, const char* value) {
+    byte* member = (byte*)this + e->offset;
+    char* end;
+    switch (e->type) {
+        case PARAM_STRING:
+            return (safe_strncpy ((char*)member, value, e->size));
+        case PARAM_PREFIX:
+            return (safe_strncpy_remove_slash ((char*)member, value, e->size));
+        case PARAM_BOOL:
+            if ((value[0] != '0' && value[0] != '1') || value[1] != '\0')
+                return true;
+            *(bool*)member = (value[0] == '1');
+            return false;
+        case PARAM_SHORT:
+        case PARAM_INT: {
+            long n = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || n < e->min_value || n > e->max_value) 
+                return true;
+            if (e->type == PARAM_SHORT)
+                *(short*)member = (short)n;
+            else
+                *(int*)member = (int)n;
+            return false;
+        }
+        case PARAM_FLOAT: {
+            float f = strtod(value, &end);
+            if (end == value || *end != '\0' || f < e->min_value || f > e->max_value) 
+                return true;
+            *(float*)member = f;
+            return false;
+        }
+    }
+    return true;  // getters cannot be set
+}
+
+// the config file has typed json values; strings go through the same path as a remote SET
+bool Config::load_param (const param_entry* e, JsonVariant v) {
+    byte* member = (byte*)this + e->offset;
+    switch (e->type) {
+        case PARAM_STRING:
+        case PARAM_PREFIX: {
+            const char* str = v.as<const char*>();
+            if (str == NULL)
+                return true;
+            return (store_param(e, str));
+        }
+        case PARAM_BOOL:
+            *(bool*)member = (v.as<int>() != 0);
+            return false;
+        case PARAM_SHORT:
+        case PARAM_INT:
+        case PARAM_FLOAT: {
+            float f = v.as<float>();
+            if (f < e->min_value || f > e->max_value)
+                return true;  // keep the default
+            if (e->type == PARAM_SHORT)
+                *(short*)member = (short)f;
+            else if (e->type == PARAM_INT)
+                *(int*)member = (int)f;
+            else
+                *(float*)member = f;
+            return false;
+        }
+    }
+    return true;
+}
+
 // Get commands are in the form {"G":"param"}
 const char* Config::get_param (const char* param) {
     SERIAL_PRINT(F("Get: "));
     SERIAL_PRINTLN(param);
-    // the following calls return the full URL, not just the prefix 
-    if (strcmp(param, "OTAP") == 0)
-        return (get_primary_OTA_url());
-    if (strcmp(param, "OTAS") == 0)
-        return (get_secondary_OTA_url());
-    if (strcmp(param, "OTAPV") == 0)
-        return (get_primary_version_url());
-    if (strcmp(param, "OTASV") == 0)
-        return (get_secondary_version_url());        
-    if (strcmp(param, "CERTP") == 0)
-        return (get_primary_certificate_url(0));
-    if (strcmp(param, "CERTS") == 0)
-        return (get_secondary_certificate_url(0));  
-    if (strcmp(param, "CERTPV") == 0)
-        return (get_primary_certificate_version_url());
-    if (strcmp(param, "CERTSV") == 0)
-        return (get_secondary_certificate_version_url());  
-    if (strcmp(param, "MAC") == 0)  // this is just for completeness;
-        return ((const char*)mac_address);  // this is availabe through {"C":"MAC"} also
-    if (strcmp(param, "ORG") == 0)
-        return ((const char*)org_id);
-    if (strcmp(param, "GRP") == 0)
-        return ((const char*)group_id);  
-    if (strcmp(param, "APP") == 0)
-        return ((const char*)app_id); 
-    if (strcmp(param, "ACTL") == 0)
-        return (active_low? "AL:1" : "AL:0");    
-    if (strcmp(param, "RTRIG") == 0)      
-        return (radar_triggers? "RT:1" : "RT:0");            
-    if (strcmp(param, "PRIREL") == 0) {
-        itoa (primary_relay, reusable_string, 10);
-        return ((const char*)reusable_string);
-    } 
-    if (strcmp(param, "STATF") == 0) {
-        itoa (status_report_frequency, reusable_string, 10);
-        return ((const char*)reusable_string);
-    }
-    if (strcmp(param, "AOFF") == 0) {
-        itoa (auto_off_minutes, reusable_string, 10);
-        return ((const char*)reusable_string);
-    }
-    if (strcmp(param, "NHRS") == 0) 
-        return ((const char*)night_hours_str);
-    if (strcmp(param, "LTH") == 0) {
-        snprintf(reusable_string, MAX_TINY_STRING_LENGTH, "Day:%d , Night:%d", day_light_threshold,night_light_threshold);
-        return ((const char*)reusable_string);         
-    } 
+    const param_entry* e = find_param(param);
+    if (e != NULL)
+        return (format_param(e));
     SERIAL_PRINTLN (F("--- ERROR: Unknown parameter ---"));   
     snprintf(reusable_string, MAX_TINY_STRING_LENGTH, "ERROR");
     return ((const char*)reusable_string);  
@@ -413,84 +591,20 @@ bool Config::set_param (const char* param, const char* value) {
     SERIAL_PRINTLN(param);
     SERIAL_PRINT(F("Value: ")); 
     SERIAL_PRINTLN(value);   
-    bool truncated = false;
-    // MAC address spoofing - use it only for testing purposes ! MAC is used in MQTT client ID
-    // Warning: any duplicate MQTT client IDs will result in malfunctioning, rebooting etc
-    if (strcmp(param, "MAC") == 0) {
-        truncated = safe_strncpy (mac_address, value, MAC_ADDRESS_LENGTH-1);
-        if (!truncated)
-            make_derived_params();
-        return truncated;
-    }    
-    // the following calls only set the prefix, not the full URL
-    if (strcmp(param, "OTAP") == 0) {
-        truncated = safe_strncpy_remove_slash (firmware_primary_prefix, value, MAX_LONG_STRING_LENGTH);
-        return truncated;
+    const param_entry* e = find_param(param);
+    if (e == NULL) {
+        SERIAL_PRINTLN (F("--- ERROR: Unknown parameter ---"));     
+        return true; // ERROR
     }
-    if (strcmp(param, "OTAS") == 0) {
-        truncated = safe_strncpy_remove_slash (firmware_secondary_prefix, value, MAX_LONG_STRING_LENGTH);
-        return truncated;
+    if (e->flags & PARAM_READ_ONLY) {
+        SERIAL_PRINTLN (F("--- ERROR: Read only parameter ---"));     
+        return true;
     }
-    if (strcmp(param, "CERTP") == 0) {
-        truncated = safe_strncpy_remove_slash (certificate_primary_prefix, value, MAX_LONG_STRING_LENGTH);
-        return truncated;
+    if (store_param(e, value)) {
+        SERIAL_PRINTLN (F("--- ERROR: Invalid value ---"));     
+        return true;
     }
-    if (strcmp(param, "CERTS") == 0) {
-        safe_strncpy_remove_slash (certificate_secondary_prefix, value, MAX_LONG_STRING_LENGTH);
-        return truncated;
-    }
-    if (strcmp(param, "GRP") == 0) {     
-        safe_strncpy (group_id, value, MAX_TINY_STRING_LENGTH);
-        if (!truncated) {
-            make_derived_params(); 
-            // TODO: resubscribe to the new topic
-        }
-        return truncated;
-    } 
-    /*----------------    
-    if (strcmp(param, "ORG") == 0) {         
-        safe_strncpy (org_id, value, MAX_TINY_STRING_LENGTH);
-        if (!truncated)
-            make_derived_params(); // TODO: resubscribe to the new topic
-        return truncated;
-    } 
-    if (strcmp(param, "APP") == 0) {         
-        safe_strncpy (app_id, value, MAX_TINY_STRING_LENGTH); 
-        if (!truncated)
-            make_derived_params(); // TODO: resubscribe to the new topic
-        return truncated;
-    }    
-    ----------------*/
-    if (strcmp(param, "PRIREL") == 0) {         
-        int rel = atoi(value); // returns zero if the integer string is invalid
-        if (rel > 0 && rel < NUM_RELAYS) { 
-            primary_relay = rel; 
-            return false;  // false: all is OK
-        }
-        SERIAL_PRINTLN("\n*** Invalid relay number ****");
-        return true; // true: ERROR
-    }      
-    if (strcmp(param, "ACTL") == 0) {
-        if (value[0]=='1')      
-            active_low = true;
-        else 
-            if (value[0]=='0')      
-                active_low = false;  
-            else 
-                return true;  // ERROR 
-        make_derived_params();
-        return false;  // OK
-    }     
-    if (strcmp(param, "RTRIG") == 0) {         
-        if (value[0]=='1')      
-            radar_triggers = true;
-        else 
-            if (value[0]=='0')      
-                radar_triggers = false;  
-            else 
-                return true;  // ERROR 
-        return false;  // OK
-    }          
-    SERIAL_PRINTLN (F("--- ERROR: Unknown parameter ---"));     
-    return true; // ERROR
+    if (e->flags & PARAM_DERIVED)
+        make_derived_params(); // TODO: resubscribe to the new topic, if it has changed
+    return false;  // OK
 }
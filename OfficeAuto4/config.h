@@ -12,6 +12,29 @@
 #include "FS.h"
 #include <ESP8266WiFi.h>
 #include <ArduinoJson.h>     // https://github.com/bblanchon/ArduinoJson
+
+// Every configurable parameter is described once, in the registry in config.cpp.
+// Remote GET/SET, dump() and load_config() all work off the same table, so they cannot drift apart.
+enum param_type {
+    PARAM_STRING,   // char array
+    PARAM_PREFIX,   // char array; a trailing slash is removed (URL prefixes)
+    PARAM_BOOL,
+    PARAM_SHORT,
+    PARAM_INT,
+    PARAM_FLOAT,
+    PARAM_GETTER    // read only; computed by a Config method (full URLs etc.)
+};
+#define  PARAM_READ_ONLY    0x01  // cannot be SET remotely
+#define  PARAM_DERIVED      0x02  // make_derived_params() must run after it changes
+#define  PARAM_SECRET       0x04  // GET and dump() show it as ***
+#define  PARAM_SLOTS        128   // size of the hash index; a power of 2, at least twice the number of keyed parameters
+
+// FNV-1a hash; evaluated at compile time for the registry keys, and at run time for the incoming key
+constexpr uint32_t param_hash (const char* s, uint32_t h = 2166136261UL) {
+    return (*s == '\0') ? h : param_hash(s+1, (h ^ (byte)*s) * 16777619UL);
+}
+
+struct param_entry;  // defined below, after Config
  
 class Config {
 public :
@@ -24,11 +47,16 @@ char  app_id [MAX_TINY_STRING_LENGTH];
 char  org_id [MAX_TINY_STRING_LENGTH];     
 char  group_id [MAX_TINY_STRING_LENGTH];   
 
-int tick_interval = 100;  // millisec; less than ~50 will starve the network stack of CPU cycles
 int sensor_interval = 60000;   // read sensors every 1 minute
 
 int check_interval = 10000;  // 10 sec; for occupancy based light controller only
 int status_report_frequency = STATUS_FREQUENCEY;  // in minutes; usually 5 minutes
+// on-change telemetry: a reading is sent when it moves out of its deadband, or when the heartbeat is due
+int   heartbeat_minutes = HEARTBEAT_MINUTES;
+float temperature_deadband = TEMPERATURE_DEADBAND;
+float humidity_deadband = HUMIDITY_DEADBAND;
+int   light_deadband = LIGHT_DEADBAND;
+int   hit_deadband = HIT_DEADBAND;
 float auto_off_minutes = AUTO_OFF_TIME_MIN;  // the autonomous relay switches off after this time (can be fractional)
 
 bool version_check_enabled = true;
@@ -49,6 +77,10 @@ const char*  mqtt_client_prefix = org_id;  // this MUST  be <= 10 characters; th
 char  mqtt_broadcast_topic[MAX_SHORT_STRING_LENGTH];  // fully qualified topic paths
 char  mqtt_sub_topic[MAX_SHORT_STRING_LENGTH];
 char  mqtt_pub_topic[MAX_SHORT_STRING_LENGTH];
+char  local_broker[MAX_SHORT_STRING_LENGTH];  // LAN broker (see transport.h); empty = no LAN link
+int   local_port = LOCAL_BROKER_PORT;
+char  local_user[MAX_TINY_STRING_LENGTH];      // the LAN broker must authenticate the device; empty = no LAN link
+char  local_password[MAX_SHORT_STRING_LENGTH];
 char  mac_address[MAC_ADDRESS_LENGTH];  // 12+1 bytes needed to hold 6 bytes in HEX 
 char  night_hours_str[MAX_TINY_STRING_LENGTH];  // for display 
 
@@ -57,6 +89,10 @@ bool ON  = !active_low;
 bool OFF = active_low;
 
 short  primary_relay = PRIMARY_RELAY;   // the autonomous relay, which is triggered by movement, time of the day etc.
+bool   binary_frames = BINARY_FRAMES;    // publish status and data as binary frames (frames.h) instead of json
+int    metrics_minutes = METRICS_MINUTES;  // period of the health report
+bool   rtt_echo = RTT_ECHO;              // the AWS policy must allow publishing on the command topic
+bool   ack_events = ACK_EVENTS;          // hold the events in the outbox until the cloud acknowledges them (outbox.h)
 bool   radar_triggers = RADAR_TRIGGERS;  // to transition from unoccupied to occupied status, should radar also fire ? (0=only PIR; 1=both radar & PIR need to fire)
 short  night_start_hour = NIGHT_START_HOUR;   // time based automatic lights; hour and minute in 24 hour format          
 short  night_end_hour = NIGHT_END_HOUR;        
@@ -90,6 +126,8 @@ const char* get_primary_OTA_url();
 const char* get_primary_version_url();
 const char* get_secondary_OTA_url();
 const char* get_secondary_version_url();
+const char* get_primary_delta_url();
+const char* get_secondary_delta_url();
 const char* get_primary_certificate_version_url();
 const char* get_secondary_certificate_version_url();
 const char* get_primary_certificate_url (short file_number);
@@ -99,9 +137,41 @@ const char* get_secondary_certificate_url (short file_number);
 const char* get_param (const char* param); 
 // this method temporarily sets the parameter to the indicated value; this does NOT survive a reboot
 bool set_param (const char* param, const char* value); // to etch it permanenly, upload a new config.txt file
+// a pushed config: the keys of config.txt, in a json object; the read only ones are skipped. Returns the number of errors
+int apply_config (JsonVariant params);
 
 short get_num_files(); // number of certificate files, usually 4
 int download_certificates();  // this is called from command handler through MQTT
+
+// used by the registry for read only values that are not plain members
+const char* get_primary_config_url();
+const char* get_secondary_config_url();
+const char* get_light_thresholds();
+
+// hash slot -> registry position+1 (0 = empty slot); public only to keep Config standard layout for offsetof
+byte param_index [PARAM_SLOTS];  
+
+private:
+void  build_param_index();
+const param_entry* find_param (const char* key);
+const char* format_param (const param_entry* e);
+bool  store_param (const param_entry* e, const char* value);
+bool  load_param (const param_entry* e, JsonVariant v);
+int   load_params (JsonVariant root, bool remote);
 };  
+
+struct param_entry {
+    const char* key;         // remote name, as in {"G":"PRIREL"}; NULL if it only lives in config.txt
+    uint32_t    hash;        // param_hash(key)
+    const char* json_key;    // name in config.txt; NULL if it is not loaded from the file
+    short       json_index;  // position in a json array (NIGHT_HRS); -1 for scalars
+    byte        type;        // param_type
+    byte        flags;       // PARAM_READ_ONLY, PARAM_DERIVED, PARAM_SECRET
+    unsigned short offset;   // offsetof(Config, member)
+    unsigned short size;     // buffer size of strings
+    float       min_value;   // bounds for numbers
+    float       max_value;
+    const char* (Config::*getter)();  // GET returns this instead of the member, if present
+};
 #endif 
  
@@ -0,0 +1,63 @@
+// credentials.cpp
+
+#include "credentials.h"
+
+bool Credentials::is_loaded() {
+    return (device_cert != NULL && private_key != NULL && root_ca != NULL);
+}
+
+// the objects parse (and copy) the DER data; so each file buffer is released as soon as it is parsed
+bool Credentials::load() {
+    if (is_loaded())
+        return true;
+    if (!mount_file_system()) {
+        SERIAL_PRINTLN(F("--- Failed to mount file system. ---"));
+        return false;
+    }
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t size;
+    if (device_cert == NULL && read_file(CERT_FILE_NAME, buffer, &size)) 
+        device_cert = new BearSSL::X509List(buffer.get(), size);
+    if (private_key == NULL && read_file(PRIVATE_KEY_FILE, buffer, &size)) 
+        private_key = new BearSSL::PrivateKey(buffer.get(), size);
+    if (root_ca == NULL && read_file(CA_FILE_NAME, buffer, &size)) 
+        root_ca = new BearSSL::X509List(buffer.get(), size);
+    buffer.reset();
+    if (!is_loaded()) 
+        return false;
+    SERIAL_PRINTLN(F("Loaded certificate, private key and root CA."));
+    print_heap();
+    return true;
+}
+
+bool Credentials::read_file (const char* file_name, std::unique_ptr<uint8_t[]>& buffer, size_t* size) {
+    File f = SPIFFS.open(file_name, "r");
+    if (!f) {
+        SERIAL_PRINT(F("--- Failed to open: "));
+        SERIAL_PRINTLN(file_name);
+        return false;
+    }
+    *size = f.size();
+    if (*size == 0 || *size > MAX_CREDENTIAL_SIZE) {
+        SERIAL_PRINT(F("--- Invalid file size: "));
+        SERIAL_PRINTLN(file_name);
+        f.close();
+        return false;
+    }
+    buffer.reset(new uint8_t[*size]);
+    bool result = (f.read(buffer.get(), *size) == *size);
+    f.close();
+    if (!result) {
+        SERIAL_PRINT(F("--- Failed to read: "));
+        SERIAL_PRINTLN(file_name);
+    }
+    return result;
+}
+
+void Credentials::apply (BearSSL::WiFiClientSecure* client) {
+    if (private_key->isRSA())
+        client->setClientRSACert(device_cert, private_key);
+    else
+        client->setClientECCert(device_cert, private_key, BR_KEYTYPE_KEYX | BR_KEYTYPE_SIGN, BR_KEYTYPE_EC);
+    client->setTrustAnchors(root_ca);
+}
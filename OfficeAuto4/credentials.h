@@ -0,0 +1,32 @@
+// credentials.h
+// The device certificate, its private key and the root CA, read from the flash in one pass at boot
+// and parsed into BearSSL objects that stay in RAM; every (re)connection reuses them.
+// NOTE: certificates downloaded later with the CER command take effect after a reboot.
+
+#ifndef CREDENTIALS_H
+#define CREDENTIALS_H
+
+#include "common.h"
+#include "utilities.h"
+#include <FS.h>
+#include <ESP8266WiFi.h>
+
+#define  CERT_FILE_NAME       "/cert.der"
+#define  PRIVATE_KEY_FILE     "/private.der"
+#define  CA_FILE_NAME         "/ca.der"
+#define  MAX_CREDENTIAL_SIZE  2048   // bytes; DER files are about 1 KB each
+
+class Credentials {
+public:
+    bool load();    // returns at once if already loaded
+    bool is_loaded();
+    void apply (BearSSL::WiFiClientSecure* client);
+
+private:
+    BearSSL::X509List*   device_cert = NULL;
+    BearSSL::PrivateKey* private_key = NULL;
+    BearSSL::X509List*   root_ca = NULL;
+    bool read_file (const char* file_name, std::unique_ptr<uint8_t[]>& buffer, size_t* size);
+};
+
+#endif
@@ -0,0 +1,118 @@
+// deltaPatcher.cpp
+
+#include "deltaPatcher.h"
+
+static uint16_t get16 (const byte* p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t get32 (const byte* p) {
+    return (uint32_t)get16(p) | ((uint32_t)get16(p+2) << 16);
+}
+
+// the Updater and ESP.getSketchMD5() take the MD5 as a lower case hex string
+static void md5_to_hex (const byte* md5, char* hex) {
+    const char digits[] = "0123456789abcdef";
+    for (byte i=0; i<16; i++) {
+        hex[2*i] = digits[md5[i] >> 4];
+        hex[2*i+1] = digits[md5[i] & 0x0F];
+    }
+    hex[32] = '\0';
+}
+
+int DeltaPatcher::apply (Stream* delta) {
+    byte header[DELTA_HEADER_LENGTH];
+    char md5[33];
+    copied = 0;
+    inserted = 0;
+    delta->setTimeout(DELTA_READ_TIMEOUT);
+    if (!read_exactly(delta, header, DELTA_HEADER_LENGTH) || memcmp(header, "ODP1", 4) != 0) {
+        SERIAL_PRINTLN(F("--- Not a delta file ---"));
+        return PATCH_MISMATCH;
+    }
+    short base_version = (short)get16(header+4);
+    target_version = (short)get16(header+6);
+    uint32_t base_size = get32(header+8);
+    uint32_t target_size = get32(header+12);
+    SERIAL_PRINT(F("Delta from version "));
+    SERIAL_PRINT(base_version);
+    SERIAL_PRINT(F(" to "));
+    SERIAL_PRINTLN(target_version);
+    // nothing is written until the delta is known to fit the running image
+    md5_to_hex(header+16, md5);
+    if (base_size != ESP.getSketchSize() || strcmp(md5, ESP.getSketchMD5().c_str()) != 0) {
+        SERIAL_PRINTLN(F("--- The delta was made for a different build ---"));
+        return PATCH_MISMATCH;
+    }
+    if (!Update.begin(target_size, U_FLASH)) {
+        SERIAL_PRINTLN(F("--- Not enough room for the new image ---"));
+        return PATCH_FAILED;
+    }
+    md5_to_hex(header+32, md5);
+    Update.setMD5(md5);
+    byte op[8];
+    bool ok = true;
+    while (ok) {
+        if (!read_exactly(delta, op, 1)) {
+            ok = false;
+            break;
+        }
+        if (op[0] == 'E')
+            break;
+        if (op[0] == 'C')
+            ok = read_exactly(delta, op, 8) && copy_from_base(get32(op), get32(op+4), base_size);
+        else if (op[0] == 'I')
+            ok = read_exactly(delta, op, 2) && insert_from_delta(delta, get16(op));
+        else
+            ok = false;
+        yield();
+    }
+    // end() checks the size and the MD5 of the new image; a partial image is discarded
+    if (!ok || !Update.end()) {
+        SERIAL_PRINT(F("--- Delta update failed. Updater error: "));
+        SERIAL_PRINTLN(Update.getError());
+        if (Update.isRunning())
+            Update.end();
+        return PATCH_FAILED;
+    }
+    SERIAL_PRINT(F("Delta applied. Bytes copied: "));
+    SERIAL_PRINT(copied);
+    SERIAL_PRINT(F(", downloaded: "));
+    SERIAL_PRINTLN(inserted);
+    return UPDATE_OK;
+}
+
+bool DeltaPatcher::read_exactly (Stream* delta, byte* dest, size_t length) {
+    return (delta->readBytes(dest, length) == length);
+}
+
+bool DeltaPatcher::copy_from_base (uint32_t offset, uint32_t length, uint32_t base_size) {
+    if (offset > base_size || length > base_size - offset)
+        return false;
+    while (length > 0) {
+        uint32_t chunk = (length < DELTA_BUFFER_SIZE) ? length : DELTA_BUFFER_SIZE;
+        uint32_t aligned = offset & ~3UL;
+        uint32_t skew = offset - aligned;
+        if (!ESP.flashRead(aligned, buffer, (skew + chunk + 3) & ~3UL))
+            return false;
+        if (Update.write((uint8_t*)buffer + skew, chunk) != chunk)
+            return false;
+        copied += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool DeltaPatcher::insert_from_delta (Stream* delta, uint16_t length) {
+    while (length > 0) {
+        uint16_t chunk = (length < DELTA_BUFFER_SIZE) ? length : DELTA_BUFFER_SIZE;
+        if (!read_exactly(delta, (byte*)buffer, chunk))
+            return false;
+        if (Update.write((uint8_t*)buffer, chunk) != chunk)
+            return false;
+        inserted += chunk;
+        length -= chunk;
+    }
+    return true;
+}
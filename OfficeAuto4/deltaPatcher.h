@@ -0,0 +1,39 @@
+// deltaPatcher.h
+// Applies a binary delta to the running firmware, streaming it into the update partition.
+// The delta is made on the build machine by python/make_delta.py, from the .bin of the installed version
+// and the .bin of the new one. Layout (little endian):
+//   header: 'O' 'D' 'P' '1', base version (2), target version (2), base size (4), target size (4),
+//           MD5 of the base image (16), MD5 of the target image (16)
+//   then a list of operations, each one writing the next bytes of the target image:
+//     'C' offset (4) length (4)       copy from the running image (the base)
+//     'I' length (2) data...          insert new bytes
+//     'E'                             end of the delta
+// The base MD5 must match ESP.getSketchMD5(), so a delta is never applied over a different build; the target MD5
+// is checked by the Updater before the new image is marked bootable. The running image stays untouched throughout.
+
+#ifndef DELTAPATCHER_H
+#define DELTAPATCHER_H
+
+#include "common.h"
+#include <Updater.h>
+
+#define  DELTA_HEADER_LENGTH    48
+#define  DELTA_BUFFER_SIZE      256      // bytes; the copy and insert chunk. Keep it a multiple of 4 (flash reads)
+#define  DELTA_READ_TIMEOUT     5000     // mSec; for each read from the server
+
+class DeltaPatcher {
+public:
+    unsigned long copied = 0;     // bytes of the target taken from the running image
+    unsigned long inserted = 0;   // bytes of the target downloaded
+    short target_version = 0;
+
+    int apply (Stream* delta);    // UPDATE_OK, PATCH_MISMATCH or PATCH_FAILED
+
+private:
+    uint32_t buffer[DELTA_BUFFER_SIZE/4 + 1];  // word aligned, as ESP.flashRead() needs; +1 for an unaligned start
+    bool read_exactly (Stream* delta, byte* dest, size_t length);
+    bool copy_from_base (uint32_t offset, uint32_t length, uint32_t base_size);
+    bool insert_from_delta (Stream* delta, uint16_t length);
+};
+
+#endif
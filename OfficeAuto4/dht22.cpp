@@ -0,0 +1,72 @@
+// dht22.cpp
+
+#include "dht22.h"
+
+Dht22* Dht22::active = NULL;
+
+Dht22::Dht22 (byte pin) {
+    this->pin = pin;
+}
+
+void Dht22::begin() {
+    pinMode(pin, INPUT_PULLUP);
+}
+
+// pull the line low; poll() releases it after DHT_START_PULSE_US
+byte Dht22::begin_conversion() {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    return SENSOR_STARTING;
+}
+
+byte Dht22::advance (byte current_state, unsigned long elapsed_us) {
+    if (current_state == SENSOR_STARTING) {
+        if (elapsed_us < DHT_START_PULSE_US)
+            return SENSOR_STARTING;
+        pulse_count = 0;
+        rise_us = micros();
+        active = this;
+        attachInterrupt(digitalPinToInterrupt(pin), on_edge, CHANGE);
+        pinMode(pin, INPUT_PULLUP);  // release the line; the sensor answers in 20-40 usec
+        return SENSOR_CAPTURING;
+    }
+    // SENSOR_CAPTURING
+    if (elapsed_us < DHT_CAPTURE_US)
+        return SENSOR_CAPTURING;
+    detachInterrupt(digitalPinToInterrupt(pin));
+    active = NULL;
+    return (decode() ? SENSOR_READY : SENSOR_FAILED);
+}
+
+void ICACHE_RAM_ATTR Dht22::on_edge() {
+    unsigned long now = micros();
+    Dht22* d = active;
+    if (d == NULL)
+        return;
+    if (digitalRead(d->pin)) {
+        d->rise_us = now;
+    } 
+    else if (d->pulse_count < DHT_MAX_PULSES) {
+        unsigned long width = now - d->rise_us;
+        d->pulses[d->pulse_count++] = (width > 255) ? 255 : width;
+    }
+}
+
+bool Dht22::decode() {
+    byte count = pulse_count;
+    if (count < 40) 
+        return false;
+    byte data[5] = {0, 0, 0, 0, 0};
+    for (byte i=0; i<40; i++) {
+        data[i/8] <<= 1;
+        if (pulses[count-40+i] > DHT_ONE_THRESHOLD_US)
+            data[i/8] |= 1;
+    }
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4])
+        return false;
+    humidity = ((data[0] << 8) | data[1]) * 0.1f;
+    temperature = (((data[2] & 0x7F) << 8) | data[3]) * 0.1f;
+    if (data[2] & 0x80)
+        temperature = -temperature;
+    return true;
+}
@@ -0,0 +1,40 @@
+// dht22.h
+// Interrupt driven, non blocking DHT22 reader. The library read() waits for the start pulse and then
+// polls the bit stream with interrupts disabled; here the start pulse is timed by poll(), and the
+// response is measured by a CHANGE interrupt that records the width of every high pulse.
+// DHT22 frame: 80us low + 80us high response, then 40 bits; each bit is 50us low followed by
+// ~27us high (0) or ~70us high (1). The last 40 high pulses are the data; the checksum validates them.
+
+#ifndef DHT22_H
+#define DHT22_H
+
+#include "common.h"
+#include "asyncSensor.h"
+
+#define  DHT_START_PULSE_US   1100    // host start signal: at least 1 mSec low
+#define  DHT_CAPTURE_US       8000    // the whole response takes about 5 mSec
+#define  DHT_MAX_PULSES       48      // 40 bits + response + a few glitches
+#define  DHT_ONE_THRESHOLD_US 48      // high pulses longer than this are 1 bits
+
+class Dht22 : public AsyncSensor {
+public:
+    float temperature = NAN;  // Celsius; of the latest good conversion
+    float humidity = NAN;
+    Dht22 (byte pin);
+    void begin();
+
+protected:
+    byte begin_conversion();
+    byte advance (byte current_state, unsigned long elapsed_us);
+
+private:
+    byte pin;
+    volatile byte pulse_count = 0;
+    volatile byte pulses[DHT_MAX_PULSES];  // high pulse widths, in usec (saturated at 255)
+    volatile unsigned long rise_us = 0;
+    static Dht22* active;  // the sensor being captured; the interrupt routine has no 'this'
+    static void on_edge();
+    bool decode();
+};
+
+#endif
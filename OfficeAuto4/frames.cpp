@@ -0,0 +1,153 @@
+// frames.cpp
+
+#include "frames.h"
+#include "settings.h"
+
+// external callback functions defined in the main .ino:
+extern void notify_command (const char* command);
+extern void notify_get_param (const char* param);
+extern void notify_set_param (const char* param, const char *value);
+extern void notify_batch (const char* const* commands, short count);
+extern void notify_part (const byte* frame, unsigned int length);
+
+bool is_binary_frame (const byte* payload, unsigned int length) {
+    return (length >= FRAME_HEADER_LENGTH && payload[0] == FRAME_MAGIC);
+}
+
+// G and S frames carry their own null terminators; they are passed on in place, like the json strings.
+// Commands have no terminators, so they are copied into 4 byte cells on the stack.
+void handle_frame (byte* payload, unsigned int length) {
+    char* body = (char*)payload + FRAME_HEADER_LENGTH;
+    unsigned int body_length = length - FRAME_HEADER_LENGTH;
+    switch (payload[1]) {
+        case FRAME_COMMAND: {
+            if (body_length == 0 || body_length % 3 != 0 || body_length > 3*MAX_BATCH_COMMANDS) {
+                SERIAL_PRINTLN(F("--- Invalid command frame ---"));
+                return;
+            }
+            char cells[MAX_BATCH_COMMANDS][4];
+            const char* commands[MAX_BATCH_COMMANDS];
+            short count = body_length / 3;
+            for (short i=0; i<count; i++) {
+                memcpy (cells[i], body + 3*i, 3);
+                cells[i][3] = '\0';
+                commands[i] = cells[i];
+            }
+            if (count == 1)
+                notify_command(commands[0]);
+            else
+                notify_batch(commands, count);
+            break;
+        }
+        case FRAME_GET:
+            if (body_length < 2 || body[body_length-1] != '\0') {
+                SERIAL_PRINTLN(F("--- Invalid get frame ---"));
+                return;
+            }
+            notify_get_param(body);
+            break;
+        case FRAME_SET: {
+            // the param terminator must fall inside the body, and the body must end with the value terminator
+            char* value = (body_length > 0) ? (char*)memchr(body, '\0', body_length) : NULL;
+            if (value == NULL || value == body || body[body_length-1] != '\0' || value == body+body_length-1) {
+                SERIAL_PRINTLN(F("--- Invalid set frame ---"));
+                return;
+            }
+            notify_set_param(body, value+1);
+            break;
+        }
+        case FRAME_PART:
+            notify_part(payload, length);  // copied into the assembly arena
+            break;
+        default:
+            SERIAL_PRINTLN(F("--- Unknown frame type ---"));
+            break;
+    }
+}
+
+// relay_status is the "01" string from Hardware::getStatus(); the last character is relay 0
+byte relay_mask (const char* relay_status) {
+    byte mask = 0;
+    short n = strlen(relay_status);
+    for (short i=0; i<n && i<8; i++)
+        if (relay_status[n-1-i] == '1')
+            mask |= (1 << i);
+    return mask;
+}
+
+static byte* put_uint16 (byte* p, unsigned short value) {
+    *p++ = value & 0xFF;
+    *p++ = value >> 8;
+    return p;
+}
+
+short to_tenths (float value) {
+    if (isnan(value))
+        return FRAME_NO_VALUE;
+    return (short)round(value*10);
+}
+
+static byte* put_tenths (byte* p, float value) {
+    return put_uint16(p, (unsigned short)to_tenths(value));
+}
+
+short encode_status_frame (byte* buffer, const char* relay_status) {
+    buffer[0] = FRAME_MAGIC;
+    buffer[1] = FRAME_STATUS;
+    buffer[2] = strlen(relay_status);  // the mask alone does not tell how many relays there are
+    buffer[3] = relay_mask(relay_status);
+    return STATUS_FRAME_LENGTH;
+}
+
+short encode_data_frame (byte* buffer, const char* relay_status, const data* dat) {
+    byte* p = buffer;
+    *p++ = FRAME_MAGIC;
+    *p++ = FRAME_DATA;
+    *p++ = strlen(relay_status);
+    *p++ = relay_mask(relay_status);
+    p = put_tenths (p, dat->temperature);
+    p = put_tenths (p, dat->humidity);
+    p = put_tenths (p, dat->hindex);
+    p = put_uint16 (p, dat->light);
+    p = put_uint16 (p, dat->pir_hits);
+    p = put_uint16 (p, dat->radar_hits);
+    p = put_uint16 (p, dat->window);
+    return (p - buffer);  // DATA_FRAME_LENGTH
+}
+
+short encode_history_frame (byte* buffer, const spool_sample* batch, short count) {
+    byte* p = buffer;
+    *p++ = FRAME_MAGIC;
+    *p++ = FRAME_HISTORY;
+    *p++ = NUM_RELAYS;  // the samples keep only the mask
+    for (short i=0; i<count; i++) {
+        const spool_sample* s = &batch[i];
+        p = put_uint16 (p, s->stamp & 0xFFFF);
+        p = put_uint16 (p, s->stamp >> 16);
+        *p++ = s->relays;
+        p = put_uint16 (p, (unsigned short)s->temperature);
+        p = put_uint16 (p, (unsigned short)s->humidity);
+        p = put_uint16 (p, (unsigned short)s->hindex);
+        p = put_uint16 (p, s->light);
+        p = put_uint16 (p, s->pir_hits);
+        p = put_uint16 (p, s->radar_hits);
+    }
+    return (p - buffer);  // HISTORY_FRAME_LENGTH(count)
+}
+
+short encode_stats_frame (byte* buffer, unsigned short window, const stats_summary* stats, short count) {
+    byte* p = buffer;
+    *p++ = FRAME_MAGIC;
+    *p++ = FRAME_STATS;
+    p = put_uint16 (p, window);
+    for (short i=0; i<count; i++) {
+        const stats_summary* s = &stats[i];
+        p = put_uint16 (p, s->count);
+        p = put_uint16 (p, (unsigned short)s->min);
+        p = put_uint16 (p, (unsigned short)s->max);
+        p = put_uint16 (p, (unsigned short)s->mean);
+        p = put_uint16 (p, (unsigned short)s->stddev);
+        p = put_uint16 (p, (unsigned short)s->last);
+    }
+    return (p - buffer);  // STATS_FRAME_LENGTH(count)
+}
@@ -0,0 +1,59 @@
+// frames.h
+// Compact binary framing for commands and telemetry; an alternative to the json messages, on the same topics.
+// A frame starts with FRAME_MAGIC, which can never be the first byte of a json message ('{'), so both kinds 
+// can arrive on one topic. The device always accepts binary commands; it publishes binary telemetry only if
+// the BIN parameter is set (per device: {"S":{"P":"BIN","V":"1"}} or BINARY in config.txt).
+// Multi byte fields are little endian. The decoder for the cloud side is python/frames.py
+//
+// Inbound (cloud -> device):
+//   B1 'C' c1 c2 c3 [c1 c2 c3 ...]   one command, or a batch of up to MAX_BATCH_COMMANDS; 3 bytes each, no separators
+//   B1 'G' param 00                  get parameter
+//   B1 'S' param 00 value 00         set parameter
+//   B1 'P' id index count data...    a part of a long json message; see assembler.h
+// Outbound (device -> cloud):
+//   B1 's' n relays                  status; n: number of relays on the device; relays is a bit mask, bit 0 = relay 0
+//   B1 'd' n relays T T H H I I L L P P R R N N  data; T,H,I: int16 x10 (FRAME_NO_VALUE if the sensor failed); L,P,R: uint16;
+//                                    N: report window number
+//   B1 'h' n { stamp(4) relays T T H H I I L L P P R R } ...  history: spooled data samples, see spool.h; stamp in UTC
+//   B1 'w' N N { n n min min max max mean mean sd sd last last } x 3   window statistics of T, H (int16 x10) and L; see stats.h
+//                                    N: the window number of the data frame they belong to; n: count of readings
+//   All the other replies (info, errors, parameters) stay json.
+
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include "common.h"
+#include "spool.h"
+#include "stats.h"
+
+#define  FRAME_MAGIC          0xB1     // high nibble 'B'inary, low nibble the frame format version
+#define  FRAME_HEADER_LENGTH  2
+#define  FRAME_NO_VALUE       -32768   // int16 stand in for NaN readings
+#define  STATUS_FRAME_LENGTH  (FRAME_HEADER_LENGTH + 2)
+#define  DATA_FRAME_LENGTH    (FRAME_HEADER_LENGTH + 16)
+#define  HISTORY_RECORD_LENGTH  17
+#define  HISTORY_FRAME_LENGTH(count)  (FRAME_HEADER_LENGTH + 1 + (count)*HISTORY_RECORD_LENGTH)
+#define  STATS_RECORD_LENGTH  12
+#define  STATS_FRAME_LENGTH(count)  (FRAME_HEADER_LENGTH + 2 + (count)*STATS_RECORD_LENGTH)
+
+enum frame_type {
+    FRAME_COMMAND = 'C',
+    FRAME_GET     = 'G',
+    FRAME_SET     = 'S',
+    FRAME_PART    = 'P',
+    FRAME_STATUS  = 's',
+    FRAME_DATA    = 'd',
+    FRAME_HISTORY = 'h',
+    FRAME_STATS   = 'w'
+};
+
+bool  is_binary_frame (const byte* payload, unsigned int length);
+void  handle_frame (byte* payload, unsigned int length);    // decodes and queues an inbound frame
+short encode_status_frame (byte* buffer, const char* relay_status);
+short encode_data_frame (byte* buffer, const char* relay_status, const data* dat);
+short encode_history_frame (byte* buffer, const spool_sample* batch, short count);
+short encode_stats_frame (byte* buffer, unsigned short window, const stats_summary* stats, short count);
+byte  relay_mask (const char* relay_status);
+short to_tenths (float value);
+
+#endif
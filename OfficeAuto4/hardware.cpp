@@ -5,11 +5,20 @@
 
 #ifdef DHT_PRESENT
   #include <DHT.h>      // https://github.com/adafruit/DHT-sensor-library (delete DHT_U.h & DHT_U.cpp)
+  #include "dht22.h"
   const int dht_pin = DHT_PIN;    
   DHT dht(dht_pin, DHT22);   // this is actually a macro, so it refuses to go inside a class !
+                             // only its heat index formula is used now; the sensor is read by dht22 below
+  Dht22 dht22(dht_pin);      // non blocking reader
+  unsigned long dht_start_time = 0;
 #endif
 
-Hardware::Hardware () {
+static const byte relay_pins[] = RELAY_PINS;   // a count other than NUM_RELAYS does not compile
+
+Hardware::Hardware () : relays(relay_pins) {
+    stats_reset (&temp_stats);
+    stats_reset (&humi_stats);
+    stats_reset (&light_stats);
 }
 
 void Hardware::print_configuration() {
@@ -54,19 +63,43 @@ void Hardware::init (Config *configptr, Timer *timerptr, CommandHandler* cmdptr)
   init_serial();
   print_configuration(); // this needs serial
   init_hardware();
+  sensor_data.window = (unsigned short)ESP.random();  // not from 0 after every reboot; the cloud keys the statistics on it
+}
+
+// Called on every pass of the main loop; drives the background conversions of the slow sensors.
+// Each call returns at once: the DHT22 bit stream is captured by its interrupt routine.
+void Hardware::update() {
+#ifdef LDR_PRESENT
+    if (millis() - ldr_sample_time >= LDR_SAMPLE_INTERVAL) {
+        ldr_sample_time = millis();
+        ldr_filter.add (analogRead(ldr));
+    }
+#endif
+#ifdef DHT_PRESENT
+    if (dht22.poll() && dht22.get_state() == SENSOR_FAILED)
+        SERIAL_PRINTLN(F("--- DHT22 conversion failed ---"));
+    if (!dht22.is_busy() && millis() - dht_start_time >= DHT_READ_INTERVAL) {
+        dht_start_time = millis();
+        dht22.start();
+    }
+#endif
+}
+
+void Hardware::get_dht_stats (unsigned long *conversions, unsigned long *failures) {
+#ifdef DHT_PRESENT
+    *conversions = dht22.conversions;
+    *failures = dht22.failures;
+#else
+    *conversions = 0;
+    *failures = 0;
+#endif
 }
 
 // Tells if it is day or night based on LDR reading
 // The output is ternary: day,night,unknown
 short Hardware::is_night_time() {
 #ifdef LDR_PRESENT  
-    int lite = 0;
-    for (int i=0; i<5; i++) {
-        lite += analogRead(ldr);
-        delay(5);
-    } 
-    lite = (int) (lite/5);  
-    lite = MAX_LIGHT - lite;
+    int lite = MAX_LIGHT - filtered_light();
     SERIAL_PRINT(F("Light level: "));
     SERIAL_PRINTLN(lite);
     if (lite > (MAX_LIGHT-NOISE_THRESHOLD)) // light sensor failure threshold=10
@@ -79,21 +112,102 @@ short Hardware::is_night_time() {
     return TIME_UNKNOWN;   // in the buffer zone for Schmidt trigger
 }
 
+#ifdef LDR_PRESENT
+// raw ADC scale (bright = low); the median of the background samples
+short Hardware::filtered_light() {
+    if (ldr_filter.is_empty())  // before the main loop has started (eg. the priming check at boot)
+        ldr_filter.add (analogRead(ldr));
+    return ldr_filter.median();
+}
+#endif
+
 const char* Hardware::getStatus() {
-    snprintf (relay_status_str, 3, "%1d%1d", relay_status[1], relay_status[0]); // NOTE: length 3 is hard coded
-    return ((const char *)relay_status_str);
+    return relays.status();  // "01": the last character is relay 0
 }
 
 const data* Hardware::getData() {
     return ((const data *)&sensor_data);
 }
 
+// The motion sensors are captured by GPIO interrupts on both edges, instead of polling them in the loop.
+// The ISRs only record the edge and mirror the pin on its LED; the occupancy logic runs in the main loop,
+// as soon as it sees the pending flag. The loop side reads multi-field values with interrupts disabled.
+static volatile motion_channel pir_channel;
+static volatile motion_channel radar_channel;
+
+static void ICACHE_RAM_ATTR record_edge (volatile motion_channel *ch, bool level, byte led) {
+    unsigned long now = millis();
+    if (level && !ch->level) {
+        if (ch->hits == 0)
+            ch->first_edge = now;
+        ch->hits++;
+        ch->last_edge = now;
+        ch->rise_time = now;
+    } 
+    else if (!level && ch->level) {
+        if (now - ch->rise_time > ch->max_pulse)
+            ch->max_pulse = now - ch->rise_time;
+    }
+    ch->level = level;
+    ch->pending = true;
+    digitalWrite(led, !level);
+}
+
+#ifdef PIR_PRESENT
+static void ICACHE_RAM_ATTR pir_isr() {
+    record_edge (&pir_channel, digitalRead(PIR), LED1);
+}
+#endif
+#ifdef RADAR_PRESENT
+static void ICACHE_RAM_ATTR radar_isr() {
+    record_edge (&radar_channel, digitalRead(RADAR), LED2);
+}
+#endif
+
+// returns the hit count of the window, and starts a new window
+static unsigned short take_hits (volatile motion_channel *ch) {
+    noInterrupts();
+    unsigned short hits = ch->hits;
+    ch->hits = 0;
+    ch->max_pulse = 0;
+    interrupts();
+    return hits;
+}
+
+static void copy_channel (volatile motion_channel *ch, motion_channel *copy) {
+    noInterrupts();
+    copy->hits = ch->hits;
+    copy->first_edge = ch->first_edge;
+    copy->last_edge = ch->last_edge;
+    copy->rise_time = ch->rise_time;
+    copy->max_pulse = ch->max_pulse;
+    copy->level = ch->level;
+    copy->pending = ch->pending;
+    interrupts();
+}
+
+// the window keeps counting till the next report; the deadband applies to the hits per minute
+static void count_minute_hits (volatile motion_channel *ch, hit_tracker *track) {
+    unsigned short hits = ch->hits;
+    track->minute = hits - track->seen;
+    track->seen = hits;
+}
+
+void Hardware::init_motion_interrupts() {
+#ifdef PIR_PRESENT   
+    pir_channel.level = digitalRead(pir);
+    attachInterrupt(digitalPinToInterrupt(pir), pir_isr, CHANGE);
+#endif    
+#ifdef RADAR_PRESENT   
+    radar_channel.level = digitalRead(radar);
+    attachInterrupt(digitalPinToInterrupt(radar), radar_isr, CHANGE);
+#endif    
+}
+
+// the current pin level, as of the latest edge
 bool Hardware::getPir() {
 #ifdef PIR_PRESENT  
-    pir_status = digitalRead(pir);
-    if (pir_status)
-        pir_fired = true;
-    return (pir_status);
+    return (pir_channel.level);
 #else
     return false;
 #endif
@@ -101,37 +215,26 @@ bool Hardware::getPir() {
 
 bool Hardware::getRadar() {
 #ifdef RADAR_PRESENT    
-    radar_status = digitalRead(radar);
-    if (radar_status)
-        radar_fired = true;
-    return radar_status;
+    return (radar_channel.level);
 #else
     return false;
 #endif    
 }
 
-bool Hardware::showPirStatus() {
-#ifdef PIR_PRESENT    
-    pir_status =  digitalRead(pir);
-    digitalWrite(led1, !pir_status);
-    if (pir_status)
-        pir_fired = true;    
-    return (pir_status);
-#else
-    return false;
-#endif    
+// true if there was an edge on any motion sensor since the last call
+bool Hardware::motion_pending() {
+    noInterrupts();
+    bool pending = pir_channel.pending || radar_channel.pending;
+    pir_channel.pending = false;
+    radar_channel.pending = false;
+    interrupts();
+    return pending;
 }
 
-bool Hardware::showRadarStatus() {
-#ifdef RADAR_PRESENT    
-    radar_status =  digitalRead(radar);
-    digitalWrite(led2, !radar_status);
-    if (radar_status)
-        radar_fired = true;    
-    return (radar_status);
-#else
-    return false;
-#endif    
+// a consistent snapshot of the current report window of both sensors
+void Hardware::get_motion (motion_channel *pir_copy, motion_channel *radar_copy) {
+    copy_channel (&pir_channel, pir_copy);
+    copy_channel (&radar_channel, radar_copy);
 }
 
 void Hardware::reboot_esp() {
@@ -154,93 +257,170 @@ void Hardware::infinite_loop() {
 }
 //---------------  application specific --------------------------------
 
-// this function is typically called once in a minute; it reads the sensors, and
-// increments a count. When the count reaches, say, 5 then it computes the average
-// and asks the Hardware to send the data or operate the lights as needed.
-// returns: true if it is time to send a status report (eg: 5 min elapsed), false otherwise
+#ifdef DHT_PRESENT  
+  float t, h;  // the latest reading
+#endif
+// this function is typically called once in a minute. It reads the sensors and decides whether the data
+// is worth sending: a reading that moved out of its deadband since the last report is sent at once;
+// otherwise the device stays quiet until the heartbeat is due, and then sends the average of the quiet period.
+// returns: true if sensor_data has been refreshed and should be sent, false otherwise
 
 bool Hardware::read_sensors() {
     read_dht_ldr(); // low level read
-    sensor_reading_count++;  // increment from 0 to 4 ..
-    // and when the count reaches 5, trigger send_data() and return true. Till then, return false.
-    if (sensor_reading_count < pC->status_report_frequency) 
-        return false;  // not yet time to send data or to operate the lights
+#ifdef PIR_PRESENT
+    count_minute_hits (&pir_channel, &pir_track);
+#endif
+#ifdef RADAR_PRESENT
+    count_minute_hits (&radar_channel, &radar_track);
+#endif
+    sensor_reading_count++;  // the number of readings since the last report
+    bool changed = never_reported || reading_changed();
+    if (!changed && sensor_reading_count < pC->heartbeat_minutes) 
+        return false;  // nothing worth sending yet
     
-    // ..now the time is ripe to send data or operate the lights   
-    SERIAL_PRINTLN(F("[Hardware] preparing to send sensor data.."));
+    // ..now the data is to be sent
+    if (changed)
+        SERIAL_PRINTLN(F("[Hardware] reading changed; preparing to send sensor data.."));
+    else
+        SERIAL_PRINTLN(F("[Hardware] heartbeat; preparing to send sensor data.."));
     print_data();
     // TODO: check if wifi connection is there and restart after N attempts
     
-#ifdef LDR_PRESENT    
-    if (sensor_reading_count > 0)
-        light = (int)light/sensor_reading_count;  // assumption, light was read correctly all the times
-#endif        
-    sensor_reading_count = 0; // reset it for the next time (but only after using it to average light!)
+    sensor_reading_count = 0; // reset it for the next time
 
 #ifdef DHT_PRESENT    
-    if (valid_reading_count > 0) {
-        temperature = temperature/valid_reading_count;
-        humidity = humidity/valid_reading_count;
+    float temperature = 0.0f;
+    float humidity = 0.0f;
+    if (changed && !isnan(t) && !isnan(h)) {
+        temperature = t;  // send the reading that crossed the deadband, not one diluted by the average
+        humidity = h;
+    }
+    else if (temp_stats.count > 0) {  // only the valid readings were added
+        temperature = stats_mean(&temp_stats)/10.0f;
+        humidity = stats_mean(&humi_stats)/10.0f;
     }
-    sensor_data.temperature = temperature;  // this->temperature
-    sensor_data.humidity = humidity;        // this->humidity
+    sensor_data.temperature = temperature;
+    sensor_data.humidity = humidity;
     sensor_data.hindex = dht.computeHeatIndex(temperature, humidity, false); // here the default is Farenheit !  
     if (sensor_data.hindex < 0)
         sensor_data.hindex = 0.0f; 
-    temperature = 0.0f;
-    humidity = 0.0f;
 #endif      
 
 #ifdef LDR_PRESENT
-    sensor_data.light = MAX_LIGHT-light;
-    light = 0; // TODO:  some more cleanup is pending    
+    if (changed || light_stats.count == 0)
+        sensor_data.light = MAX_LIGHT-last_light;  // the latest, even if it shows the sensor has failed
+    else
+        sensor_data.light = stats_mean(&light_stats);
 #else
     sensor_data.light = 0;
 #endif    
+    close_stats_window();
 #ifdef PIR_PRESENT
-    sensor_data.pir_hits = pir_fired;  // TODO: make it the count of hits
-    pir_fired = false;
+    sensor_data.pir_hits = take_hits(&pir_channel);  // rising edges since the last report
+    pir_track.reported = pir_track.minute;
+    pir_track.seen = 0;
 #endif     
 #ifdef RADAR_PRESENT    
-    sensor_data.radar_hits = radar_fired;  
-    radar_fired = false;       
+    sensor_data.radar_hits = take_hits(&radar_channel);  
+    radar_track.reported = radar_track.minute;
+    radar_track.seen = 0;
 #endif     
-    safe_strncpy (sensor_data.relay_status, getStatus(), MAX_RELAYS); // dest,src,size    
-    valid_reading_count = 0; // prepare for next time
-    return true;  // true = the main class should determine day or night and save it
+    safe_strncpy (sensor_data.relay_status, getStatus(), MAX_RELAYS+1); // dest,src,size    
+    never_reported = false;
+    return true;  
 } 
 
-#ifdef DHT_PRESENT  
-  float t, h;
+// keeps the statistics of the window just reported (for send_stats()), and starts a new window
+void Hardware::close_stats_window() {
+    sensor_data.window++;
+    stats_summarize (&temp_stats, &window_summary[STATS_TEMPERATURE]);
+    stats_summarize (&humi_stats, &window_summary[STATS_HUMIDITY]);
+    stats_summarize (&light_stats, &window_summary[STATS_LIGHT]);
+    stats_reset (&temp_stats);
+    stats_reset (&humi_stats);
+    stats_reset (&light_stats);
+}
+
+const stats_summary* Hardware::getStats() {
+    return window_summary;
+}
+
+// compares the latest reading with the last data sent (sensor_data); any field out of its deadband counts
+bool Hardware::reading_changed() {
+#ifdef DHT_PRESENT
+    if (!isnan(t) && !isnan(h)) {
+        if (fabs(t - sensor_data.temperature) >= pC->temperature_deadband)
+            return true;
+        if (fabs(h - sensor_data.humidity) >= pC->humidity_deadband)
+            return true;
+    }
+#endif
+#ifdef LDR_PRESENT
+    if (abs((MAX_LIGHT-last_light) - sensor_data.light) >= pC->light_deadband)
+        return true;
+#endif
+#ifdef PIR_PRESENT
+    if (hits_changed(&pir_track))
+        return true;
 #endif
-// adds the new readings to a corresponding buffer variable, so that average can be taken before sending data
+#ifdef RADAR_PRESENT
+    if (hits_changed(&radar_track))
+        return true;
+#endif
+    return false;
+}
+
+// motion starting or stopping is always a change; otherwise the rate has to move by hit_deadband
+bool Hardware::hits_changed (const hit_tracker *track) {
+    if ((track->minute == 0) != (track->reported == 0))
+        return true;
+    return (abs((int)track->minute - (int)track->reported) >= pC->hit_deadband);
+}
+
+// true once in status_report_frequency minutes: the time to check day/night, independent of the data reports
+bool Hardware::is_check_time() {
+    check_count++;
+    if (check_count < pC->status_report_frequency)
+        return false;
+    check_count = 0;
+    return true;
+}
+
+// adds the new valid readings to the statistics of the current window; the average is taken before sending data
 void Hardware::read_dht_ldr() {
 #ifdef DHT_PRESENT    
-  // Reading temperature or humidity takes about 250 milliseconds!
-  // Sensor readings may also be up to 2 seconds 'old' (its a very slow sensor)    
-  t = dht.readTemperature();  // here the default is Celcius (but Farenheit is the default for heat index)
-  h = dht.readHumidity();
+  // the conversion runs in the background (see update()); take its latest result, if it is recent enough
+  if (dht22.last_result_time != 0 && millis() - dht22.last_result_time < 2*DHT_READ_INTERVAL) {
+      t = dht22.temperature;  // Celcius (but Farenheit is the default for heat index)
+      h = dht22.humidity;
+  } else {
+      t = NAN;
+      h = NAN;
+  }
   if (isnan(t) || isnan(h)) 
     SERIAL_PRINTLN(F("--- cannot read temperature sensor ---")); 
   else {
-      temperature += t;
-      humidity += h;
-      valid_reading_count++;
+      stats_add (&temp_stats, (short)round(t*10));  // tenths
+      stats_add (&humi_stats, (short)round(h*10));
   }
 #endif  
 #ifdef LDR_PRESENT
-  light += analogRead(ldr); // assumption: light is always valid !
+  last_light = filtered_light();  // spikes are already removed by the filter
+  if (MAX_LIGHT-last_light <= MAX_LIGHT-NOISE_THRESHOLD)  // same failure test as is_night_time()
+      stats_add (&light_stats, MAX_LIGHT-last_light);  // in the reported scale
+  else
+      SERIAL_PRINTLN(F("--- light sensor failure ---"));
 #endif    
   //print_data();  // just for debugging
 }  
 
 void Hardware::print_data() {
 #ifdef DHT_PRESENT    
-  SERIAL_PRINT(F("[RAW] temp: ")); SERIAL_PRINT(temperature); SERIAL_PRINT(F("\t"));
-  SERIAL_PRINT(F("humi: ")); SERIAL_PRINT(humidity); SERIAL_PRINT(F("\t"));
+  SERIAL_PRINT(F("[MEAN] temp: ")); SERIAL_PRINT(stats_mean(&temp_stats)/10.0f); SERIAL_PRINT(F("\t"));
+  SERIAL_PRINT(F("humi: ")); SERIAL_PRINT(stats_mean(&humi_stats)/10.0f); SERIAL_PRINT(F("\t"));
 #endif  
 #ifdef LDR_PRESENT
-  SERIAL_PRINT(F("light: ")); SERIAL_PRINTLN(light);    
+  SERIAL_PRINT(F("light: ")); SERIAL_PRINTLN(stats_mean(&light_stats));    
 #endif  
 }
 //--------------- end application specific -----------------------------
@@ -261,10 +441,7 @@ void Hardware::init_serial() {
 
 // internal function
 void Hardware::init_hardware() {
-    for (int i=0; i<NUM_RELAYS; i++) {
-    pinMode(relay_pin[i], OUTPUT);
-    digitalWrite(relay_pin[i],pC->OFF);  // this pC->OFF is the default value; it may change after Config.init() later
-  }  
+  relays.init(&pC->active_low);  // this is the default value; it may change after Config.init() later
   pinMode(led1, OUTPUT);
   pinMode(led2, OUTPUT);
 #ifdef PIR_PRESENT   
@@ -274,48 +451,48 @@ void Hardware::init_hardware() {
   pinMode(radar, INPUT);
 #endif    
 #ifdef DHT_PRESENT    
-  dht.begin();
+  dht22.begin();
 #endif  
+  init_motion_interrupts();
   blink1();
 }
 
 void Hardware::release_all_relays() {
-    for (int i=0; i<NUM_RELAYS; i++) 
-    digitalWrite(relay_pin[i],pC->OFF);  // this time pC->OFF hopefully contains the initialized value
+    relays.clear_all();  // this time pC->active_low hopefully contains the initialized value
 } 
   
 // these two are invoked by algorithm based on light level or time of the day or movement
 void Hardware::primary_light_on() {
-  digitalWrite (relay_pin[pC->primary_relay], pC->ON);
-  relay_status[pC->primary_relay] = 1;
+  relays.set (pC->primary_relay, true);
   //SERIAL_PRINTLN(F("Primary light is ON")); // Portico: this will be called once in 5 minutes...
   //////pCmd->send_status();   // ... and Bath room: triggered by movements
 }
 
 void Hardware::primary_light_off() {
-  digitalWrite (relay_pin[pC->primary_relay], pC->OFF);
-  relay_status[pC->primary_relay] = 0;
+  relays.set (pC->primary_relay, false);
   //SERIAL_PRINTLN(F("Primary light is OFF"));   // this will be called once in 5 minutes!
   //////pCmd->send_status();   // do not flood the server !
 }       
         
 // these two are invoked by remote MQTT command
-// either of the two relays can be operated
+// any relay of the bank can be operated
 void Hardware::relay_on (short relay_number) {
   SERIAL_PRINT(F("Remote command: ON; Relay : "));
   SERIAL_PRINTLN (relay_number);  
-  digitalWrite (relay_pin[relay_number], pC->ON);
-  relay_status[relay_number] = 1;
+  relays.set (relay_number, true);
   pCmd->send_status();  // TODO: send the status as an argument? NO. even the main .ino can send data
 }
 
 void Hardware::relay_off (short relay_number) {
   SERIAL_PRINT(F("Remote command: OFF; Relay : "));
   SERIAL_PRINTLN (relay_number);    
-  digitalWrite (relay_pin[relay_number], pC->OFF);
-  relay_status[relay_number] = 0;
+  relays.set (relay_number, false);
   pCmd->send_status();  // TODO: send the status as an argument? NO. even the main .ino can send data
 }
+
+byte Hardware::relay_count() {
+  return relays.size();
+}
 //-------------------------------------------------------------------------
 
 void Hardware::blink1() {
@@ -8,32 +8,61 @@
 #include "config.h"
 #include "settings.h"
 #include "utilities.h"
+#include "lightFilter.h"
+#include "stats.h"
+#include "relayBank.h"
 #include <Timer.h>    // https://github.com/JChristensen/Timer
 #include <DHT.h>      // https://github.com/adafruit/DHT-sensor-library (delete DHT_U.h & DHT_U.cpp)
 
 #define  MAX_LIGHT        1024   // NodeMCU has 10 bit ADC
 #define  NOISE_THRESHOLD  10    // when the light sensor fails, this will be the max ADC noise
+#define  DHT_READ_INTERVAL  20000  // mSec; a background DHT22 conversion is started this often
 
 class CommandHandler; // forward declaration
 
+enum {STATS_TEMPERATURE=0, STATS_HUMIDITY, STATS_LIGHT, NUM_STATS};  // index into getStats()
+
+// Edges of a motion sensor, captured by its GPIO interrupt (see hardware.cpp)
+struct motion_channel {
+    unsigned short hits;        // rising edges in the current report window
+    unsigned long  first_edge;  // millis() at the first rising edge of the window
+    unsigned long  last_edge;   // millis() at the latest rising edge
+    unsigned long  rise_time;   // millis() at the rising edge of the current pulse
+    unsigned long  max_pulse;   // longest high pulse in the window, mSec
+    bool           level;       // pin level after the latest edge
+    bool           pending;     // an edge not yet seen by the occupancy logic
+};
+
+// per minute hit counts, for the telemetry deadband
+struct hit_tracker {
+    unsigned short seen;      // window hits at the previous reading
+    unsigned short minute;    // hits in the latest minute
+    unsigned short reported;  // hits per minute at the last report
+};
+
 class Hardware {
 public:
     data sensor_data;
     Hardware ();
     void  init (Config *configptr, Timer *timerptr, CommandHandler *cmdptr);
     void  infinite_loop ();
+    void  update ();
+    void  get_dht_stats (unsigned long *conversions, unsigned long *failures);
     void  reboot_esp ();
     short is_night_time(); 
     const char* getStatus ();
     const data* getData ();
+    const stats_summary* getStats ();  // NUM_STATS entries, of the last report window
     bool  getPir (); 
     bool  getRadar ();
-    bool  showPirStatus ();
-    bool  showRadarStatus ();
+    bool  motion_pending ();
+    void  get_motion (motion_channel *pir_copy, motion_channel *radar_copy);
     bool  read_sensors();
+    bool  is_check_time();
     void  release_all_relays();    
     void  relay_on  (short relay_number);
     void  relay_off (short relay_number);
+    byte  relay_count ();
     void  primary_light_on ();
     void  primary_light_off ();
     void  blink1 ();
@@ -50,38 +79,43 @@ private:
     Config *pC;
     CommandHandler *pCmd;
    
-    // GPIO pins in Node MCU nomenclature; note that the number of relays is hard coded in the next 3 lines
-    byte  relay_pin[2] = {RELAY1, RELAY2};   // TODO: introduce NUM_RELAYS here  
+    // GPIO pins in Node MCU nomenclature
+    RelayBank<NUM_RELAYS> relays;  // pins from RELAY_PINS in pins.h
     byte  led1 = LED1;              
     byte  led2 = LED2;                
     byte  LEDS[2] = {led1, led2};  // enum: green,red    
 #ifdef PIR_PRESENT      
     const byte pir = PIR;
-    bool pir_fired = false;
+    hit_tracker pir_track = {0, 0, 0};
 #endif
 #ifdef RADAR_PRESENT      
     const byte radar = RADAR;
-    bool radar_fired = false;
+    hit_tracker radar_track = {0, 0, 0};
 #endif
 #ifdef LDR_PRESENT      
     const byte ldr = LDR;  
+    LightFilter ldr_filter;
+    unsigned long ldr_sample_time = 0;
 #endif  
-    char    relay_status_str[3];       // including the null // TODO: introduce NUM_RELAYS here   
-    boolean relay_status[2] = {0, 0};  // TODO: introduce NUM_RELAYS here   
-    boolean pir_status; 
-    boolean radar_status;
-    float   temperature; // holds cumulative intermediate values before averaging
-    float   humidity;    // holds cumulative intermediate values before averaging
-    float   hindex;
-    short   light;
+    sensor_stats  temp_stats;   // valid readings since the last report; tenths
+    sensor_stats  humi_stats;
+    sensor_stats  light_stats;  // in the reported scale (MAX_LIGHT - ADC)
+    stats_summary window_summary[NUM_STATS] = {};  // of the last report window
+    short   last_light;  // the latest filtered reading
     
-    int valid_reading_count = 0;
-    int sensor_reading_count;
+    int sensor_reading_count = 0;
+    int check_count = 0;
+    bool never_reported = true;  // the first reading is always sent
     
     void init_serial();
     void print_configuration();
     void init_hardware();
     void read_dht_ldr();    
+    bool reading_changed();
+    void close_stats_window();
+    bool hits_changed (const hit_tracker *track);
+    void init_motion_interrupts();
+    short filtered_light();
 };
 
 
@@ -0,0 +1,228 @@
+// bench.cpp -- host benchmark of the command path
+// Takes the place of Main.ino: the same globals and MQTT hooks, but there is no loop(); the queued commands
+// are run at once. It reports:
+//   - per command: dispatch time through CommandHandler::handle_command(), the reply length against
+//     MAX_MSG_LENGTH and the MQTT packet, and the heap allocations made
+//   - the whole path of a json command: callback() -> parse -> queue -> handler -> publish
+//   - the command lookup: the old linear strcmp() scan against the command table (the BEN command)
+//   - json parse time and the document size on the stack: zero copy against copying
+// The times are those of the host, not of the ESP; compare them with each other, and across commits.
+// "bench quick" runs fewer rounds, and fails if any reply is truncated or is not valid json (ctest runs this).
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "host.h"
+#include "main.h"
+#include <chrono>
+#include <vector>
+
+Config C;
+Hardware hard;
+Timer T;
+AWS aws;
+CommandHandler cmd;
+Spool spool;
+Transport transport;
+Outbox outbox;
+
+//-------------------------------------------------------------------------
+// the hooks of Main.ino
+void notify_command (const char* command) {
+    cmd.queue.push(CMD_COMMAND, command, NULL);
+}
+
+void notify_get_param (const char* param) {
+    cmd.queue.push(CMD_GET, param, NULL);
+}
+
+void notify_set_param (const char* param, const char *value){
+    cmd.queue.push(CMD_SET, param, value);
+}
+
+void notify_batch (const char* const* commands, short count) {
+    cmd.queue.push_batch(commands, count);
+}
+
+void notify_ack (unsigned short seq) {
+    outbox.ack(seq);
+}
+
+void notify_part (const byte* frame, unsigned int length) {
+    assembler.add_part(frame, length);
+}
+
+void reset_wifi() {}
+void check_for_updates() {}
+bool is_night_now() { return true; }
+bool is_occupied() { return false; }
+
+void run_command_queue() {
+    queued_command* qc;
+    while ((qc = cmd.queue.front()) != NULL) {
+        switch (qc->kind) {
+          case CMD_COMMAND:
+            cmd.handle_command(qc->command);
+            break;
+          case CMD_GET:
+            cmd.get_param(qc->command);
+            break;
+          case CMD_SET:
+            C.set_param(qc->command, qc->value);
+            break;
+          case CMD_BATCH:
+            cmd.handle_batch(qc->value);
+            break;
+        }
+        cmd.queue.release();
+    }
+}
+//-------------------------------------------------------------------------
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_us (bench_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+}
+
+static int failures = 0;
+
+static void fail (const char* what, const char* command, const std::string& payload) {
+    printf("FAIL: %s: %s -> %s\n", command, what, payload.c_str());
+    failures++;
+}
+
+// a json reply must parse; snprintf() stops at MAX_MSG_LENGTH-2 characters, so a reply that long was cut short
+static void check_reply (const char* command, const host::published& p) {
+    if (p.payload.empty() || p.payload[0] != '{')
+        return;  // a binary frame
+    if (p.payload.length() >= MAX_MSG_LENGTH-2)
+        fail("truncated", command, p.payload);
+    DynamicJsonDocument doc(1024);
+    if (deserializeJson(doc, p.payload.c_str()))
+        fail("invalid json", command, p.payload);
+}
+
+// every command that needs no network; REB, DEL, UPD, CER and BEN are left out
+static const char* bench_commands[] = {
+    "STA", "VER", "MAC", "GRO", "ORG", "HEA", "AUT", "MAN", "MOD", "BL0", "BL1", "DAT", "WIN", "LOJ", "ISN", "OCC",
+    "PRF", "JSN", "BOT", "TLS", "TLC", "MET", "OUT", "NET", "LAT", "MOT", "SPL", "QUE", "ON0", "OF0", "PAU", "RES"
+};
+#define  NUM_BENCH_COMMANDS   (sizeof(bench_commands)/sizeof(bench_commands[0]))
+
+static void bench_commands_direct (int rounds) {
+    printf("\n%-5s %9s %9s %6s %6s %5s %7s\n", "cmd", "mean us", "max us", "reply", "limit", "fits", "allocs");
+    size_t topic_length = strlen(C.mqtt_pub_topic);
+    for (size_t i=0; i<NUM_BENCH_COMMANDS; i++) {
+        const char* command = bench_commands[i];
+        double total = 0, worst = 0;
+        size_t longest = 0;
+        bool fits = true;
+        unsigned long allocations = 0;
+        for (int r=0; r<rounds; r++) {
+            host::publishes.clear();
+            host::reset_heap_counts();
+            bench_clock::time_point start = bench_clock::now();
+            cmd.handle_command(command);
+            double us = elapsed_us(start);
+            allocations = std::max(allocations, host::allocations);
+            total += us;
+            worst = std::max(worst, us);
+            for (const host::published& p : host::publishes) {
+                longest = std::max(longest, p.payload.length());
+                fits = fits && p.sent;
+                if (r == 0)
+                    check_reply(command, p);
+            }
+        }
+        printf("%-5s %9.2f %9.2f %6zu %6d %5s %7lu\n", command, total/rounds, worst, longest, MAX_MSG_LENGTH,
+               longest == 0 ? "-" : (fits ? "yes" : "NO"), allocations);
+    }
+    printf("(limit: MAX_MSG_LENGTH; fits: within the %d byte MQTT packet, with the %zu byte topic)\n",
+           MQTT_MAX_PACKET_SIZE, topic_length);
+}
+
+// the full path of a json command message, as it arrives from the broker
+static void bench_callback (int rounds) {
+    const char* messages[] = { "{\"C\":\"STA\"}", "{\"C\":\"DAT\"}", "{\"C\":[\"ON0\",\"OF0\",\"STA\"]}", "{\"G\":\"AOFF\"}" };
+    printf("\n%-28s %9s %9s\n", "message", "mean us", "max us");
+    char topic[] = "sub";
+    char payload[MAX_MSG_LENGTH+1];
+    for (const char* message : messages) {
+        double total = 0, worst = 0;
+        for (int r=0; r<rounds; r++) {
+            host::publishes.clear();
+            size_t length = strlen(message);
+            memcpy(payload, message, length);  // the callback may write into the payload
+            bench_clock::time_point start = bench_clock::now();
+            callback(topic, (byte*)payload, length);
+            run_command_queue();
+            double us = elapsed_us(start);
+            total += us;
+            worst = std::max(worst, us);
+            if (r == 0 && host::publishes.empty())
+                fail("no reply", message, "");
+        }
+        printf("%-28s %9.2f %9.2f\n", message, total/rounds, worst);
+    }
+}
+
+// the BEN command publishes its own timing; it is taken from the reply
+static void bench_lookup() {
+    host::publishes.clear();
+    cmd.handle_command("BEN");
+    printf("\ncommand lookup (BEN): %s\n", host::publishes.empty() ? "no reply" : host::publishes.back().payload.c_str());
+    if (!host::publishes.empty())
+        check_reply("BEN", host::publishes.back());
+}
+
+static void bench_parse (int rounds) {
+    const char* messages[] = { "{\"C\":\"STA\"}", "{\"S\":{\"P\":\"AOFF\",\"V\":\"15\"}}",
+                               "{\"C\":[\"ON0\",\"ON1\",\"OF0\",\"OF1\",\"STA\",\"DAT\",\"WIN\",\"MOT\"]}" };
+    printf("\njson document on the stack: JSON_PARSE_DOC_SIZE = %d bytes\n", (int)JSON_PARSE_DOC_SIZE);
+    printf("%-56s %10s %10s %6s %6s\n", "message", "in place", "copying", "used", "used");
+    printf("%-56s %10s %10s %6s %6s\n", "", "us", "us", "bytes", "bytes");
+    char buffer[MAX_MSG_LENGTH+1];
+    for (const char* message : messages) {
+        size_t length = strlen(message);
+        double in_place = 0, copying = 0;
+        size_t in_place_bytes = 0, copying_bytes = 0;
+        for (int r=0; r<rounds; r++) {
+            StaticJsonDocument<JSON_PARSE_DOC_SIZE> doc;
+            memcpy(buffer, message, length);
+            bench_clock::time_point start = bench_clock::now();
+            DeserializationError e1 = deserializeJson(doc, buffer, length);
+            in_place += elapsed_us(start);
+            in_place_bytes = doc.memoryUsage();
+            start = bench_clock::now();
+            DeserializationError e2 = deserializeJson(doc, (const char*)message, length);
+            copying += elapsed_us(start);
+            copying_bytes = doc.memoryUsage();
+            if (r == 0 && (e1 || e2))
+                fail("parse error", message, (e1 ? e1 : e2).c_str());
+        }
+        printf("%-56s %10.3f %10.3f %6zu %6zu\n", message, in_place/rounds, copying/rounds, in_place_bytes, copying_bytes);
+    }
+}
+
+int main (int argc, char* argv[]) {
+    bool quick = (argc > 1 && strcmp(argv[1], "quick") == 0);
+    host::verbose = (argc > 1 && strcmp(argv[1], "verbose") == 0);
+    int rounds = quick ? 20 : 2000;
+
+    // as in setup(), less the network
+    hard.init(&C, &T, &cmd);
+    C.init();  // no certificates in the simulated flash; the defaults stay
+    hard.release_all_relays();
+    spool.init();
+    transport.init(&C, &aws);
+    outbox.init(&C, &transport);
+    cmd.init(&C, &transport, &outbox, &hard, &spool, &aws);
+    aws.getPubSubClient()->connect("bench");
+
+    bench_commands_direct(rounds);
+    bench_callback(rounds);
+    bench_lookup();
+    bench_parse(rounds * 10);
+    printf("\n%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,179 @@
+// Arduino.h -- host shim
+// Just enough of the ESP8266 Arduino core to build the firmware classes on Linux (see host/CMakeLists.txt).
+// Pins, clock, heap and RTC memory are simulated; the test code drives them through host.h.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F(x)              (x)
+#define PSTR(x)           (x)
+#define PROGMEM
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+
+#define HIGH              1
+#define LOW               0
+#define INPUT             0
+#define OUTPUT            1
+#define INPUT_PULLUP      2
+#define CHANGE            3
+#define RISING            1
+#define FALLING           2
+#define HEX               16
+#define DEC               10
+
+// NodeMCU pin names
+#define D0   16
+#define D1   5
+#define D2   4
+#define D3   0
+#define D4   2
+#define D5   14
+#define D6   12
+#define D7   13
+#define D8   15
+#define A0   17
+#define LED_BUILTIN   2
+
+using std::min;
+using std::max;
+
+class String {
+public:
+    String() {}
+    String(const char* s) : str(s ? s : "") {}
+    String(const std::string& s) : str(s) {}
+    String(int v) : str(std::to_string(v)) {}
+    String(long v) : str(std::to_string(v)) {}
+    String(unsigned long v) : str(std::to_string(v)) {}
+    const char* c_str() const { return str.c_str(); }
+    size_t length() const { return str.length(); }
+    long toInt() const { return atol(str.c_str()); }
+    float toFloat() const { return (float)atof(str.c_str()); }
+    bool operator== (const char* s) const { return str == (s ? s : ""); }
+    bool operator== (const String& s) const { return str == s.str; }
+    bool operator!= (const char* s) const { return !(*this == s); }
+    String& operator+= (const char* s) { str += s; return *this; }
+    String& operator+= (char c) { str += c; return *this; }
+    String operator+ (const char* s) const { return String(str + s); }
+    char operator[] (size_t i) const { return str[i]; }
+    void trim();
+private:
+    std::string str;
+};
+
+// Serial output goes to stdout only when host::verbose is set; the benchmark keeps it quiet
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base=DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base=DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base=DEC);
+    size_t print(unsigned long v, int base=DEC);
+    size_t print(unsigned char v, int base=DEC) { return print((unsigned long)v, base); }
+    size_t print(short v, int base=DEC) { return print((long)v, base); }
+    size_t print(unsigned short v, int base=DEC) { return print((unsigned long)v, base); }
+    size_t print(double v, int digits=2);
+    size_t print(bool v) { return print((int)v); }
+    template<class T> size_t println(T v) { return print(v) + println(); }
+    template<class T> size_t println(T v, int f) { return print(v, f) + println(); }
+    size_t println() { return write("\r\n"); }
+    size_t printf(const char* format, ...);
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+    virtual size_t readBytes(uint8_t* buffer, size_t length);
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+    String readStringUntil(char terminator);
+    void setTimeout(unsigned long ms) { timeout_ms = ms; }
+protected:
+    unsigned long timeout_ms = 1000;
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    void setDebugOutput(bool) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+extern HardwareSerial Serial;
+
+// the clock is the host's monotonic clock, plus the time skipped by delay() (which returns at once)
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int  digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int  analogRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void noInterrupts() {}
+inline void interrupts() {}
+extern volatile uint32_t GPOS, GPOC;   // the set/clear registers; relayBank.h writes them
+
+long random(long max_value);
+long random(long min_value, long max_value);
+void randomSeed(unsigned long seed);
+
+char* itoa(int value, char* buffer, int base);
+char* ltoa(long value, char* buffer, int base);
+char* utoa(unsigned value, char* buffer, int base);
+char* ultoa(unsigned long value, char* buffer, int base);
+
+// heap figures come from the counting operator new/delete in shim.cpp
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMaxFreeBlockSize() { return getFreeHeap(); }
+    uint8_t  getHeapFragmentation() { return 0; }
+    uint32_t getFreeContStack() { return 4096; }
+    uint32_t getChipId() { return 0x00C0FFEE; }
+    uint32_t getCycleCount() { return micros() * 80; }
+    uint32_t random() { return (uint32_t)::random(0x7FFFFFFF); }
+    void restart();
+    void reset() { restart(); }
+    String getResetReason() { return String("Host"); }
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+    uint32_t getSketchSize() { return 0; }
+    uint32_t getFreeSketchSpace() { return 0; }
+    String getSketchMD5() { return String(); }
+    bool flashRead(uint32_t, uint32_t*, size_t) { return false; }
+};
+extern EspClass ESP;
+
+#endif
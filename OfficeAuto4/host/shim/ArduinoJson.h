@@ -0,0 +1,190 @@
+// ArduinoJson.h -- host shim
+// The subset of ArduinoJson 6 that the firmware uses: deserializeJson() into a Static/DynamicJsonDocument,
+// and read access through JsonVariant/JsonArray/JsonObject. It keeps the same memory model, so that the
+// document sizes in the firmware mean the same on the host: every value inside an object or array takes one
+// 16 byte slot of the capacity, and a string is copied into the document only when the input is const
+// (a char* input is parsed in place, and the strings stay in the input buffer).
+// To build against the real library instead, configure with -DARDUINOJSON_DIR=<path to its src folder>.
+
+#ifndef HOST_ARDUINOJSON_H
+#define HOST_ARDUINOJSON_H
+
+#include <Arduino.h>
+
+#define ARDUINOJSON_SLOT_SIZE            16
+#define ARDUINOJSON_DEFAULT_NESTING_LIMIT 10
+#define JSON_OBJECT_SIZE(n)   ((n) * ARDUINOJSON_SLOT_SIZE)
+#define JSON_ARRAY_SIZE(n)    ((n) * ARDUINOJSON_SLOT_SIZE)
+
+namespace ArduinoJsonHost {
+
+enum NodeType : uint8_t { NODE_NULL = 0, NODE_BOOL, NODE_INTEGER, NODE_FLOAT, NODE_STRING, NODE_ARRAY, NODE_OBJECT };
+
+struct Node {
+    NodeType type;
+    const char* key;      // a member of an object
+    union {
+        bool boolean;
+        long long integer;
+        double real;
+        const char* string;
+        Node* first;      // array or object
+    };
+    Node* next;           // the next element or member
+};
+
+}
+
+class JsonArray;
+class JsonObject;
+
+class JsonVariant {
+public:
+    JsonVariant() : node(NULL) {}
+    explicit JsonVariant(ArduinoJsonHost::Node* node) : node(node) {}
+    bool isNull() const { return node == NULL || node->type == ArduinoJsonHost::NODE_NULL; }
+    JsonVariant operator[] (const char* key) const;
+    JsonVariant operator[] (int index) const;
+    bool containsKey(const char* key) const { return !(*this)[key].isNull(); }
+    size_t size() const;
+    template<class T> T as() const;
+    template<class T> bool is() const;
+    template<class T> operator T() const { return as<T>(); }
+    const char* operator| (const char* fallback) const;
+    template<class T> T operator| (T fallback) const { return isNull() ? fallback : as<T>(); }
+    ArduinoJsonHost::Node* node;
+private:
+    long long to_integer() const;
+    double to_real() const;
+};
+
+class JsonVariantIterator {
+public:
+    explicit JsonVariantIterator(ArduinoJsonHost::Node* node) : node(node) {}
+    JsonVariant operator* () const { return JsonVariant(node); }
+    JsonVariantIterator& operator++ () { node = node->next; return *this; }
+    bool operator!= (const JsonVariantIterator& other) const { return node != other.node; }
+private:
+    ArduinoJsonHost::Node* node;
+};
+
+class JsonArray {
+public:
+    JsonArray() : node(NULL) {}
+    explicit JsonArray(ArduinoJsonHost::Node* node) : node(node) {}
+    bool isNull() const { return node == NULL; }
+    size_t size() const { return JsonVariant(node).size(); }
+    JsonVariant operator[] (int index) const { return JsonVariant(node)[index]; }
+    JsonVariantIterator begin() const { return JsonVariantIterator(node ? node->first : NULL); }
+    JsonVariantIterator end() const { return JsonVariantIterator(NULL); }
+private:
+    ArduinoJsonHost::Node* node;
+};
+
+class JsonObject {
+public:
+    JsonObject() : node(NULL) {}
+    explicit JsonObject(ArduinoJsonHost::Node* node) : node(node) {}
+    bool isNull() const { return node == NULL; }
+    size_t size() const { return JsonVariant(node).size(); }
+    JsonVariant operator[] (const char* key) const { return JsonVariant(node)[key]; }
+    bool containsKey(const char* key) const { return JsonVariant(node).containsKey(key); }
+private:
+    ArduinoJsonHost::Node* node;
+};
+
+template<class T> inline T JsonVariant::as() const { return (T)to_integer(); }
+template<> inline float JsonVariant::as<float>() const { return (float)to_real(); }
+template<> inline double JsonVariant::as<double>() const { return to_real(); }
+template<> inline bool JsonVariant::as<bool>() const { return to_integer() != 0; }
+template<> inline const char* JsonVariant::as<const char*>() const {
+    return (node && node->type == ArduinoJsonHost::NODE_STRING) ? node->string : NULL;
+}
+template<> inline JsonVariant JsonVariant::as<JsonVariant>() const { return *this; }
+template<> inline JsonArray JsonVariant::as<JsonArray>() const {
+    return JsonArray((node && node->type == ArduinoJsonHost::NODE_ARRAY) ? node : NULL);
+}
+template<> inline JsonObject JsonVariant::as<JsonObject>() const {
+    return JsonObject((node && node->type == ArduinoJsonHost::NODE_OBJECT) ? node : NULL);
+}
+
+inline const char* JsonVariant::operator| (const char* fallback) const {
+    const char* s = as<const char*>();
+    return s ? s : fallback;
+}
+
+template<class T> inline bool JsonVariant::is() const {
+    return node && (node->type == ArduinoJsonHost::NODE_INTEGER);
+}
+template<> inline bool JsonVariant::is<float>() const {
+    return node && (node->type == ArduinoJsonHost::NODE_INTEGER || node->type == ArduinoJsonHost::NODE_FLOAT);
+}
+template<> inline bool JsonVariant::is<bool>() const { return node && node->type == ArduinoJsonHost::NODE_BOOL; }
+template<> inline bool JsonVariant::is<const char*>() const { return node && node->type == ArduinoJsonHost::NODE_STRING; }
+template<> inline bool JsonVariant::is<JsonArray>() const { return node && node->type == ArduinoJsonHost::NODE_ARRAY; }
+template<> inline bool JsonVariant::is<JsonObject>() const { return node && node->type == ArduinoJsonHost::NODE_OBJECT; }
+
+class JsonDocument {
+public:
+    JsonVariant operator[] (const char* key) const { return as<JsonVariant>()[key]; }
+    bool containsKey(const char* key) const { return as<JsonVariant>().containsKey(key); }
+    template<class T> T as() const { return JsonVariant(used > 0 ? nodes : NULL).as<T>(); }
+    size_t capacity() const { return capacity_bytes; }
+    size_t memoryUsage() const { return used_bytes; }
+    void clear() { used = 0; used_bytes = 0; }
+    // for the parser
+    ArduinoJsonHost::Node* new_node (bool is_root);
+    char* save_string (const char* s, size_t length);
+protected:
+    JsonDocument(ArduinoJsonHost::Node* nodes, size_t max_nodes, char* strings, size_t capacity)
+        : nodes(nodes), max_nodes(max_nodes), strings(strings), capacity_bytes(capacity) {}
+    ArduinoJsonHost::Node* nodes;
+    size_t max_nodes;
+    char* strings;
+    size_t capacity_bytes;
+    size_t used = 0;          // nodes
+    size_t used_bytes = 0;    // of the capacity, counted as on the device
+    size_t string_bytes = 0;
+private:
+    JsonDocument(const JsonDocument&);
+    JsonDocument& operator= (const JsonDocument&);
+};
+
+template<size_t CAPACITY>
+class StaticJsonDocument : public JsonDocument {
+public:
+    StaticJsonDocument() : JsonDocument(node_pool, CAPACITY/ARDUINOJSON_SLOT_SIZE + 1, string_pool, CAPACITY) {}
+private:
+    ArduinoJsonHost::Node node_pool[CAPACITY/ARDUINOJSON_SLOT_SIZE + 1];
+    char string_pool[CAPACITY];
+};
+
+// one heap block, as in the real library
+class DynamicJsonDocument : public JsonDocument {
+public:
+    explicit DynamicJsonDocument(size_t capacity);
+    ~DynamicJsonDocument();
+};
+
+class DeserializationError {
+public:
+    enum Code { Ok, EmptyInput, IncompleteInput, InvalidInput, NoMemory, TooDeep };
+    DeserializationError() : value(Ok) {}
+    DeserializationError(Code code) : value(code) {}
+    explicit operator bool() const { return value != Ok; }
+    bool operator== (Code code) const { return value == code; }
+    bool operator!= (Code code) const { return value != code; }
+    Code code() const { return value; }
+    const char* c_str() const;
+private:
+    Code value;
+};
+
+DeserializationError deserializeJson(JsonDocument& doc, char* input);                         // in place
+DeserializationError deserializeJson(JsonDocument& doc, char* input, size_t length);          // in place
+DeserializationError deserializeJson(JsonDocument& doc, const char* input);                   // copies the strings
+DeserializationError deserializeJson(JsonDocument& doc, const char* input, size_t length);    // copies the strings
+DeserializationError deserializeJson(JsonDocument& doc, const uint8_t* input, size_t length); // copies the strings
+DeserializationError deserializeJson(JsonDocument& doc, Stream& input);                       // copies the strings
+
+#endif
@@ -0,0 +1,22 @@
+// Client.h -- host shim
+
+#ifndef HOST_CLIENT_H
+#define HOST_CLIENT_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+class Client : public Stream {
+public:
+    virtual int connect(const char*, uint16_t) { return 0; }
+    virtual int connect(IPAddress, uint16_t) { return 0; }
+    virtual uint8_t connected() { return 0; }
+    virtual void stop() {}
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+};
+
+#endif
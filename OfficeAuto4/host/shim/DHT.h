@@ -0,0 +1,19 @@
+// DHT.h -- host shim; the sensor is never there
+
+#ifndef HOST_DHT_H
+#define HOST_DHT_H
+
+#include <Arduino.h>
+
+#define DHT22   22
+
+class DHT {
+public:
+    DHT(uint8_t, uint8_t) {}
+    void begin() {}
+    float readTemperature(bool fahrenheit=false) { return NAN; }
+    float readHumidity() { return NAN; }
+    float computeHeatIndex(float, float, bool fahrenheit=true) { return NAN; }
+};
+
+#endif
@@ -0,0 +1,27 @@
+// ESP8266HTTPClient.h -- host shim; every request fails to connect
+
+#ifndef HOST_ESP8266HTTPCLIENT_H
+#define HOST_ESP8266HTTPCLIENT_H
+
+#include <ESP8266WiFi.h>
+
+#define HTTP_CODE_OK               200
+#define HTTPC_ERROR_CONNECTION_FAILED  (-1)
+
+class HTTPClient {
+public:
+    bool begin(WiFiClient&, const char* url) { return url != NULL && url[0] != '\0'; }
+    bool begin(const char* url) { return url != NULL && url[0] != '\0'; }
+    int GET() { return HTTPC_ERROR_CONNECTION_FAILED; }
+    void end() {}
+    int getSize() { return -1; }
+    String getString() { return String(); }
+    String getLocation() { return String(); }
+    WiFiClient* getStreamPtr() { return &stream; }
+    int writeToStream(Stream*) { return HTTPC_ERROR_CONNECTION_FAILED; }
+    static String errorToString(int) { return String("connection failed"); }
+private:
+    WiFiClient stream;
+};
+
+#endif
@@ -0,0 +1,104 @@
+// ESP8266WiFi.h -- host shim
+// The station is up or down as host::wifi_up says; there is no network. TLS is not simulated.
+
+#ifndef HOST_ESP8266WIFI_H
+#define HOST_ESP8266WIFI_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <Client.h>
+#include <FS.h>
+extern "C" {
+  #include "user_interface.h"
+}
+
+#define WL_IDLE_STATUS     0
+#define WL_NO_SSID_AVAIL   1
+#define WL_CONNECTED       3
+#define WL_CONNECT_FAILED  4
+#define WL_DISCONNECTED    6
+typedef int wl_status_t;
+enum WiFiMode_t { WIFI_OFF = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+
+class ESP8266WiFiClass {
+public:
+    wl_status_t status();
+    bool mode(WiFiMode_t) { return true; }
+    void persistent(bool) {}
+    bool config(IPAddress, IPAddress, IPAddress, IPAddress dns=IPAddress()) { return true; }
+    wl_status_t begin(const char*, const char*, int32_t channel=0, const uint8_t* bssid=NULL, bool connect=true) { return status(); }
+    wl_status_t begin() { return status(); }
+    bool disconnect(bool wifioff=false) { return true; }
+    bool softAPdisconnect(bool wifioff=false) { return true; }
+    void forceSleepBegin() {}
+    bool setAutoReconnect(bool) { return true; }
+    bool setAutoConnect(bool) { return true; }
+    String SSID() { return String("host"); }
+    String psk() { return String(); }
+    String macAddress() { return String("5C:CF:7F:00:00:01"); }
+    uint8_t* macAddress(uint8_t* mac);
+    uint8_t* BSSID() { return bssid; }
+    int32_t channel() { return 6; }
+    int32_t RSSI() { return -60; }
+    IPAddress localIP() { return IPAddress(192,168,1,50); }
+    IPAddress gatewayIP() { return IPAddress(192,168,1,1); }
+    IPAddress subnetMask() { return IPAddress(255,255,255,0); }
+    IPAddress dnsIP(uint8_t n=0) { return IPAddress(192,168,1,1); }
+    int hostByName(const char*, IPAddress& result) { result = IPAddress(10,0,0,1); return 1; }
+private:
+    uint8_t bssid[6] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60};
+};
+extern ESP8266WiFiClass WiFi;
+
+class WiFiClient : public Client {
+};
+
+#define BR_KEYTYPE_RSA    1
+#define BR_KEYTYPE_EC     2
+#define BR_KEYTYPE_KEYX   0x10
+#define BR_KEYTYPE_SIGN   0x20
+
+namespace BearSSL {
+    class X509List {
+    public:
+        X509List() {}
+        X509List(const uint8_t*, size_t) {}
+        bool append(const uint8_t*, size_t) { return true; }
+        size_t getCount() const { return 1; }
+    };
+    class PrivateKey {
+    public:
+        PrivateKey() {}
+        PrivateKey(const uint8_t*, size_t) {}
+        bool parse(const uint8_t*, size_t) { return true; }
+        bool isRSA() const { return true; }
+    };
+    struct br_ssl_session_parameters {
+        uint8_t session_id[32];
+        uint8_t session_id_len;
+        uint16_t version;
+        uint16_t cipher_suite;
+        uint8_t master_secret[48];
+    };
+    class Session {
+    public:
+        Session() { memset(&session, 0, sizeof(session)); }
+        br_ssl_session_parameters* getSession() { return &session; }
+    private:
+        br_ssl_session_parameters session;
+    };
+    class WiFiClientSecure : public WiFiClient {
+    public:
+        void setBufferSizes(int, int) {}
+        void setX509Time(time_t) {}
+        void setTrustAnchors(const X509List*) {}
+        void setClientRSACert(const X509List*, const PrivateKey*) {}
+        void setClientECCert(const X509List*, const PrivateKey*, unsigned, unsigned) {}
+        void setSession(Session*) {}
+        void setInsecure() {}
+        int getLastSSLError(char* dest=NULL, size_t len=0) { if (dest && len) dest[0] = '\0'; return 0; }
+    };
+}
+using BearSSL::WiFiClientSecure;
+
+#endif
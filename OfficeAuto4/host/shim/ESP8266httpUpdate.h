@@ -0,0 +1,25 @@
+// ESP8266httpUpdate.h -- host shim; the update always fails
+
+#ifndef HOST_ESP8266HTTPUPDATE_H
+#define HOST_ESP8266HTTPUPDATE_H
+
+#include <ESP8266HTTPClient.h>
+
+enum HTTPUpdateResult { HTTP_UPDATE_FAILED, HTTP_UPDATE_NO_UPDATES, HTTP_UPDATE_OK };
+typedef HTTPUpdateResult t_httpUpdate_return;
+
+class ESP8266HTTPUpdate {
+public:
+    void onStart(void (*)(void)) {}
+    void onEnd(void (*)(void)) {}
+    void onProgress(void (*)(int, int)) {}
+    void onError(void (*)(int)) {}
+    void rebootOnUpdate(bool) {}
+    void setLedPin(int, uint8_t) {}
+    t_httpUpdate_return update(const char*) { return HTTP_UPDATE_FAILED; }
+    int getLastError() { return HTTPC_ERROR_CONNECTION_FAILED; }
+    String getLastErrorString() { return String("host build"); }
+};
+extern ESP8266HTTPUpdate ESPhttpUpdate;
+
+#endif
@@ -0,0 +1,80 @@
+// FS.h -- host shim
+// SPIFFS kept in memory: a map from the full path to the file contents. Enough for the config file,
+// the certificates and the spool segments.
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+typedef std::vector<uint8_t> host_file_data;
+
+class File : public Stream {
+public:
+    File() {}
+    File(std::shared_ptr<host_file_data> data, const std::string& path, bool writable, size_t position)
+        : data(data), path(path), writable(writable), pos(position) {}
+    operator bool() const { return (bool)data; }
+    bool isFile() const { return (bool)data; }
+    const char* name() const { return path.c_str(); }
+    size_t size() const { return data ? data->size() : 0; }
+    size_t position() const { return pos; }
+    bool seek(uint32_t offset, SeekMode mode=SeekSet);
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override { return data ? (int)(data->size() - pos) : 0; }
+    int read() override;
+    int peek() override;
+    size_t read(uint8_t* buffer, size_t size);
+    size_t readBytes(uint8_t* buffer, size_t size) override { return read(buffer, size); }
+    using Stream::readBytes;
+    void flush() override {}
+    void close() { data.reset(); }
+private:
+    std::shared_ptr<host_file_data> data;
+    std::string path;
+    bool writable = false;
+    size_t pos = 0;
+};
+
+class Dir {
+public:
+    Dir() {}
+    Dir(const std::vector<std::string>& names) : names(names) {}
+    bool next() { return (++index < (int)names.size()); }
+    String fileName() const { return String(names[index].c_str()); }
+    size_t fileSize() const;
+    File openFile(const char* mode) const;
+private:
+    std::vector<std::string> names;
+    int index = -1;
+};
+
+struct FSInfo {
+    size_t totalBytes;
+    size_t usedBytes;
+    size_t blockSize;
+    size_t pageSize;
+};
+
+class FS {
+public:
+    bool begin() { mounted = true; return true; }
+    void end() { mounted = false; }
+    bool format() { files.clear(); return true; }
+    File open(const char* path, const char* mode);
+    bool exists(const char* path) { return mounted && files.count(path) > 0; }
+    bool remove(const char* path) { return mounted && files.erase(path) > 0; }
+    bool rename(const char* from, const char* to);
+    bool info(FSInfo& info);
+    Dir openDir(const char* path);
+    std::map<std::string, std::shared_ptr<host_file_data> > files;
+    bool mounted = false;
+};
+extern FS SPIFFS;
+
+#endif
@@ -0,0 +1,21 @@
+// IPAddress.h -- host shim
+
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress {
+public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t address) : address(address) {}
+    operator uint32_t() const { return address; }
+    bool isSet() const { return address != 0; }
+    String toString() const;
+    bool fromString(const char* s);
+private:
+    uint32_t address = 0;
+};
+
+#endif
@@ -0,0 +1,46 @@
+// PubSubClient.h -- host shim
+// Connects when host::mqtt_up is set; every publish is recorded in host::publishes. The payload limit is
+// the same as on the device: a message longer than MQTT_MAX_PACKET_SIZE, with its header, is refused.
+
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#ifndef MQTT_MAX_PACKET_SIZE
+  #define MQTT_MAX_PACKET_SIZE   128
+#endif
+#define MQTT_CONNECTED           0
+#define MQTT_DISCONNECTED        (-1)
+#define MQTT_CONNECT_FAILED      (-2)
+#define MQTT_CALLBACK_SIGNATURE  void (*callback)(char*, uint8_t*, unsigned int)
+
+class PubSubClient {
+public:
+    PubSubClient() {}
+    PubSubClient(Client&) {}
+    PubSubClient(const char*, uint16_t, MQTT_CALLBACK_SIGNATURE, Client&) : callback(callback) {}
+    PubSubClient& setServer(const char*, uint16_t) { return *this; }
+    PubSubClient& setServer(IPAddress, uint16_t) { return *this; }
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+    PubSubClient& setClient(Client&) { return *this; }
+    bool connect(const char* id);
+    bool connect(const char* id, const char*, const char*) { return connect(id); }
+    void disconnect() { up = false; }
+    bool connected();
+    int state() { return connected() ? MQTT_CONNECTED : MQTT_DISCONNECTED; }
+    bool loop() { return connected(); }
+    bool publish(const char* topic, const char* payload) { return publish(topic, (const uint8_t*)payload, strlen(payload)); }
+    bool publish(const char* topic, const char* payload, bool) { return publish(topic, payload); }
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length);
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool) { return publish(topic, payload, length); }
+    bool subscribe(const char*) { return connected(); }
+    bool subscribe(const char*, uint8_t) { return connected(); }
+    bool unsubscribe(const char*) { return connected(); }
+private:
+    bool up = false;
+    void (*callback)(char*, uint8_t*, unsigned int) = NULL;
+};
+
+#endif
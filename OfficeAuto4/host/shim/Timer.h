@@ -0,0 +1,32 @@
+// Timer.h -- host shim of JChristensen's Timer: periodic and one shot events, run from update()
+
+#ifndef HOST_TIMER_H
+#define HOST_TIMER_H
+
+#include <Arduino.h>
+
+#define MAX_NUMBER_OF_EVENTS   10
+#define TIMER_NOT_AN_EVENT     (-2)
+#define NO_TIMER_AVAILABLE     (-1)
+
+class Timer {
+public:
+    int8_t every(unsigned long period, void (*callback)(void), int repeat_count=-1);
+    int8_t after(unsigned long duration, void (*callback)(void)) { return every(duration, callback, 1); }
+    int8_t oscillate(uint8_t pin, unsigned long period, uint8_t starting_value, int repeat_count=-1);
+    void stop(int8_t id);
+    void update();
+private:
+    struct event {
+        void (*callback)(void);
+        unsigned long period;
+        unsigned long last;
+        int repeat_count;     // -1 = for ever
+        uint8_t pin;          // oscillate() only
+        uint8_t value;
+        bool active;
+    };
+    event events[MAX_NUMBER_OF_EVENTS] = {};
+};
+
+#endif
@@ -0,0 +1,21 @@
+// Updater.h -- host shim; there is no second flash partition
+
+#ifndef HOST_UPDATER_H
+#define HOST_UPDATER_H
+
+#include <Arduino.h>
+
+#define U_FLASH   0
+
+class UpdaterClass {
+public:
+    bool begin(size_t, int command=U_FLASH) { return false; }
+    size_t write(uint8_t*, size_t) { return 0; }
+    bool end(bool evenIfRemaining=false) { return false; }
+    bool setMD5(const char*) { return true; }
+    bool isRunning() { return false; }
+    uint8_t getError() { return 1; }
+};
+extern UpdaterClass Update;
+
+#endif
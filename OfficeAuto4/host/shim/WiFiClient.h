@@ -0,0 +1,2 @@
+// WiFiClient.h -- host shim
+#include <ESP8266WiFi.h>
@@ -0,0 +1,2 @@
+// WiFiClientSecureBearSSL.h -- host shim
+#include <ESP8266WiFi.h>
@@ -0,0 +1,20 @@
+// WiFiManager.h -- host shim
+
+#ifndef HOST_WIFIMANAGER_H
+#define HOST_WIFIMANAGER_H
+
+#include <ESP8266WiFi.h>
+
+class WiFiManager {
+public:
+    void resetSettings() {}
+    void setTimeout(unsigned long) {}
+    void setConfigPortalTimeout(unsigned long) {}
+    void setConnectTimeout(unsigned long) {}
+    bool autoConnect(const char*) { return WiFi.status() == WL_CONNECTED; }
+    bool autoConnect(const char*, const char*) { return WiFi.status() == WL_CONNECTED; }
+    bool startConfigPortal(const char*) { return WiFi.status() == WL_CONNECTED; }
+    bool startConfigPortal(const char*, const char*) { return WiFi.status() == WL_CONNECTED; }
+};
+
+#endif
@@ -0,0 +1,25 @@
+// WiFiUdp.h -- host shim; no packet ever arrives, so the NTP client keeps timing out
+
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+class WiFiUDP : public Stream {
+public:
+    uint8_t begin(uint16_t) { return 1; }
+    void stop() {}
+    int beginPacket(IPAddress, uint16_t) { return 1; }
+    int beginPacket(const char*, uint16_t) { return 1; }
+    int endPacket() { return 1; }
+    int parsePacket() { return 0; }
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+    int read(uint8_t*, size_t) { return 0; }
+    int read() override { return -1; }
+    int available() override { return 0; }
+    int peek() override { return -1; }
+};
+
+#endif
@@ -0,0 +1,40 @@
+// host.h -- host shim
+// The handles that a host test or benchmark uses to drive the simulated board and to read back what the
+// firmware did. Not part of the Arduino API; the firmware never includes this.
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+namespace host {
+
+struct published {
+    std::string topic;
+    std::string payload;   // json text or a binary frame
+    bool sent;             // false: it did not fit the MQTT packet, and the client refused it
+};
+
+extern bool verbose;                 // copy Serial output to stdout
+extern bool mqtt_up;                 // what PubSubClient::connect()/connected() report
+extern bool wifi_up;                 // WiFi.status()
+extern std::vector<published> publishes;   // every PubSubClient::publish() while connected, oldest first
+extern unsigned long restarts;       // ESP.restart() calls
+
+// heap: every operator new/delete of the process is counted
+extern unsigned long allocations;    // since the last reset_heap_counts()
+extern unsigned long allocated_bytes;
+extern long heap_in_use;             // bytes now allocated
+void reset_heap_counts();
+
+void set_pin (uint8_t pin, int value);   // raises the interrupt attached to the pin on an edge
+int  get_pin (uint8_t pin);
+void set_analog (int value);
+void advance_ms (unsigned long ms);      // moves the clock forward, as delay() does
+void clear_files();                      // empties the simulated SPIFFS
+
+}
+
+#endif
@@ -0,0 +1,345 @@
+// json.cpp -- host shim: the parser behind ArduinoJson.h
+
+#include <ArduinoJson.h>
+#include <new>
+
+using namespace ArduinoJsonHost;
+
+JsonVariant JsonVariant::operator[] (const char* key) const {
+    if (node == NULL || node->type != NODE_OBJECT || key == NULL)
+        return JsonVariant();
+    for (Node* n = node->first; n != NULL; n = n->next)
+        if (strcmp(n->key, key) == 0)
+            return JsonVariant(n);
+    return JsonVariant();
+}
+
+JsonVariant JsonVariant::operator[] (int index) const {
+    if (node == NULL || node->type != NODE_ARRAY || index < 0)
+        return JsonVariant();
+    Node* n = node->first;
+    while (n != NULL && index-- > 0)
+        n = n->next;
+    return JsonVariant(n);
+}
+
+size_t JsonVariant::size() const {
+    if (node == NULL || (node->type != NODE_ARRAY && node->type != NODE_OBJECT))
+        return 0;
+    size_t count = 0;
+    for (Node* n = node->first; n != NULL; n = n->next)
+        count++;
+    return count;
+}
+
+long long JsonVariant::to_integer() const {
+    if (node == NULL)
+        return 0;
+    switch (node->type) {
+        case NODE_BOOL:    return node->boolean ? 1 : 0;
+        case NODE_INTEGER: return node->integer;
+        case NODE_FLOAT:   return (long long)node->real;
+        default:           return 0;
+    }
+}
+
+double JsonVariant::to_real() const {
+    if (node != NULL && node->type == NODE_FLOAT)
+        return node->real;
+    return (double)to_integer();
+}
+
+Node* JsonDocument::new_node (bool is_root) {
+    if (!is_root) {
+        if (used_bytes + ARDUINOJSON_SLOT_SIZE > capacity_bytes)
+            return NULL;
+        used_bytes += ARDUINOJSON_SLOT_SIZE;
+    }
+    if (used >= max_nodes)
+        return NULL;
+    Node* n = &nodes[used++];
+    memset(n, 0, sizeof(Node));
+    return n;
+}
+
+char* JsonDocument::save_string (const char* s, size_t length) {
+    if (used_bytes + length + 1 > capacity_bytes)
+        return NULL;
+    used_bytes += length + 1;
+    char* copy = strings + string_bytes;
+    memcpy(copy, s, length);
+    copy[length] = '\0';
+    string_bytes += length + 1;
+    return copy;
+}
+
+DynamicJsonDocument::DynamicJsonDocument (size_t capacity)
+    : JsonDocument(NULL, capacity/ARDUINOJSON_SLOT_SIZE + 1, NULL, capacity) {
+    // one allocation: the nodes, then the strings
+    char* block = (char*)malloc(max_nodes*sizeof(Node) + capacity);
+    nodes = (Node*)block;
+    strings = block + max_nodes*sizeof(Node);
+    if (block == NULL) {
+        max_nodes = 0;
+        capacity_bytes = 0;
+    }
+}
+
+DynamicJsonDocument::~DynamicJsonDocument() {
+    free(nodes);
+}
+
+const char* DeserializationError::c_str() const {
+    switch (value) {
+        case Ok:              return "Ok";
+        case EmptyInput:      return "EmptyInput";
+        case IncompleteInput: return "IncompleteInput";
+        case InvalidInput:    return "InvalidInput";
+        case NoMemory:        return "NoMemory";
+        case TooDeep:         return "TooDeep";
+    }
+    return "???";
+}
+//------------------------------------------------------------------------------------
+
+namespace {
+
+class Parser {
+public:
+    Parser(JsonDocument& doc, char* text, size_t length, bool in_place)
+        : doc(doc), p(text), end(text + length), in_place(in_place) {}
+
+    DeserializationError run() {
+        skip_space();
+        if (p >= end)
+            return DeserializationError::EmptyInput;
+        Node* root = doc.new_node(true);
+        if (root == NULL)
+            return DeserializationError::NoMemory;
+        return parse_value(root, 0);
+    }
+
+private:
+    JsonDocument& doc;
+    char* p;
+    char* end;
+    bool in_place;
+
+    void skip_space() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            p++;
+    }
+
+    DeserializationError parse_value (Node* n, int depth) {
+        skip_space();
+        if (p >= end)
+            return DeserializationError::IncompleteInput;
+        switch (*p) {
+            case '{': return parse_container(n, depth, true);
+            case '[': return parse_container(n, depth, false);
+            case '"':
+            case '\'': {
+                const char* s;
+                DeserializationError error = parse_string(&s);
+                if (error)
+                    return error;
+                n->type = NODE_STRING;
+                n->string = s;
+                return DeserializationError::Ok;
+            }
+        }
+        return parse_literal(n);
+    }
+
+    DeserializationError parse_container (Node* n, int depth, bool is_object) {
+        if (depth >= ARDUINOJSON_DEFAULT_NESTING_LIMIT)
+            return DeserializationError::TooDeep;
+        n->type = is_object ? NODE_OBJECT : NODE_ARRAY;
+        n->first = NULL;
+        char closing = is_object ? '}' : ']';
+        p++;
+        skip_space();
+        if (p < end && *p == closing) {
+            p++;
+            return DeserializationError::Ok;
+        }
+        Node* last = NULL;
+        while (true) {
+            const char* key = NULL;
+            if (is_object) {
+                skip_space();
+                if (p >= end)
+                    return DeserializationError::IncompleteInput;
+                if (*p != '"' && *p != '\'')
+                    return DeserializationError::InvalidInput;
+                DeserializationError error = parse_string(&key);
+                if (error)
+                    return error;
+                skip_space();
+                if (p >= end)
+                    return DeserializationError::IncompleteInput;
+                if (*p++ != ':')
+                    return DeserializationError::InvalidInput;
+            }
+            Node* child = doc.new_node(false);
+            if (child == NULL)
+                return DeserializationError::NoMemory;
+            child->key = key;
+            DeserializationError error = parse_value(child, depth + 1);
+            if (error)
+                return error;
+            if (last == NULL)
+                n->first = child;
+            else
+                last->next = child;
+            last = child;
+            skip_space();
+            if (p >= end)
+                return DeserializationError::IncompleteInput;
+            if (*p == ',') {
+                p++;
+                continue;
+            }
+            if (*p++ == closing)
+                return DeserializationError::Ok;
+            return DeserializationError::InvalidInput;
+        }
+    }
+
+    // unescapes in place; the closing quote becomes the terminator
+    DeserializationError parse_string (const char** result) {
+        char quote = *p++;
+        char* start = p;
+        char* out = p;
+        while (true) {
+            if (p >= end)
+                return DeserializationError::IncompleteInput;
+            char c = *p++;
+            if (c == quote)
+                break;
+            if (c == '\\') {
+                if (p >= end)
+                    return DeserializationError::IncompleteInput;
+                c = *p++;
+                switch (c) {
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    case 'u': {
+                        if (end - p < 4)
+                            return DeserializationError::IncompleteInput;
+                        unsigned code = (unsigned)strtoul(std::string(p, 4).c_str(), NULL, 16);
+                        p += 4;
+                        if (code < 0x80) {
+                            c = (char)code;
+                        } else if (code < 0x800) {
+                            *out++ = (char)(0xC0 | (code >> 6));
+                            c = (char)(0x80 | (code & 0x3F));
+                        } else {
+                            *out++ = (char)(0xE0 | (code >> 12));
+                            *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+                            c = (char)(0x80 | (code & 0x3F));
+                        }
+                        break;
+                    }
+                }
+            }
+            *out++ = c;
+        }
+        size_t length = out - start;
+        if (in_place) {
+            *out = '\0';   // at most the closing quote
+            *result = start;
+            return DeserializationError::Ok;
+        }
+        *result = doc.save_string(start, length);
+        return (*result != NULL) ? DeserializationError::Ok : DeserializationError::NoMemory;
+    }
+
+    DeserializationError parse_literal (Node* n) {
+        char* start = p;
+        while (p < end && strchr(",]} \t\r\n", *p) == NULL)
+            p++;
+        std::string token(start, p - start);
+        if (token.empty())
+            return DeserializationError::InvalidInput;
+        if (token == "true" || token == "false") {
+            n->type = NODE_BOOL;
+            n->boolean = (token == "true");
+            return DeserializationError::Ok;
+        }
+        if (token == "null") {
+            n->type = NODE_NULL;
+            return DeserializationError::Ok;
+        }
+        char* stop;
+        long long integer = strtoll(token.c_str(), &stop, 10);
+        if (*stop == '\0') {
+            n->type = NODE_INTEGER;
+            n->integer = integer;
+            return DeserializationError::Ok;
+        }
+        double real = strtod(token.c_str(), &stop);
+        if (*stop == '\0') {
+            n->type = NODE_FLOAT;
+            n->real = real;
+            return DeserializationError::Ok;
+        }
+        return (p >= end) ? DeserializationError::IncompleteInput : DeserializationError::InvalidInput;
+    }
+};
+
+DeserializationError parse (JsonDocument& doc, char* text, size_t length, bool in_place) {
+    doc.clear();
+    DeserializationError error = Parser(doc, text, length, in_place).run();
+    if (error)
+        doc.clear();
+    return error;
+}
+
+// the const inputs are parsed from a scratch copy; the strings end up in the document
+// (on the stack when it is short, so that the allocation counts of the benchmark are not skewed)
+DeserializationError parse_copy (JsonDocument& doc, const char* text, size_t length) {
+    char small[256];
+    std::unique_ptr<char[]> large;
+    char* scratch = small;
+    if (length >= sizeof(small)) {
+        large.reset(new char[length + 1]);
+        scratch = large.get();
+    }
+    memcpy(scratch, text, length);
+    scratch[length] = '\0';
+    return parse(doc, scratch, length, false);
+}
+
+}
+
+DeserializationError deserializeJson (JsonDocument& doc, char* input) {
+    return parse(doc, input, strlen(input), true);
+}
+
+DeserializationError deserializeJson (JsonDocument& doc, char* input, size_t length) {
+    return parse(doc, input, strnlen(input, length), true);
+}
+
+DeserializationError deserializeJson (JsonDocument& doc, const char* input) {
+    return parse_copy(doc, input, strlen(input));
+}
+
+DeserializationError deserializeJson (JsonDocument& doc, const char* input, size_t length) {
+    return parse_copy(doc, input, strnlen(input, length));
+}
+
+DeserializationError deserializeJson (JsonDocument& doc, const uint8_t* input, size_t length) {
+    return parse_copy(doc, (const char*)input, strnlen((const char*)input, length));
+}
+
+DeserializationError deserializeJson (JsonDocument& doc, Stream& input) {
+    std::string text;
+    int c;
+    while ((c = input.read()) >= 0)
+        text += (char)c;
+    return parse_copy(doc, text.c_str(), text.length());
+}
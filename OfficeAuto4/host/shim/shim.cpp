@@ -0,0 +1,439 @@
+// shim.cpp -- host shim: the simulated board behind the Arduino headers
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ESP8266WiFi.h>
+#include <ESP8266httpUpdate.h>
+#include <Updater.h>
+#include <PubSubClient.h>
+#include <Timer.h>
+#include "host.h"
+#include <chrono>
+#include <cstdarg>
+#include <new>
+
+namespace host {
+    bool verbose = false;
+    bool mqtt_up = true;
+    bool wifi_up = true;
+    std::vector<published> publishes;
+    unsigned long restarts = 0;
+    unsigned long allocations = 0;
+    unsigned long allocated_bytes = 0;
+    long heap_in_use = 0;
+
+    static unsigned long skipped_us = 0;   // by delay() and advance_ms()
+    static int pins[32];
+    static int analog_value = 0;
+    static void (*pin_handlers[32])(void);
+    static int pin_modes[32];
+    static uint32_t rtc_memory[128];       // 512 bytes of RTC user memory
+
+    void reset_heap_counts() {
+        allocations = 0;
+        allocated_bytes = 0;
+    }
+
+    void set_pin (uint8_t pin, int value) {
+        if (pin >= 32)
+            return;
+        int old = pins[pin];
+        pins[pin] = value;
+        if (old == value || pin_handlers[pin] == NULL)
+            return;
+        if (pin_modes[pin] == CHANGE || (pin_modes[pin] == RISING && value) || (pin_modes[pin] == FALLING && !value))
+            pin_handlers[pin]();
+    }
+
+    int get_pin (uint8_t pin) {
+        return (pin < 32) ? pins[pin] : 0;
+    }
+
+    void set_analog (int value) {
+        analog_value = value;
+    }
+
+    void advance_ms (unsigned long ms) {
+        skipped_us += ms * 1000UL;
+    }
+
+    void clear_files() {
+        SPIFFS.files.clear();
+    }
+}
+//------------------------------------------------------------------------------------
+
+// Every allocation of the process is counted; ESP.getFreeHeap() reports a 40 KB heap less what is in use,
+// which is roughly what the firmware has left on the device. The size is kept in a header before the block.
+static const size_t HOST_HEAP_SIZE = 40000;
+
+void* operator new (size_t size) {
+    size_t* block = (size_t*)malloc(size + sizeof(size_t) * 2);
+    if (block == NULL)
+        throw std::bad_alloc();
+    block[0] = size;
+    host::allocations++;
+    host::allocated_bytes += size;
+    host::heap_in_use += size;
+    return block + 2;
+}
+
+void operator delete (void* p) noexcept {
+    if (p == NULL)
+        return;
+    size_t* block = (size_t*)p - 2;
+    host::heap_in_use -= block[0];
+    free(block);
+}
+
+void* operator new[] (size_t size) { return operator new(size); }
+void operator delete[] (void* p) noexcept { operator delete(p); }
+void operator delete (void* p, size_t) noexcept { operator delete(p); }
+void operator delete[] (void* p, size_t) noexcept { operator delete(p); }
+//------------------------------------------------------------------------------------
+
+HardwareSerial Serial;
+EspClass ESP;
+FS SPIFFS;
+ESP8266WiFiClass WiFi;
+UpdaterClass Update;
+ESP8266HTTPUpdate ESPhttpUpdate;
+volatile uint32_t GPOS, GPOC;
+
+void String::trim() {
+    size_t first = str.find_first_not_of(" \t\r\n");
+    size_t last = str.find_last_not_of(" \t\r\n");
+    str = (first == std::string::npos) ? std::string() : str.substr(first, last - first + 1);
+}
+
+size_t Print::write (const uint8_t* buffer, size_t size) {
+    for (size_t i=0; i<size; i++)
+        write(buffer[i]);
+    return size;
+}
+
+size_t Print::print (long v, int base) {
+    char buf[24];
+    if (base == HEX)
+        snprintf(buf, sizeof(buf), "%lX", v);
+    else
+        snprintf(buf, sizeof(buf), "%ld", v);
+    return write(buf);
+}
+
+size_t Print::print (unsigned long v, int base) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), (base == HEX) ? "%lX" : "%lu", v);
+    return write(buf);
+}
+
+size_t Print::print (double v, int digits) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return write(buf);
+}
+
+size_t Print::printf (const char* format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    return write(buf);
+}
+
+size_t Stream::readBytes (uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = read();
+        if (c < 0)
+            break;
+        buffer[count++] = (uint8_t)c;
+    }
+    return count;
+}
+
+String Stream::readStringUntil (char terminator) {
+    std::string s;
+    int c;
+    while ((c = read()) >= 0 && c != terminator)
+        s += (char)c;
+    return String(s);
+}
+
+size_t HardwareSerial::write (uint8_t c) {
+    if (host::verbose)
+        fputc(c, stdout);
+    return 1;
+}
+
+size_t HardwareSerial::write (const uint8_t* buffer, size_t size) {
+    if (host::verbose)
+        fwrite(buffer, 1, size, stdout);
+    return size;
+}
+//------------------------------------------------------------------------------------
+
+static unsigned long host_us() {
+    static auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + host::skipped_us;
+}
+
+unsigned long micros() { return (unsigned long)(uint32_t)host_us(); }   // wraps like the device's
+unsigned long millis() { return (unsigned long)(uint32_t)(host_us() / 1000); }
+void delay (unsigned long ms) { host::advance_ms(ms); }
+void delayMicroseconds (unsigned int us) { host::skipped_us += us; }
+void yield() {}
+
+void pinMode (uint8_t pin, uint8_t mode) {}
+int digitalRead (uint8_t pin) { return host::get_pin(pin); }
+void digitalWrite (uint8_t pin, uint8_t value) { if (pin < 32) host::pins[pin] = value; }
+int analogRead (uint8_t pin) { return host::analog_value; }
+
+void attachInterrupt (uint8_t pin, void (*handler)(void), int mode) {
+    if (pin < 32) {
+        host::pin_handlers[pin] = handler;
+        host::pin_modes[pin] = mode;
+    }
+}
+
+void detachInterrupt (uint8_t pin) {
+    if (pin < 32)
+        host::pin_handlers[pin] = NULL;
+}
+
+long random (long max_value) { return (max_value > 0) ? (rand() % max_value) : 0; }
+long random (long min_value, long max_value) { return min_value + random(max_value - min_value); }
+void randomSeed (unsigned long seed) { srand((unsigned)seed); }
+
+char* ltoa (long value, char* buffer, int base) {
+    if (base == 16)
+        sprintf(buffer, "%lx", value);
+    else
+        sprintf(buffer, "%ld", value);
+    return buffer;
+}
+char* itoa (int value, char* buffer, int base) { return ltoa(value, buffer, base); }
+char* ultoa (unsigned long value, char* buffer, int base) { sprintf(buffer, (base == 16) ? "%lx" : "%lu", value); return buffer; }
+char* utoa (unsigned value, char* buffer, int base) { return ultoa(value, buffer, base); }
+
+uint32_t EspClass::getFreeHeap() {
+    long left = (long)HOST_HEAP_SIZE - host::heap_in_use;
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+void EspClass::restart() {
+    host::restarts++;
+}
+
+bool EspClass::rtcUserMemoryRead (uint32_t offset, uint32_t* data, size_t size) {
+    if (offset * 4 + size > sizeof(host::rtc_memory))
+        return false;
+    memcpy(data, (byte*)host::rtc_memory + offset * 4, size);
+    return true;
+}
+
+bool EspClass::rtcUserMemoryWrite (uint32_t offset, uint32_t* data, size_t size) {
+    if (offset * 4 + size > sizeof(host::rtc_memory))
+        return false;
+    memcpy((byte*)host::rtc_memory + offset * 4, data, size);
+    return true;
+}
+
+bool wifi_set_sleep_type (enum sleep_type type) { return true; }
+uint32_t system_get_rtc_time (void) { return (uint32_t)(host_us() * 1000 / 5750); }   // 5.75 us per tick
+uint32_t system_rtc_clock_cali_proc (void) { return (uint32_t)(5.75 * 4096); }          // Q12 fixed point
+//------------------------------------------------------------------------------------
+
+String IPAddress::toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", address & 0xFF, (address >> 8) & 0xFF, (address >> 16) & 0xFF, address >> 24);
+    return String(buf);
+}
+
+bool IPAddress::fromString (const char* s) {
+    unsigned a, b, c, d;
+    if (sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 || b > 255 || c > 255 || d > 255)
+        return false;
+    *this = IPAddress(a, b, c, d);
+    return true;
+}
+
+wl_status_t ESP8266WiFiClass::status() {
+    return host::wifi_up ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+uint8_t* ESP8266WiFiClass::macAddress (uint8_t* mac) {
+    const uint8_t address[6] = {0x5C, 0xCF, 0x7F, 0x00, 0x00, 0x01};
+    memcpy(mac, address, 6);
+    return mac;
+}
+//------------------------------------------------------------------------------------
+
+bool File::seek (uint32_t offset, SeekMode mode) {
+    if (!data)
+        return false;
+    size_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? pos : data->size();
+    if (base + offset > data->size())
+        return false;
+    pos = base + offset;
+    return true;
+}
+
+size_t File::write (const uint8_t* buffer, size_t size) {
+    if (!data || !writable)
+        return 0;
+    if (pos + size > data->size())
+        data->resize(pos + size);
+    memcpy(data->data() + pos, buffer, size);
+    pos += size;
+    return size;
+}
+
+int File::read() {
+    if (!data || pos >= data->size())
+        return -1;
+    return (*data)[pos++];
+}
+
+int File::peek() {
+    if (!data || pos >= data->size())
+        return -1;
+    return (*data)[pos];
+}
+
+size_t File::read (uint8_t* buffer, size_t size) {
+    if (!data)
+        return 0;
+    size_t count = std::min(size, data->size() - pos);
+    memcpy(buffer, data->data() + pos, count);
+    pos += count;
+    return count;
+}
+
+size_t Dir::fileSize() const {
+    auto it = SPIFFS.files.find(names[index]);
+    return (it == SPIFFS.files.end()) ? 0 : it->second->size();
+}
+
+File Dir::openFile (const char* mode) const {
+    return SPIFFS.open(names[index].c_str(), mode);
+}
+
+File FS::open (const char* path, const char* mode) {
+    if (!mounted)
+        return File();
+    auto it = files.find(path);
+    if (mode[0] == 'r') {
+        if (it == files.end())
+            return File();
+        return File(it->second, path, mode[1] == '+', 0);
+    }
+    if (it == files.end() || mode[0] == 'w')
+        it = files.insert(std::make_pair(std::string(path), std::make_shared<host_file_data>())).first;
+    if (mode[0] == 'w')
+        it->second->clear();
+    return File(it->second, path, true, (mode[0] == 'a') ? it->second->size() : 0);
+}
+
+bool FS::rename (const char* from, const char* to) {
+    auto it = files.find(from);
+    if (!mounted || it == files.end() || files.count(to) > 0)
+        return false;
+    files[to] = it->second;
+    files.erase(it);
+    return true;
+}
+
+bool FS::info (FSInfo& info) {
+    size_t used = 0;
+    for (auto& f : files)
+        used += f.second->size();
+    info.totalBytes = 1024 * 1024;
+    info.usedBytes = used;
+    info.blockSize = 8192;
+    info.pageSize = 256;
+    return mounted;
+}
+
+// the names under the folder, as SPIFFS lists them (full paths; SPIFFS has no real folders)
+Dir FS::openDir (const char* path) {
+    std::vector<std::string> names;
+    size_t length = strlen(path);
+    for (auto& f : files)
+        if (f.first.compare(0, length, path) == 0)
+            names.push_back(f.first);
+    return Dir(names);
+}
+//------------------------------------------------------------------------------------
+
+bool PubSubClient::connect (const char* id) {
+    up = host::mqtt_up && host::wifi_up;
+    return up;
+}
+
+bool PubSubClient::connected() {
+    if (!host::mqtt_up || !host::wifi_up)
+        up = false;
+    return up;
+}
+
+// the fixed header (up to 5 bytes), the topic with its length, and the payload must fit the packet buffer
+bool PubSubClient::publish (const char* topic, const uint8_t* payload, unsigned int length) {
+    if (!connected())
+        return false;
+    unsigned long allocations = host::allocations, allocated_bytes = host::allocated_bytes;
+    host::published p;
+    p.topic = topic;
+    p.payload.assign((const char*)payload, length);
+    p.sent = (5 + 2 + strlen(topic) + length <= MQTT_MAX_PACKET_SIZE);
+    host::publishes.push_back(p);
+    host::allocations = allocations;  // the record is kept by the host, not by the device
+    host::allocated_bytes = allocated_bytes;
+    return p.sent;
+}
+//------------------------------------------------------------------------------------
+
+int8_t Timer::every (unsigned long period, void (*callback)(void), int repeat_count) {
+    for (int8_t i=0; i<MAX_NUMBER_OF_EVENTS; i++) {
+        if (!events[i].active) {
+            events[i] = event { callback, period, millis(), repeat_count, 0, 0, true };
+            return i;
+        }
+    }
+    return NO_TIMER_AVAILABLE;
+}
+
+int8_t Timer::oscillate (uint8_t pin, unsigned long period, uint8_t starting_value, int repeat_count) {
+    int8_t i = every(period, NULL, (repeat_count < 0) ? -1 : repeat_count * 2);
+    if (i >= 0) {
+        events[i].pin = pin;
+        events[i].value = starting_value;
+        digitalWrite(pin, starting_value);
+    }
+    return i;
+}
+
+void Timer::stop (int8_t id) {
+    if (id >= 0 && id < MAX_NUMBER_OF_EVENTS)
+        events[id].active = false;
+}
+
+void Timer::update() {
+    unsigned long now = millis();
+    for (int8_t i=0; i<MAX_NUMBER_OF_EVENTS; i++) {
+        event* e = &events[i];
+        if (!e->active || now - e->last < e->period)
+            continue;
+        e->last = now;
+        if (e->callback != NULL) {
+            e->callback();
+        } else {
+            e->value = !e->value;
+            digitalWrite(e->pin, e->value);
+        }
+        if (e->repeat_count > 0 && --e->repeat_count == 0)
+            e->active = false;
+    }
+}
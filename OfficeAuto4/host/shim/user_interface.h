@@ -0,0 +1,13 @@
+// user_interface.h -- host shim (ESP8266 SDK)
+
+#ifndef HOST_USER_INTERFACE_H
+#define HOST_USER_INTERFACE_H
+
+#include <stdint.h>
+
+enum sleep_type { NONE_SLEEP_T = 0, LIGHT_SLEEP_T, MODEM_SLEEP_T };
+bool wifi_set_sleep_type(enum sleep_type type);
+uint32_t system_get_rtc_time(void);
+uint32_t system_rtc_clock_cali_proc(void);
+
+#endif
@@ -17,6 +17,10 @@
 //AWS MQTT broker address for your device
 #define  AWS_END_POINT             "zzzzzzz-ats.iot.us-east-2.amazonaws.com"
 #define  MQTT_PORT                 8883
+#define  LOCAL_BROKER              ""        // fall back MQTT broker on the LAN, eg. "192.168.0.101"; empty = none
+#define  LOCAL_BROKER_PORT         1883
+#define  LOCAL_BROKER_USER         ""        // the LAN link connects only with a user name (and password) set
+#define  LOCAL_BROKER_PASSWORD     ""
 #define  SUB_TOPIC_PREFIX          "cmd"
 #define  PUB_TOPIC_PREFIX          "status"
 
@@ -0,0 +1,62 @@
+// lightFilter.cpp
+
+#include "lightFilter.h"
+
+bool LightFilter::add (short sample) {
+    if (count > 0 && abs(sample - median()) > LDR_OUTLIER_BAND) {
+        if (++rejects_in_row < LDR_MAX_REJECTS) {
+            rejected++;
+            return false;
+        }
+    }
+    rejects_in_row = 0;
+    if (count == LDR_WINDOW) {   // evict the oldest
+        sum -= window[head];
+        remove_sorted (window[head]);
+    } else {
+        count++;
+    }
+    window[head] = sample;
+    head = (head+1) % LDR_WINDOW;
+    sum += sample;
+    insert_sorted (sample);
+    samples++;
+    return true;
+}
+
+short LightFilter::mean() {
+    if (count == 0)
+        return 0;
+    return (short)(sum/count);
+}
+
+short LightFilter::median() {
+    if (count == 0)
+        return 0;
+    if (count & 1)
+        return sorted[count/2];
+    return (short)((sorted[count/2-1] + sorted[count/2])/2);
+}
+
+bool LightFilter::is_empty() {
+    return (count == 0);
+}
+
+// called before count is decremented: the sorted part is sorted[0..count-1]
+void LightFilter::remove_sorted (short value) {
+    byte i = 0;
+    while (i < count && sorted[i] != value) 
+        i++;
+    for (; i+1 < count; i++)
+        sorted[i] = sorted[i+1];
+}
+
+// called after count is updated: the value goes into sorted[0..count-1]
+void LightFilter::insert_sorted (short value) {
+    byte i = count-1;
+    while (i > 0 && sorted[i-1] > value) {
+        sorted[i] = sorted[i-1];
+        i--;
+    }
+    sorted[i] = value;
+}
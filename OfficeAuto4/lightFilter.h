@@ -0,0 +1,40 @@
+// lightFilter.h
+// Moving window filter for the LDR. Hardware::update() feeds it one ADC sample every LDR_SAMPLE_INTERVAL,
+// so that the light level can be read at any time without delays.
+// The window is kept twice: in arrival order (to know the oldest sample) and sorted (for the median).
+// Mean is a running sum; median is the middle of the sorted copy, updated by one shifting insert per sample.
+// A sample that is more than LDR_OUTLIER_BAND away from the median is rejected as a spike; but after
+// LDR_MAX_REJECTS rejects in a row it is a real step (eg. a lamp switched on) and is accepted.
+
+#ifndef LIGHT_FILTER_H
+#define LIGHT_FILTER_H
+
+#include "common.h"
+
+#define  LDR_WINDOW           16     // samples; 4 seconds at the default rate
+#define  LDR_SAMPLE_INTERVAL  250    // mSec; analogRead() is slow on the ESP8266 and disturbs wifi if called too often
+#define  LDR_OUTLIER_BAND     150    // ADC counts
+#define  LDR_MAX_REJECTS      4
+
+class LightFilter {
+public:
+    unsigned long samples = 0;   // accepted
+    unsigned long rejected = 0;  // spikes dropped
+    
+    bool  add (short sample);  // false if it was rejected
+    short mean();
+    short median();
+    bool  is_empty();
+    
+private:
+    short window[LDR_WINDOW];  // arrival order; circular
+    short sorted[LDR_WINDOW];
+    byte  count = 0;
+    byte  head = 0;            // the next slot to write, which holds the oldest sample when the window is full
+    long  sum = 0;
+    byte  rejects_in_row = 0;
+    void  remove_sorted (short value);
+    void  insert_sorted (short value);
+};
+
+#endif
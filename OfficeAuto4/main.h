@@ -11,6 +11,12 @@
 #include "otaHelper.h"
 #include "myfiManager.h"
 #include "CommandHandler.h"
+#include "spool.h"
+#include "timeManager.h"
+#include "transport.h"
+#include "outbox.h"
+#include "metrics.h"
+#include "assembler.h"
 #include <FS.h>
 #include <ESP8266WiFi.h>
 #include <Timer.h>              // https://github.com/JChristensen/Timer
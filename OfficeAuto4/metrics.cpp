@@ -0,0 +1,29 @@
+// metrics.cpp
+
+#include "metrics.h"
+
+Metrics metrics;
+
+// called from both MQTT callbacks (callback, lan_callback), for every message of either link
+void Metrics::note_rx() {
+    rx_messages++;
+    window_rx++;
+}
+
+void Metrics::note_echo (unsigned long sent_millis) {
+    last_rtt_ms = millis() - sent_millis;
+    if (last_rtt_ms > max_rtt_ms)
+        max_rtt_ms = last_rtt_ms;
+    echoes++;
+}
+
+// the on-demand MET command reads it too; so the window is left to the periodic timer
+unsigned long Metrics::rx_per_hour() {
+    unsigned long elapsed = millis() - window_start;
+    return ((elapsed == 0) ? 0 : (unsigned long)((unsigned long long)window_rx * 3600000UL / elapsed));
+}
+
+void Metrics::start_window() {
+    window_start = millis();
+    window_rx = 0;
+}
@@ -0,0 +1,36 @@
+// metrics.h
+// Connection health of the device, for spotting flaky devices and WiFi dead zones across the fleet.
+// The counters of each link live where the events happen (AWS, Transport, the queues); this module adds the
+// inbound message rate and the broker round trip time, and CommandHandler::send_metrics() puts them all
+// into one compact {"M":{...}} message, on demand (MET) and every METRICS_MIN minutes.
+// The round trip is measured by an echo: the device publishes {"E":millis} on its own command topic, and the
+// broker delivers it back. AWS IoT drops the connection of a client that publishes outside its policy; so
+// the echo is off until the policy allows the command topic, and the ECHO parameter is set.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "common.h"
+
+class Metrics {
+public:
+    unsigned long rx_messages = 0;   // since boot
+    unsigned long rx_dropped = 0;    // too long; dropped before parsing
+    unsigned long echoes = 0;        // answered
+    unsigned long last_rtt_ms = 0;
+    unsigned long max_rtt_ms = 0;
+
+    void note_rx();
+    void note_echo (unsigned long sent_millis);
+    unsigned long rx_per_hour();     // in the current window; reading it does not reset the window
+    void start_window();             // only by the periodic report (send_metrics() in the main .ino)
+
+private:
+    unsigned long window_start = 0;
+    unsigned long window_rx = 0;
+};
+
+// like the profiler, it is fed from several classes
+extern Metrics metrics;
+
+#endif
@@ -37,7 +37,7 @@ OtaHelper::OtaHelper() {
 }
 
 #ifdef MQTT_ENABLED
-void OtaHelper::init (Config *configptr,  PubSubClient *mqttptr) {
+void OtaHelper::init (Config *configptr,  Transport *mqttptr) {
     this->pC = configptr;
     this->pM = mqttptr;    
 }
@@ -151,6 +151,14 @@ int OtaHelper::update_firmware() {
     sprintf (tmpstr, "{\"I\":\"Updating firmware...\"}"); 
     pM->publish(pC->mqtt_pub_topic, tmpstr);           
 #endif    
+#ifdef DELTA_ENABLED
+    // a delta is tried first; any failure falls back to the full image
+    if (update_from_delta() == UPDATE_OK) {
+        SERIAL_PRINTLN(F("Rebooting with the new firmware..."));
+        delay(500);
+        ESP.restart();
+    }
+#endif
     char* url; 
     if (use_backup_urls) // this is set already during version check 
         url = (char*)pC->get_secondary_OTA_url();
@@ -202,3 +210,45 @@ int OtaHelper::update_firmware() {
 #endif    
     return (return_code);
 }
+
+#ifdef DELTA_ENABLED
+// Downloads the delta from the running version and applies it. The server may not have one (e.g. the device
+// skipped a release); that is not an error, the caller then downloads the full image.
+int OtaHelper::update_from_delta() {
+    char* url; 
+    if (use_backup_urls)
+        url = (char*)pC->get_secondary_delta_url();
+    else
+        url = (char*)pC->get_primary_delta_url();
+    SERIAL_PRINT(F("Looking for FW delta file: "));
+    SERIAL_PRINTLN(url);
+    WiFiClient wifi_client;
+    HTTPClient http;
+    if (!http.begin(wifi_client, url)) {
+        SERIAL_PRINTLN(F("--- Malformed delta URL ---"));
+        return BAD_URL;
+    }
+    int response_code = http.GET();
+    SERIAL_PRINT(F("HTTP response code: "));
+    SERIAL_PRINTLN (response_code);
+    if (response_code != HTTP_CODE_OK) {
+        SERIAL_PRINTLN(F("No delta available; downloading the full image."));
+        http.end();
+        return NOT_FOUND;
+    }
+    DeltaPatcher patcher;
+    int result = patcher.apply(http.getStreamPtr());
+    http.end();
+    SERIAL_PRINT(F("Delta update result: "));
+    SERIAL_PRINTLN(pC->get_error_message(result));
+#ifdef MQTT_ENABLED
+    if (result == UPDATE_OK)
+        sprintf (tmpstr, "{\"C\":\"FW %d from delta; bytes copied: %lu, downloaded: %lu\"}", 
+                 patcher.target_version, patcher.copied, patcher.inserted); 
+    else
+        sprintf (tmpstr, "{\"C\":\"Delta update failed: %s; trying the full image\"}", pC->get_error_message(result)); 
+    pM->publish(pC->mqtt_pub_topic, tmpstr);
+#endif
+    return (result);
+}
+#endif
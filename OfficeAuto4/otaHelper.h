@@ -7,13 +7,18 @@
 
 // enable the following line to receive MQTT status during FW update; comment out to disable messages
 #define MQTT_ENABLED
+// enable the following line to try a delta (see deltaPatcher.h) before the full image; comment out to disable
+#define DELTA_ENABLED
 
 #include "common.h"
 #include "config.h"
 #include <ESP8266HTTPClient.h>
 #include <ESP8266httpUpdate.h>
 #ifdef MQTT_ENABLED
-  #include <PubSubClient.h>   // https://github.com/knolleary/pubsubclient 
+  #include "transport.h"
+#endif
+#ifdef DELTA_ENABLED
+  #include "deltaPatcher.h"
 #endif
 
 class OtaHelper {
@@ -21,16 +26,19 @@ class OtaHelper {
     OtaHelper();
     void init(Config *configptr);    
 #ifdef MQTT_ENABLED
-    void init(Config *configptr, PubSubClient *mqttptr);
+    void init(Config *configptr, Transport *mqttptr);
 #endif
     int check_and_update();
     int check_version();    
     int update_firmware();  
+#ifdef DELTA_ENABLED
+    int update_from_delta();
+#endif
  private:
      Config *pC;
      bool use_backup_urls = false; // this is a global flag used throughout this class
 #ifdef MQTT_ENABLED     
-     PubSubClient *pM;
+     Transport *pM;
 #endif     
 };
 
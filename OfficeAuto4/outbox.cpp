@@ -0,0 +1,148 @@
+// outbox.cpp
+
+#include "outbox.h"
+
+Outbox::Outbox() {
+    for (short i=0; i<OUTBOX_SLOTS; i++)
+        slots[i].used = false;
+}
+
+void Outbox::init (Config *configptr, Transport *ptransport) {
+    this->pC = configptr;
+    this->pTransport = ptransport;
+    next_seq = ESP.random() & 0x7FFF;  // not from 0 after every reboot: the cloud sees a fresh sequence
+    boot_id = ESP.random() & 0x7FFF;   // and a sequence number seen before a reboot is not a duplicate
+}
+
+// stamps the message with the next sequence number, and sends it at once if a link is up
+void Outbox::send (const char* json) {
+    outbox_entry* e = take_slot();
+    e->seq = next_seq++;
+    e->tracked = (pC->ack_events && json[0] == '{' &&
+                  snprintf(e->msg, MAX_MSG_LENGTH, "{\"K\":%u,\"Z\":%u,%s", e->seq, boot_id, json+1) < MAX_MSG_LENGTH);
+    if (!e->tracked)
+        safe_strncpy (e->msg, json, MAX_MSG_LENGTH);  // retired as soon as a link takes it
+    e->binary = false;
+    e->length = strlen(e->msg);
+    enqueue (e);
+}
+
+void Outbox::send (const byte* frame, short length) {
+    if (length > MAX_MSG_LENGTH)
+        return;
+    outbox_entry* e = take_slot();
+    memcpy (e->msg, frame, length);
+    e->binary = true;
+    e->length = length;
+    e->tracked = false;
+    enqueue (e);
+}
+
+// a free slot, or else the oldest event
+outbox_entry* Outbox::take_slot() {
+    outbox_entry* e = NULL;
+    for (short i=0; i<OUTBOX_SLOTS; i++) {
+        if (!slots[i].used) {
+            e = &slots[i];
+            break;
+        }
+        if (e == NULL || slots[i].order < e->order)
+            e = &slots[i];  // the oldest, if there is no free slot
+    }
+    if (e->used) {
+        dropped++;
+        SERIAL_PRINT(F("[Outbox] Full; dropped: "));
+        if (e->binary)
+            SERIAL_PRINTLN(F("a frame"));
+        else
+            SERIAL_PRINTLN(e->msg);
+    }
+    return e;
+}
+
+void Outbox::enqueue (outbox_entry* e) {
+    e->used = true;
+    e->published = false;
+    e->attempts = 0;
+    e->order = next_order++;
+    e->due_ms = millis();
+    if (depth() > high_water)
+        high_water = depth();
+    transmit (e);
+}
+
+void Outbox::ack (unsigned short seq) {
+    for (short i=0; i<OUTBOX_SLOTS; i++) {
+        outbox_entry* e = &slots[i];
+        if (e->used && e->published && e->seq == seq) {
+            unsigned long latency = millis() - e->first_ms;
+            latency_total_ms += latency;
+            if (latency > latency_max_ms)
+                latency_max_ms = latency;
+            acked++;
+            e->used = false;
+            return;
+        }
+    }
+    SERIAL_PRINT(F("[Outbox] Stale acknowledgement: "));  // a retransmission answered twice
+    SERIAL_PRINTLN(seq);
+}
+
+// the oldest message that is due; one per call, so that a reconnect does not send a burst in one pass
+void Outbox::update() {
+    outbox_entry* oldest = NULL;
+    unsigned long now = millis();
+    for (short i=0; i<OUTBOX_SLOTS; i++) {
+        outbox_entry* e = &slots[i];
+        if (!e->used || (long)(now - e->due_ms) < 0)
+            continue;
+        if (e->published && !pC->ack_events) {  // ACK was switched off while it waited
+            e->used = false;
+            continue;
+        }
+        if (oldest == NULL || e->order < oldest->order)
+            oldest = e;
+    }
+    if (oldest != NULL)
+        transmit (oldest);
+}
+
+void Outbox::transmit (outbox_entry* e) {
+    if (!pTransport->connected())
+        return;  // stays due; sent as soon as a link is up
+    prof.note_publish(e->length);
+    bool sent = e->binary ? pTransport->publish(pC->mqtt_pub_topic, (const byte*)e->msg, e->length)
+                          : pTransport->publish(pC->mqtt_pub_topic, e->msg);
+    if (!sent) {
+        e->due_ms = millis() + OUTBOX_RETRY_MIN;
+        return;
+    }
+    if (e->published) {
+        retransmits++;
+        SERIAL_PRINT(F("[Outbox] Retransmitted: "));
+        SERIAL_PRINTLN(e->msg);
+    } else {
+        e->published = true;
+        e->first_ms = millis();
+    }
+    if (!e->tracked || !pC->ack_events) {  // nothing will acknowledge it
+        e->used = false;
+        return;
+    }
+    unsigned long wait = OUTBOX_RETRY_MIN;
+    for (byte i=0; i<e->attempts && wait < OUTBOX_RETRY_MAX; i++)
+        wait *= 2;
+    if (wait > OUTBOX_RETRY_MAX)
+        wait = OUTBOX_RETRY_MAX;
+    if (e->attempts < 255)
+        e->attempts++;
+    e->due_ms = millis() + wait;
+}
+
+short Outbox::depth() {
+    short count = 0;
+    for (short i=0; i<OUTBOX_SLOTS; i++)
+        if (slots[i].used)
+            count++;
+    return count;
+}
@@ -0,0 +1,67 @@
+// outbox.h
+// Events that must reach the cloud (relay status, boot) are held here until they are delivered.
+// PubSubClient publishes only at QoS 0, and a publish on a half dead socket "succeeds" without reaching the
+// broker; so the delivery is confirmed at the application level: with the ACK parameter set, every json event
+// goes out with a sequence number and the boot id, {"K":12,"Z":3407,"S":"01"}, and stays in the outbox until
+// the cloud answers on the command topic with {"K":12} (see lambda_function7.py). Until then it is sent again,
+// with an exponential back off; the cloud stores a retransmission only once, by (device, K, Z).
+// Without ACK, and for a binary frame (it has no room for the sequence number), an event is held only until
+// a link takes it: it still survives a boot or an outage without connectivity, but not a dead socket.
+// The outbox is small; when it is full, the oldest event is dropped to make room.
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include "common.h"
+#include "config.h"
+#include "profiler.h"
+#include "transport.h"
+
+#define  OUTBOX_SLOTS         4
+#define  OUTBOX_RETRY_MIN     5000     // mSec; the wait for an acknowledgement doubles from here...
+#define  OUTBOX_RETRY_MAX     60000    // ...upto 1 minute
+
+struct outbox_entry {
+    bool  used;
+    bool  tracked;           // carries a sequence number; retired by the acknowledgement
+    bool  published;         // handed over to a link at least once
+    bool  binary;            // a frame (see frames.h), not json
+    byte  attempts;
+    short length;
+    unsigned short seq;
+    unsigned long order;     // insertion count; the smallest is the oldest
+    unsigned long first_ms;  // millis() of the first publish
+    unsigned long due_ms;    // millis() of the next (re)transmission
+    char  msg[MAX_MSG_LENGTH];  // json, or the bytes of a frame
+};
+
+class Outbox {
+public:
+    short high_water = 0;
+    unsigned long acked = 0;
+    unsigned long retransmits = 0;
+    unsigned long dropped = 0;           // pushed out by newer events
+    unsigned long latency_total_ms = 0;  // first publish to acknowledgement
+    unsigned long latency_max_ms = 0;
+
+    Outbox();
+    void init (Config *configptr, Transport *ptransport);
+    void send (const char* json);     // a json object; it is copied
+    void send (const byte* frame, short length);  // a binary frame; it is copied, and is never tracked
+    void ack (unsigned short seq);    // from the MQTT callback; it only frees the slot
+    void update();                    // call it in every loop; at most one message per call
+    short depth();
+
+private:
+    Config *pC;
+    Transport *pTransport;
+    outbox_entry slots[OUTBOX_SLOTS];
+    unsigned short next_seq;
+    unsigned short boot_id;
+    unsigned long next_order = 0;
+    outbox_entry* take_slot();
+    void enqueue (outbox_entry* e);
+    void transmit (outbox_entry* e);
+};
+
+#endif
@@ -16,9 +16,10 @@
 // comment out if you do not have a light sensor:
 #define LDR_PRESENT
 
-// TODO: introduce NUM_RELAYS here      
-#define RELAY1   5       // D1
-#define RELAY2   4       // D2
+// one pin per relay, relay 0 first; the count must match NUM_RELAYS in settings.h
+#define RELAY_PINS  {5, 4}            // D1, D2
+// 4 channel board: #define RELAY_PINS  {5, 4, 15, 16}   // D1, D2, D8, D0
+// an 8 channel board needs pins freed from the sensors (eg. PIR, radar, DHT, LEDs)
 #define PIR      12      // D6
 #define RADAR    14      // D5
 #define DHT_PIN  13      // D7
@@ -0,0 +1,90 @@
+// profiler.cpp
+
+#include "profiler.h"
+
+Profiler prof;
+
+Profiler::Profiler() {
+    for (byte i=0; i<NUM_BOOT_PHASES; i++)
+        boot_ms[i] = 0;
+    reset();
+}
+
+// starts a fresh measurement window
+void Profiler::reset() {
+    dispatch.count = 0;
+    dispatch.total_us = 0;
+    dispatch.max_us = 0;
+    max_publish_length = 0;
+    publish_count = 0;
+    min_free_heap = 0x7FFFFFFF;
+    max_heap_loss = 0;
+    parse.count = 0;
+    parse.total_us = 0;
+    parse.max_us = 0;
+    rejected_messages = 0;
+    reset_loop();
+}
+
+void Profiler::reset_loop() {
+    loop_gap.count = 0;
+    loop_gap.total_us = 0;
+    loop_gap.max_us = 0;
+    last_loop_us = 0;
+}
+
+void Profiler::begin_command() {
+    start_heap = ESP.getFreeHeap();
+    start_us = micros();
+}
+
+void Profiler::end_command() {
+    unsigned long duration = micros() - start_us;  // unsigned arithmetic survives the micros() roll over
+    add_sample (&dispatch, duration);
+    long heap = ESP.getFreeHeap();
+    if (heap < min_free_heap)
+        min_free_heap = heap;
+    if (start_heap - heap > max_heap_loss)
+        max_heap_loss = start_heap - heap;
+}
+
+void Profiler::note_publish (int length) {
+    publish_count++;
+    if (length > max_publish_length)
+        max_publish_length = length;
+}
+
+void Profiler::begin_parse() {
+    parse_start_us = micros();
+}
+
+void Profiler::end_parse() {
+    add_sample (&parse, micros() - parse_start_us);
+}
+
+// only the first boot is timed; a later repair of the connection does not overwrite it
+void Profiler::mark_boot (byte phase) {
+    if (phase < NUM_BOOT_PHASES && boot_ms[BOOT_DONE] == 0)
+        boot_ms[phase] = millis();
+}
+
+// called at the top of loop()
+void Profiler::note_loop() {
+    unsigned long now = micros();
+    if (last_loop_us != 0)
+        add_sample (&loop_gap, now - last_loop_us);
+    last_loop_us = now;
+}
+
+unsigned long Profiler::average_us (const probe *p) {
+    if (p->count == 0)
+        return 0;
+    return (p->total_us / p->count);
+}
+
+void Profiler::add_sample (probe *p, unsigned long duration_us) {
+    p->count++;
+    p->total_us += duration_us;
+    if (duration_us > p->max_us)
+        p->max_us = duration_us;
+}
@@ -0,0 +1,64 @@
+// profiler.h
+// Light weight, on-device instrumentation of the command path.
+// The measurements are taken on the ESP itself and published on demand with the PRF command
+// (see TEST COMMANDS.txt); host/bench.cpp measures the same command path on a PC
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "common.h"
+
+// the phases of the first boot, in order
+enum boot_phase {
+    BOOT_HARDWARE = 0,
+    BOOT_CONFIG,      // config file, spool
+    BOOT_WIFI,
+    BOOT_TIME,        // time server
+    BOOT_CERTS,       // file system and TLS credentials
+    BOOT_MQTT,        // first connection to the broker
+    BOOT_DONE,        // end of setup()
+    NUM_BOOT_PHASES
+};
+
+struct probe {
+    unsigned long count;     // number of samples in this window
+    unsigned long total_us;  // sum of durations, in microseconds
+    unsigned long max_us;    // worst case duration
+};
+
+class Profiler {
+public:
+    probe dispatch;           // time taken by CommandHandler::handle_command()
+    int   max_publish_length; // longest Tx message in this window (compare with MAX_MSG_LENGTH)
+    long  publish_count;
+    long  min_free_heap;      // lowest free heap seen after any command
+    long  max_heap_loss;      // largest drop in free heap across a single command (allocations not released)
+    probe parse;              // time taken by deserializeJson() in the MQTT callback
+    unsigned long rejected_messages;  // Rx messages longer than MAX_MSG_LENGTH, dropped unparsed
+    probe loop_gap;           // time between two passes of the main loop; the max shows any blocking code
+    unsigned long boot_ms[NUM_BOOT_PHASES];  // millis() at the end of each boot phase; 0 = not reached. Not reset.
+
+    Profiler();
+    void reset();
+    void begin_command();
+    void end_command();
+    void note_publish (int length);
+    void begin_parse();
+    void end_parse();
+    void note_loop();
+    void reset_loop();
+    void mark_boot (byte phase);
+    unsigned long average_us (const probe *p);
+
+private:
+    unsigned long start_us;
+    unsigned long parse_start_us;  // the callback can run inside a command (client.loop() while publishing)
+    unsigned long last_loop_us;    // 0 = no pass yet in this window
+    long start_heap;
+    void add_sample (probe *p, unsigned long duration_us);
+};
+
+// the command path is spread over the MQTT callback, the queue and the handler; they all report here
+extern Profiler prof;
+
+#endif
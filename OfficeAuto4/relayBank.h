@@ -0,0 +1,92 @@
+// relayBank.h
+// A bank of N relays, sized at compile time (Hardware uses RelayBank<NUM_RELAYS>).
+// The state is one bit per relay (bit 0 = relay 0), so a whole bank is switched by a single set_mask(),
+// and the status string is rendered straight from the mask. The status string has relay 0 as its last
+// character ("10" = relay 1 on), as the cloud side expects.
+// On the ESP8266, set_mask() drives all the relays on GPIO 0-15 with one write to the set and clear
+// registers; so the relays of the bank switch together, not one after the other.
+
+#ifndef RELAY_BANK_H
+#define RELAY_BANK_H
+
+#include "common.h"
+
+template <byte N>
+class RelayBank {
+    static_assert (N >= 1 && N <= MAX_RELAYS, "NUM_RELAYS must be 1 to MAX_RELAYS");
+    
+public:
+    RelayBank (const byte (&relay_pins)[N]) {
+        for (byte i=0; i<N; i++)
+            pins[i] = relay_pins[i];
+        status_str[N] = '\0';
+    }
+    
+    static byte size() { 
+        return N; 
+    }
+    
+    // active_low points to the Config flag, so that the polarity follows ACTIVE_LOW when it is changed later.
+    // The pins are driven to OFF.
+    void init (const bool* active_low_flag) {
+        active_low = active_low_flag;
+        for (byte i=0; i<N; i++)
+            pinMode(pins[i], OUTPUT);
+        set_mask(0);
+    }
+    
+    void set (byte relay, bool on) {
+        if (relay >= N)
+            return;
+        byte new_mask = on ? (mask | (1 << relay)) : (mask & ~(1 << relay));
+        set_mask(new_mask);
+    }
+    
+    // bulk operation: every relay of the bank goes to the state of its bit
+    void set_mask (byte new_mask) {
+        mask = new_mask & ALL;
+        bool inverted = (active_low != NULL && *active_low);
+#ifdef ESP8266
+        uint32_t set_bits = 0, clear_bits = 0;
+        for (byte i=0; i<N; i++) {
+            bool level = (((mask >> i) & 1) != inverted);
+            if (pins[i] < 16)
+                (level ? set_bits : clear_bits) |= (1UL << pins[i]);
+            else
+                digitalWrite(pins[i], level);  // GPIO 16 is not on the shared registers
+        }
+        GPOS = set_bits;
+        GPOC = clear_bits;
+#else
+        for (byte i=0; i<N; i++)
+            digitalWrite(pins[i], (((mask >> i) & 1) != inverted));
+#endif
+    }
+    
+    void clear_all() {
+        set_mask(0);
+    }
+    
+    bool is_on (byte relay) {
+        return (relay < N) && (mask & (1 << relay));
+    }
+    
+    byte get_mask() {
+        return mask;
+    }
+    
+    const char* status() {
+        for (byte i=0; i<N; i++)
+            status_str[N-1-i] = (mask & (1 << i)) ? '1' : '0';
+        return status_str;
+    }
+    
+private:
+    static const byte ALL = (byte)((1U << N) - 1);
+    byte pins[N];
+    byte mask = 0;
+    const bool* active_low = NULL;  // NULL = active high
+    char status_str[N+1];
+};
+
+#endif
@@ -0,0 +1,22 @@
+// rtcStore.h
+// Small records kept in the RTC user memory (512 bytes, addressed in 4 byte blocks). They survive a soft
+// reset, a watchdog reset and deep sleep, but not a power cycle. Each record is stored with a CRC; a record
+// that was never written, or was left by another firmware layout, fails the check and reads as absent.
+// Every user of the RTC memory gets a fixed slot here, so that the records do not overlap.
+
+#ifndef RTC_STORE_H
+#define RTC_STORE_H
+
+#include "common.h"
+
+// slot offsets, in 4 byte blocks; each slot is 1 block of CRC plus the record, rounded up to whole blocks
+#define  RTC_SLOT_TLS      0    // TLS session (AWS.cpp); upto 32 blocks
+#define  RTC_SLOT_TIME     32   // wall clock (timeManager.cpp); 5 blocks
+#define  RTC_SLOT_WIFI     40   // last access point (myfiManager.cpp); 3 blocks
+#define  RTC_USER_BLOCKS   128  
+
+bool rtc_load (short slot, void* record, short size);   // false if there is no valid record
+bool rtc_save (short slot, const void* record, short size);
+void rtc_clear (short slot);
+
+#endif
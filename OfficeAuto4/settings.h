@@ -17,8 +17,17 @@
 #define  BLINK_COUNT            6            // device identifier (IFF) blinking
 #define  PRIMARY_RELAY          0            // the main light for automatic control is 0,1,2... NUM_RELAYS
 #define  RADAR_TRIGGERS         0            // if 0, PIR alone can trigger occupied status; if 1, both PIR and radar have to trigger
-
-#define  STATUS_FREQUENCEY      5            // in minutes
+#define  BINARY_FRAMES          0            // 1: status and data are published as compact binary frames (see frames.h)
+#define  METRICS_MINUTES        15           // connection health report {"M":{...}}; 0 = only on demand (MET)
+#define  RTT_ECHO               0            // 1: measure the broker round trip with an echo on the command topic (see metrics.h)
+#define  ACK_EVENTS             0            // 1: relay status and boot events are sent again until the cloud acknowledges them (see outbox.h)
+
+#define  STATUS_FREQUENCEY      5            // in minutes; day/night check
+#define  HEARTBEAT_MINUTES      30           // data is sent at least this often, even if nothing changed
+#define  TEMPERATURE_DEADBAND   0.5          // deg C; a larger change is reported at once
+#define  HUMIDITY_DEADBAND      3.0          // percent
+#define  LIGHT_DEADBAND         50           // ADC counts (0-1023)
+#define  HIT_DEADBAND           5            // PIR/radar hits per minute; starting or stopping motion is always reported
 #define  UNIVERSAL_GROUP_ID     "0"          // TODO: use this to listen for pan-group messages
 #define  UNIVERSAL_DEVICE_ID    "0"          // all devices in a group listen on this channel
 
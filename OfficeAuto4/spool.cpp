@@ -0,0 +1,175 @@
+// spool.cpp
+
+#include "spool.h"
+#include "frames.h"
+
+Spool::Spool() {
+}
+
+// finds the oldest and the newest segments left over from the previous sessions
+bool Spool::init() {
+    if (!mount_file_system()) {
+        SERIAL_PRINTLN(F("--- Spool: failed to mount file system. ---"));
+        return false;
+    }
+    session = (byte)(ESP.random() & SPOOL_SESSION_MASK);
+    has_segments = false;
+    Dir dir = SPIFFS.openDir(SPOOL_DIR);
+    while (dir.next()) {
+        unsigned long number = atol(dir.fileName().c_str() + strlen(SPOOL_DIR));
+        if (!has_segments || number < first_segment)
+            first_segment = number;
+        if (!has_segments || number >= last_segment) {
+            last_segment = number;
+            last_segment_samples = dir.fileSize() / sizeof(spool_sample);
+        }
+        has_segments = true;
+    }
+    read_offset = 0;
+    if (has_segments)
+        load_position();
+    SERIAL_PRINT(F("Spooled samples: "));
+    SERIAL_PRINTLN(size());
+    return true;
+}
+
+const char* Spool::segment_name (unsigned long number) {
+    snprintf (name_buffer, MAX_TINY_STRING_LENGTH, "%s%05lu", SPOOL_DIR, number);
+    return ((const char*)name_buffer);
+}
+
+bool Spool::is_empty() {
+    return (size() == 0);
+}
+
+long Spool::size() {
+    if (!has_segments)
+        return 0;
+    return ((last_segment-first_segment)*SPOOL_SEGMENT_SAMPLES + last_segment_samples - read_offset/sizeof(spool_sample));
+}
+
+// one small write per sample, always at the end of the newest segment
+bool Spool::append (const data* dat, unsigned long epoch) {
+    spool_sample s;
+    if (epoch > 0) {
+        s.stamp = epoch;
+        s.flags = 0;
+    } else {
+        s.stamp = millis()/1000;
+        s.flags = SPOOL_RELATIVE_TIME | session;
+    }
+    s.relays = relay_mask(dat->relay_status);
+    s.temperature = to_tenths(dat->temperature);
+    s.humidity = to_tenths(dat->humidity);
+    s.hindex = to_tenths(dat->hindex);
+    s.light = dat->light;
+    s.pir_hits = dat->pir_hits;
+    s.radar_hits = dat->radar_hits;
+    
+    if (!has_segments) {
+        first_segment = last_segment;  // the number of a deleted segment can be reused
+        last_segment_samples = 0;
+        read_offset = 0;
+        has_segments = true;
+    }
+    else if (last_segment_samples >= SPOOL_SEGMENT_SAMPLES) {
+        last_segment++;
+        last_segment_samples = 0;
+        if (last_segment - first_segment >= SPOOL_MAX_SEGMENTS) {
+            SERIAL_PRINTLN(F("--- Spool full; dropping the oldest samples ---"));
+            dropped += (SPOOL_SEGMENT_SAMPLES - read_offset/sizeof(spool_sample));
+            remove_first_segment();
+        }
+    }
+    File f = SPIFFS.open(segment_name(last_segment), "a");
+    if (!f) {
+        SERIAL_PRINTLN(F("--- Spool: could not open segment ---"));
+        return false;
+    }
+    bool result = (f.write((const uint8_t*)&s, sizeof(s)) == sizeof(s));
+    f.close();
+    if (result) {
+        last_segment_samples++;
+        appended++;
+    }
+    return result;
+}
+
+// Reads up to max_samples from the oldest segment, without removing them; call consume() once they are sent.
+// Relative stamps of this session are turned into UTC; those of an earlier session cannot be, and are set to 0.
+short Spool::read (spool_sample* batch, short max_samples, unsigned long epoch) {
+    if (is_empty())
+        return 0;
+    File f = SPIFFS.open(segment_name(first_segment), "r");
+    if (!f) {
+        SERIAL_PRINTLN(F("--- Spool: could not open segment ---"));
+        remove_first_segment();  // do not get stuck on it
+        return 0;
+    }
+    f.seek(read_offset, SeekSet);
+    short count = 0;
+    while (count < max_samples && f.read((uint8_t*)&batch[count], sizeof(spool_sample)) == sizeof(spool_sample)) {
+        spool_sample* s = &batch[count++];
+        if (s->flags & SPOOL_RELATIVE_TIME) {
+            if ((s->flags & SPOOL_SESSION_MASK) == session && epoch > 0)
+                s->stamp = epoch - (millis()/1000 - s->stamp);
+            else
+                s->stamp = 0;  // time unknown
+            s->flags = 0;
+        }
+    }
+    f.close();
+    if (count == 0)  // a truncated segment
+        remove_first_segment();
+    return count;
+}
+
+void Spool::consume (short count) {
+    if (count <= 0 || !has_segments)
+        return;
+    sent += count;
+    read_offset += count*sizeof(spool_sample);
+    short samples = (first_segment == last_segment) ? last_segment_samples : SPOOL_SEGMENT_SAMPLES;
+    if (read_offset >= samples*sizeof(spool_sample))
+        remove_first_segment();
+    else
+        save_position();
+}
+
+void Spool::remove_first_segment() {
+    SPIFFS.remove(segment_name(first_segment));
+    SPIFFS.remove(SPOOL_POSITION_FILE);  // the segment number may be reused; its position must not be
+    read_offset = 0;
+    if (first_segment == last_segment) {
+        has_segments = false;
+        last_segment_samples = 0;
+    }
+    else
+        first_segment++;
+}
+
+// the position is only of the segment being drained; a record of any other segment is stale
+void Spool::save_position() {
+    unsigned long position[2] = { first_segment, read_offset };
+    File f = SPIFFS.open(SPOOL_POSITION_FILE, "w");
+    if (!f) {
+        SERIAL_PRINTLN(F("--- Spool: could not save the read position ---"));
+        return;
+    }
+    f.write((const uint8_t*)position, sizeof(position));
+    f.close();
+}
+
+void Spool::load_position() {
+    unsigned long position[2];
+    File f = SPIFFS.open(SPOOL_POSITION_FILE, "r");
+    if (!f)
+        return;
+    bool ok = (f.read((uint8_t*)position, sizeof(position)) == sizeof(position));
+    f.close();
+    short samples = (first_segment == last_segment) ? last_segment_samples : SPOOL_SEGMENT_SAMPLES;
+    if (!ok || position[0] != first_segment || position[1] % sizeof(spool_sample) != 0 
+        || position[1] >= samples*sizeof(spool_sample))
+        return;
+    read_offset = position[1];
+}
@@ -0,0 +1,65 @@
+// spool.h
+// Flash backed store of the sensor data that could not be sent while the cloud connection was broken.
+// The samples are appended to small segment files (/spool/00000, /spool/00001 ...). A segment is never rewritten:
+// it is only appended to, and deleted as a whole once it is sent (or when the spool is full, the oldest one
+// is dropped). This keeps the flash wear to the minimum SPIFFS can do.
+// After the connection is restored, the main loop drains the spool a few samples at a time (see drain_spool())
+// The read position in a partly sent segment is kept in a small file, rewritten after every batch; so after a
+// reboot, the samples already sent are not sent again.
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include "common.h"
+#include "utilities.h"
+#include <FS.h>
+
+#define  SPOOL_DIR               "/spool/"
+#define  SPOOL_POSITION_FILE     "/spool.pos"   // segment number and read offset; outside SPOOL_DIR (see init())
+#define  SPOOL_SEGMENT_SAMPLES   64      // samples per segment file
+#define  SPOOL_MAX_SEGMENTS      16      // 1024 samples: about 17 hours at one sample a minute
+#define  SPOOL_BATCH_SAMPLES     5       // at most this many samples in one message
+#define  SPOOL_DRAIN_INTERVAL    2000    // mSec between two batch messages, while draining
+
+#define  SPOOL_RELATIVE_TIME     0x80    // flag: the stamp is seconds since boot; the time server was not available
+#define  SPOOL_SESSION_MASK      0x7F    // with SPOOL_RELATIVE_TIME: identifies the boot session that wrote it
+
+struct spool_sample {
+    unsigned long  stamp;     // UTC epoch seconds; or seconds since boot, with SPOOL_RELATIVE_TIME
+    byte           flags;
+    byte           relays;    // bit mask, bit 0 = relay 0
+    short          temperature, humidity, hindex;  // x10; FRAME_NO_VALUE if the sensor failed
+    unsigned short light, pir_hits, radar_hits;
+};
+
+class Spool {
+public:
+    // counters
+    unsigned long appended = 0;
+    unsigned long sent = 0;
+    unsigned long dropped = 0;   // overwritten when full, or relative stamps from a previous boot session
+    
+    Spool();
+    bool  init();   // the file system must be mounted
+    bool  append (const data* dat, unsigned long epoch);   // epoch=0 if the time is unknown
+    short read (spool_sample* batch, short max_samples, unsigned long epoch);  // oldest first; stamps made absolute
+    void  consume (short count);  // discards the samples returned by the last read()
+    bool  is_empty();
+    long  size();   // number of samples waiting
+
+private:
+    bool has_segments = false;
+    unsigned long first_segment = 0;  // the oldest, being drained
+    unsigned long last_segment = 0;   // the newest, being appended to
+    unsigned long read_offset = 0;    // in the first segment, in bytes
+    short last_segment_samples = 0;
+    byte session = 0;
+
+    const char* segment_name (unsigned long number);
+    void  remove_first_segment();
+    void  save_position();
+    void  load_position();
+    char  name_buffer[MAX_TINY_STRING_LENGTH];
+};
+
+#endif
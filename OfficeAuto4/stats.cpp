@@ -0,0 +1,56 @@
+// stats.cpp
+
+#include "stats.h"
+
+void stats_reset (sensor_stats* s) {
+    s->count = 0;
+    s->min = 0;
+    s->max = 0;
+    s->last = 0;
+    s->mean = 0;
+    s->m2 = 0;
+}
+
+// the products stay within 32 bits for 11 bit values (light: 0-1024, temperature and humidity in tenths)
+void stats_add (sensor_stats* s, short value) {
+    if (s->count == 0xFFFF)  // saturated; keep the statistics of what has been seen
+        return;
+    if (s->count == 0 || value < s->min)
+        s->min = value;
+    if (s->count == 0 || value > s->max)
+        s->max = value;
+    s->last = value;
+    s->count++;
+    long x = (long)value << STATS_FRACTION_BITS;
+    long delta = x - s->mean;
+    long n = s->count;
+    s->mean += (delta >= 0) ? (delta + n/2) / n : (delta - n/2) / n;  // rounded, or the truncation drifts
+    long product = delta * (x - s->mean);  // never negative, except by the rounding above
+    if (product > 0)
+        s->m2 += (unsigned long)product >> STATS_FRACTION_BITS;
+}
+
+// rounded to the nearest integer
+short stats_mean (const sensor_stats* s) {
+    const long half = 1L << (STATS_FRACTION_BITS-1);
+    if (s->mean >= 0)
+        return (short)((s->mean + half) >> STATS_FRACTION_BITS);
+    return (short)(-((-s->mean + half) >> STATS_FRACTION_BITS));
+}
+
+// sample standard deviation; 0 for less than two samples
+short stats_stddev (const sensor_stats* s) {
+    if (s->count < 2)
+        return 0;
+    float variance = (float)s->m2 / (s->count - 1) / (1 << STATS_FRACTION_BITS);
+    return (short)(sqrt(variance) + 0.5f);
+}
+
+void stats_summarize (const sensor_stats* s, stats_summary* summary) {
+    summary->count = s->count;
+    summary->min = s->min;
+    summary->max = s->max;
+    summary->mean = stats_mean(s);
+    summary->stddev = stats_stddev(s);
+    summary->last = s->last;
+}
@@ -0,0 +1,40 @@
+// stats.h
+// Running statistics of a sensor over one report window, by Welford's incremental method: one pass,
+// no sample buffer, and no loss of precision from subtracting large sums.
+// Values are fixed point integers: tenths for temperature and humidity, ADC counts for light.
+// The mean and the sum of squared deviations carry STATS_FRACTION_BITS extra bits of precision.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "common.h"
+
+#define  STATS_FRACTION_BITS  4
+
+// the accumulator
+struct sensor_stats {
+    unsigned short count;
+    short  min;
+    short  max;
+    short  last;
+    long   mean;         // x 2^STATS_FRACTION_BITS
+    unsigned long m2;    // sum of squared deviations from the mean, x 2^STATS_FRACTION_BITS
+};
+
+// what is sent, at the end of a window
+struct stats_summary {
+    unsigned short count;
+    short  min;
+    short  max;
+    short  mean;
+    short  stddev;
+    short  last;
+};
+
+void  stats_reset (sensor_stats* s);
+void  stats_add (sensor_stats* s, short value);
+short stats_mean (const sensor_stats* s);
+short stats_stddev (const sensor_stats* s);
+void  stats_summarize (const sensor_stats* s, stats_summary* summary);
+
+#endif
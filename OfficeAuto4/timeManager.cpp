@@ -0,0 +1,213 @@
+// timeManager.cpp
+
+#include "timeManager.h"
+
+#define  NTP_UNIX_OFFSET  2208988800UL   // seconds from 1900 (NTP era 0) to 1970
+
+// carried over a soft reset, in RTC memory
+struct time_record {
+    uint32_t epoch;        // UTC seconds...
+    uint32_t epoch_ms;     // ...and mSec, at the time of saving
+    uint32_t rtc_cycles;   // system_get_rtc_time() at the time of saving
+    int32_t  drift_ppm;
+};
+
+TimeManager::TimeManager() {
+}
+
+void TimeManager::init (Config *configptr) {
+    this->pC = configptr;
+    restore();
+}
+
+bool TimeManager::is_valid() {
+    return (source != TIME_NONE);
+}
+
+byte TimeManager::get_source() {
+    return source;
+}
+
+long TimeManager::get_drift_ppm() {
+    return drift_ppm;
+}
+
+// the local clock at millis() = now: whole seconds in *epoch, and the mSec part as the return value
+unsigned long TimeManager::local_epoch_ms (unsigned long now, unsigned long* epoch) {
+    unsigned long elapsed = now - base_millis;
+    long long corrected = (long long)elapsed + (long long)elapsed * drift_ppm / 1000000;
+    *epoch = base_epoch + (unsigned long)(corrected / 1000);
+    return (unsigned long)(corrected % 1000);
+}
+
+unsigned long TimeManager::get_epoch() {
+    if (!is_valid())
+        return 0;
+    unsigned long epoch;
+    local_epoch_ms(millis(), &epoch);
+    return epoch;
+}
+
+short TimeManager::get_hour() {
+    if (!is_valid())
+        return -1;
+    return ((get_epoch() + UTC_OFFSET_SECONDS) % 86400L) / 3600;
+}
+
+short TimeManager::get_minute() {
+    if (!is_valid())
+        return -1;
+    return ((get_epoch() + UTC_OFFSET_SECONDS) % 3600) / 60;
+}
+
+// The output is ternary: day,night,unknown
+// this is called every few minutes and switches the primary light on schedule
+short TimeManager::is_night_time() {  
+    short current_hour = get_hour();
+    short current_minute = get_minute();
+    if (current_hour < 0 || current_minute < 0) {   
+      SERIAL_PRINTLN(F("Time is not known yet"));
+      return TIME_UNKNOWN;
+    }
+    if (current_hour > pC->night_start_hour  || current_hour < pC->night_end_hour) 
+        return TIME_NIGHT;
+    if (current_hour == pC->night_start_hour && current_minute >= pC->night_start_minute)  
+        return TIME_NIGHT;        
+    if (current_hour == pC->night_end_hour && current_minute <= pC->night_end_minute)  
+        return TIME_NIGHT;
+    return TIME_DAY;
+}
+
+void TimeManager::update() {
+    unsigned long now = millis();
+    if (is_valid() && now - last_save_millis >= TIME_SAVE_INTERVAL) {
+        save();
+        last_save_millis = now;
+    }
+    if (WiFi.status() != WL_CONNECTED) 
+        return;
+    if (waiting) {
+        receive_reply();
+        if (waiting && millis() - request_millis >= NTP_TIMEOUT) {
+            SERIAL_PRINTLN(F("--- Time server did not answer ---"));
+            waiting = false;
+            failures++;
+            udp.stop();
+            if (++timeouts >= NTP_RESOLVE_AFTER) {  // the pool server may have gone away; ask DNS for another
+                resolved = false;
+                timeouts = 0;
+            }
+            schedule(retry_interval);
+            retry_interval = min(2*retry_interval, (unsigned long)NTP_RETRY_MAX);
+        }
+        return;
+    }
+    if ((long)(now - next_request_millis) >= 0)
+        send_request();
+}
+
+void TimeManager::schedule (unsigned long interval) {
+    next_request_millis = millis() + interval;
+}
+
+void TimeManager::send_request() {
+    if (!resolved) {  // DNS is the only lookup that can take a while; it is done once, and again after repeated timeouts
+        if (!WiFi.hostByName(NTP_SERVER, server_ip)) {
+            SERIAL_PRINTLN(F("--- Could not resolve the time server ---"));
+            failures++;
+            schedule(retry_interval);
+            retry_interval = min(2*retry_interval, (unsigned long)NTP_RETRY_MAX);
+            return;
+        }
+        resolved = true;
+    }
+    byte packet[NTP_PACKET_SIZE];
+    memset(packet, 0, NTP_PACKET_SIZE);
+    packet[0] = 0b11100011;  // leap indicator unknown, version 4, client mode
+    udp.begin(NTP_LOCAL_PORT);
+    udp.beginPacket(server_ip, NTP_PORT);
+    udp.write(packet, NTP_PACKET_SIZE);
+    udp.endPacket();
+    request_millis = millis();
+    waiting = true;
+}
+
+void TimeManager::receive_reply() {
+    if (udp.parsePacket() < NTP_PACKET_SIZE)
+        return;
+    unsigned long arrival = millis();
+    byte packet[NTP_PACKET_SIZE];
+    udp.read(packet, NTP_PACKET_SIZE);
+    udp.stop();
+    waiting = false;
+    timeouts = 0;
+    // transmit time stamp: seconds and binary fraction since 1900, big endian
+    unsigned long seconds = ((unsigned long)packet[40] << 24) | ((unsigned long)packet[41] << 16) | 
+                            ((unsigned long)packet[42] << 8) | packet[43];
+    unsigned long fraction = ((unsigned long)packet[44] << 24) | ((unsigned long)packet[45] << 16) | 
+                             ((unsigned long)packet[46] << 8) | packet[47];
+    if (seconds < NTP_UNIX_OFFSET + MIN_VALID_EPOCH) {  // eg. a kiss-of-death packet has all zeros
+        SERIAL_PRINTLN(F("--- Invalid time from the time server ---"));
+        failures++;
+        schedule(retry_interval);
+        return;
+    }
+    unsigned long fraction_ms = (unsigned long)(((unsigned long long)fraction * 1000) >> 32);
+    set_time(seconds - NTP_UNIX_OFFSET, fraction_ms, request_millis + (arrival - request_millis)/2);
+    syncs++;
+    retry_interval = NTP_RETRY_MIN;
+    schedule(NTP_SYNC_INTERVAL);
+}
+
+// the server said (epoch, fraction_ms) at the local millis() = at_millis
+void TimeManager::set_time (unsigned long epoch, unsigned long fraction_ms, unsigned long at_millis) {
+    if (source == TIME_NTP && at_millis - last_sync_millis >= MIN_DRIFT_INTERVAL) {
+        // how far the local clock got off since the last sync, as a fraction of the interval
+        unsigned long local_epoch;
+        unsigned long local_ms = local_epoch_ms(at_millis, &local_epoch);
+        long long error_ms = ((long long)epoch - (long long)local_epoch) * 1000 + (long)fraction_ms - (long)local_ms;
+        long long interval = at_millis - last_sync_millis;
+        long sample = (long)(error_ms * 1000000 / interval) + drift_ppm;
+        if (sample > MAX_DRIFT_PPM) sample = MAX_DRIFT_PPM;   // a late reply, not a drift
+        if (sample < -MAX_DRIFT_PPM) sample = -MAX_DRIFT_PPM;
+        drift_ppm = (3*drift_ppm + sample) / 4;  // smoothed
+    }
+    if (source != TIME_NTP || at_millis - last_sync_millis >= MIN_DRIFT_INTERVAL)
+        last_sync_millis = at_millis;
+    base_epoch = epoch;
+    base_millis = at_millis - fraction_ms;
+    if (source != TIME_NTP) 
+        SERIAL_PRINTLN(F("Time server answered; the clock is set."));
+    source = TIME_NTP;
+    save();
+    last_save_millis = millis();
+}
+
+void TimeManager::save() {
+    time_record r;
+    unsigned long epoch;
+    r.epoch_ms = local_epoch_ms(millis(), &epoch);
+    r.epoch = epoch;
+    r.rtc_cycles = system_get_rtc_time();
+    r.drift_ppm = drift_ppm;
+    rtc_save(RTC_SLOT_TIME, &r, sizeof(r));
+}
+
+// the RTC counter runs through a soft reset; its period (in uSec, Q12 fixed point) comes from calibration
+void TimeManager::restore() {
+    time_record r;
+    if (!rtc_load(RTC_SLOT_TIME, &r, sizeof(r)))
+        return;
+    uint32_t cycles = system_get_rtc_time() - r.rtc_cycles;
+    unsigned long long gap_us = ((unsigned long long)cycles * system_rtc_clock_cali_proc()) >> 12;
+    if (gap_us / 1000000 > MAX_CARRY_OVER || r.epoch < MIN_VALID_EPOCH) {
+        SERIAL_PRINTLN(F("Time in RTC memory is too old; waiting for the time server."));
+        return;
+    }
+    unsigned long long ms = (unsigned long long)r.epoch_ms + gap_us / 1000;  // the gap includes this boot so far
+    base_epoch = r.epoch + (unsigned long)(ms / 1000);
+    base_millis = millis() - (unsigned long)(ms % 1000);
+    drift_ppm = r.drift_ppm;
+    source = TIME_CARRIED;
+    SERIAL_PRINTLN(F("Time restored from RTC memory."));
+}
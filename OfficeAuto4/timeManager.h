@@ -0,0 +1,83 @@
+// timeManager.h
+// Wall clock for the device, kept locally and corrected by the time server in the background.
+// update() is called on every pass of the loop and never waits: it sends an NTP request, and picks up 
+// the answer on a later pass. Between the answers, the time runs on millis(), corrected by a drift estimate.
+// The clock is saved to RTC memory every minute, together with the RTC counter; after a soft reset the
+// time is valid at once (the counter keeps running through the reset), and NTP only refines it.
+// So the boot does not wait for the time server, and day/night keeps working while NTP is unreachable.
+
+#ifndef TIME_MANAGER_H
+#define TIME_MANAGER_H
+
+#include "common.h"
+#include "config.h"
+#include "rtcStore.h"
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>         // built in: /esp8266/Arduino/blob/master/libraries/ESP8266WiFi/
+
+#define  UTC_OFFSET_SECONDS  (55*360)     // 5.5 hours * 3600 seconds
+#define  MIN_VALID_EPOCH     1577836800   // 2020-01-01; anything earlier means the time server never answered
+
+#define  NTP_SERVER            "pool.ntp.org"
+#define  NTP_PORT              123
+#define  NTP_LOCAL_PORT        2390
+#define  NTP_PACKET_SIZE       48
+#define  NTP_TIMEOUT           2000      // mSec; an unanswered request is given up after this
+#define  NTP_RESOLVE_AFTER     3         // consecutive timeouts; then the server name is looked up again (pool addresses change)
+#define  NTP_SYNC_INTERVAL     3600000   // mSec; while the clock is good
+#define  NTP_RETRY_MIN         4000      // mSec; the wait after a failure doubles from here...
+#define  NTP_RETRY_MAX         600000    // ...upto 10 minutes
+#define  TIME_SAVE_INTERVAL    60000     // mSec; to RTC memory
+#define  MAX_CARRY_OVER        600       // seconds; a longer gap across a reset means the RTC counter was reset too
+#define  MAX_DRIFT_PPM         2000      
+#define  MIN_DRIFT_INTERVAL    600000    // mSec; shorter sync intervals are too coarse to estimate the drift
+
+enum time_source {
+    TIME_NONE = 0,
+    TIME_CARRIED,    // restored from RTC memory after a reset; not yet confirmed by NTP
+    TIME_NTP
+};
+
+class TimeManager {
+public:
+    unsigned long syncs = 0;         // NTP answers since boot
+    unsigned long failures = 0;      // NTP requests that timed out
+    
+    TimeManager();
+    void init (Config *configptr);   // restores the clock from RTC memory, if possible
+    void update();                   // call in every loop; returns at once
+    bool is_valid();
+    byte get_source();
+    unsigned long get_epoch();       // UTC seconds since 1970, or 0 if the time is not known
+    short get_hour();                // local time; -1 if the time is not known
+    short get_minute();
+    short is_night_time();           // ternary: day,night,unknown
+    long  get_drift_ppm();
+    
+private:
+    Config *pC;
+    WiFiUDP udp;
+    IPAddress server_ip;
+    bool  resolved = false;
+    byte  timeouts = 0;              // consecutive unanswered requests to server_ip
+    byte  source = TIME_NONE;
+    unsigned long base_epoch = 0;    // UTC seconds at base_millis
+    unsigned long base_millis = 0;
+    long  drift_ppm = 0;             // millis() runs slow by this much (negative: fast)
+    unsigned long last_sync_millis = 0;
+    bool  waiting = false;           // a request is out
+    unsigned long request_millis = 0;
+    unsigned long next_request_millis = 0;
+    unsigned long retry_interval = NTP_RETRY_MIN;
+    unsigned long last_save_millis = 0;
+    
+    unsigned long local_epoch_ms (unsigned long now, unsigned long* epoch);  // returns the mSec part
+    void send_request();
+    void receive_reply();
+    void set_time (unsigned long epoch, unsigned long fraction_ms, unsigned long at_millis);
+    void schedule (unsigned long interval);
+    void save();
+    void restore();
+};
+
+#endif
@@ -0,0 +1,206 @@
+// transport.cpp
+
+#include "transport.h"
+#include "profiler.h"
+#include "frames.h"
+#include "metrics.h"
+
+// like the AWS client, the LAN client lives outside the class (see aws.cpp)
+WiFiClient lanClient;
+PubSubClient lan_client(lanClient);
+
+void Transport::init (Config *configptr, AWS *paws) {
+    this->pC = configptr;
+    this->pAws = paws;
+    lanClient.setTimeout(LOCAL_CONNECT_TIMEOUT);
+    lan_client.setCallback(lan_callback);
+}
+
+// the relay and status commands: ONx, OFx, STA, MOD, DAT, AUT, MAN. Reads exactly 3 characters
+static bool lan_command_allowed (const char* c) {
+    if (c[0]=='O' && (c[1]=='N' || c[1]=='F'))
+        return (c[2] >= '0' && c[2] <= '9');
+    return (strncmp(c, "STA", 3)==0 || strncmp(c, "MOD", 3)==0 || strncmp(c, "DAT", 3)==0 ||
+            strncmp(c, "AUT", 3)==0 || strncmp(c, "MAN", 3)==0);
+}
+
+static bool lan_json_command_allowed (JsonVariant item) {
+    const char* c = item.as<const char*>();
+    return (c != NULL && strlen(c) == 3 && lan_command_allowed(c));
+}
+
+// MQTT callback of the LAN link: the same guards as callback() (aws.cpp), but only a command frame or a
+// {"C":...} message made up entirely of lan_command_allowed() commands gets through
+void lan_callback (char* topic, byte* payload, unsigned int length) {
+    metrics.note_rx();
+    if (length > MAX_MSG_LENGTH) {
+        prof.rejected_messages++;
+        metrics.rx_dropped++;
+        SERIAL_PRINTLN(F("--- Message too long; rejected ---"));
+        return;
+    }
+    bool allowed = false;
+    if (is_binary_frame(payload, length)) {  // see frames.h
+        unsigned int body_length = length - FRAME_HEADER_LENGTH;
+        if (payload[1] == FRAME_COMMAND && body_length > 0 && body_length % 3 == 0) {
+            allowed = true;
+            for (unsigned int i=FRAME_HEADER_LENGTH; i<length; i+=3)
+                if (!lan_command_allowed((const char*)payload + i))
+                    allowed = false;
+        }
+        if (allowed)
+            handle_frame(payload, length);
+    } else {
+        StaticJsonDocument<JSON_PARSE_DOC_SIZE> doc;
+        DeserializationError error = deserializeJson(doc, (char *)payload, length);  // zero copy, as in callback()
+        if (error) {
+            SERIAL_PRINT(F("Json deserialization failed: "));
+            SERIAL_PRINTLN(error.c_str());
+            return;
+        }
+        if (doc.as<JsonObject>().size() == 1 && doc.containsKey("C")) {
+            if (doc["C"].is<JsonArray>()) {
+                allowed = (doc["C"].as<JsonArray>().size() > 0);
+                for (JsonVariant item : doc["C"].as<JsonArray>())
+                    if (!lan_json_command_allowed(item))
+                        allowed = false;
+            } else {
+                allowed = lan_json_command_allowed(doc["C"]);
+            }
+        }
+        if (allowed)
+            dispatch_message(doc);
+    }
+    if (!allowed) {
+        prof.rejected_messages++;
+        SERIAL_PRINTLN(F("--- Not allowed on the LAN link; rejected ---"));
+    }
+}
+
+// Watches the AWS link for a fail over, and keeps the LAN link up: a step of the same kind as AWS::update()
+void Transport::update() {
+    bool aws_up = cloud_connected();
+    if (aws_was_up && !aws_up && local_connected()) {
+        failovers++;
+        SERIAL_PRINTLN(F("[Transport] AWS link lost; the LAN broker carries the traffic."));
+    }
+    aws_was_up = aws_up;
+    if (pC->local_broker[0] == '\0' || pC->local_user[0] == '\0')  // never an anonymous LAN link
+        return;
+    if (lan_client.connected()) {
+        lan_client.loop();
+        return;
+    }
+    if (local_up) {
+        SERIAL_PRINTLN(F("[Transport] LAN broker link lost."));
+        local_up = false;
+        connection_attempts = 0;
+        schedule_retry();
+        return;
+    }
+    if (millis() - backoff_start < backoff_ms)
+        return;
+    if (!try_connect())
+        schedule_retry();
+}
+
+bool Transport::try_connect() {
+    char client_id[MAX_CLIENT_ID_LENGTH];
+    snprintf (client_id, MAX_CLIENT_ID_LENGTH-1, "%s_%s", pC->mqtt_client_prefix, pC->mac_address);
+    SERIAL_PRINT(F("[Transport] Connecting to the LAN broker: "));
+    SERIAL_PRINTLN(pC->local_broker);
+    lan_client.setServer(pC->local_broker, pC->local_port);  // may have changed by SET
+    if (!lan_client.connect(client_id, pC->local_user, pC->local_password)) {
+        SERIAL_PRINT(F("[Transport] LAN broker connection failed, rc="));
+        SERIAL_PRINTLN(lan_client.state());
+        local_failures++;
+        connection_attempts++;
+        return false;
+    }
+    char  priming_msg[MAX_SHORT_STRING_LENGTH];
+    snprintf (priming_msg, MAX_SHORT_STRING_LENGTH-1, "{\"B\":\"%s [%s] V 2.%d on LAN\"}", 
+              pC->app_name, pC->mac_address, pC->current_firmware_version);
+    lan_client.publish(pC->mqtt_pub_topic, priming_msg);
+    lan_client.subscribe(pC->mqtt_sub_topic);
+    lan_client.subscribe(pC->mqtt_broadcast_topic);
+    SERIAL_PRINTLN(F("[Transport] Connected to the LAN broker."));
+    local_connections++;
+    connection_attempts = 0;
+    local_up = true;
+    return true;
+}
+
+// exponential back off with random jitter, as in AWS::schedule_retry()
+void Transport::schedule_retry() {
+    unsigned long ceiling = LOCAL_RETRY_MIN;
+    for (int i=0; i<connection_attempts && ceiling < LOCAL_RETRY_MAX; i++)
+        ceiling *= 2;
+    if (ceiling > LOCAL_RETRY_MAX)
+        ceiling = LOCAL_RETRY_MAX;
+    backoff_ms = ceiling/2 + ESP.random() % (ceiling/2 + 1);
+    backoff_start = millis();
+}
+
+// on the route of get_route() alone; returns true if that link took the message
+bool Transport::publish (const char* topic, const char* payload) {
+    bool sent = false;
+    switch (get_route()) {
+        case ROUTE_AWS:
+            sent = pAws->getPubSubClient()->publish(topic, payload);
+            break;
+        case ROUTE_LOCAL:
+            sent = lan_client.publish(topic, payload);
+            break;
+        default:
+            return false;
+    }
+    if (!sent)
+        publish_failures++;
+    return sent;
+}
+
+bool Transport::publish (const char* topic, const byte* payload, unsigned int length) {
+    bool sent = false;
+    switch (get_route()) {
+        case ROUTE_AWS:
+            sent = pAws->getPubSubClient()->publish(topic, payload, length);
+            break;
+        case ROUTE_LOCAL:
+            sent = lan_client.publish(topic, payload, length);
+            break;
+        default:
+            return false;
+    }
+    if (!sent)
+        publish_failures++;
+    return sent;
+}
+
+bool Transport::connected() {
+    return (cloud_connected() || local_connected());
+}
+
+bool Transport::cloud_connected() {
+    return (pAws != NULL && pAws->getPubSubClient()->connected());
+}
+
+bool Transport::local_connected() {
+    return (local_up && lan_client.connected());
+}
+
+// publishes the current millis() on the device's own command topic; the callback hands it to metrics.note_echo()
+bool Transport::send_echo() {
+    if (!pC->rtt_echo || !cloud_connected())
+        return false;
+    char msg[MAX_TINY_STRING_LENGTH];
+    snprintf (msg, MAX_TINY_STRING_LENGTH-1, "{\"E\":%lu}", millis());
+    return pAws->getPubSubClient()->publish(pC->mqtt_sub_topic, msg);
+}
+
+byte Transport::get_route() {
+    if (cloud_connected())
+        return ROUTE_AWS;
+    if (local_connected())
+        return ROUTE_LOCAL;
+    return ROUTE_NONE;
+}
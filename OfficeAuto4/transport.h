@@ -0,0 +1,64 @@
+// transport.h
+// The MQTT traffic goes over two links: the primary AWS session (TLS; see aws.h), and a session with a broker
+// on the LAN (eg. mosquitto on the gateway). Both links are kept up, and both subscribe to the command topics.
+// A message goes out on one link only (get_route()): on AWS while it is up, and on the LAN broker only during
+// a fail over; so the LAN dashboards see no duplicates, and the cloud telemetry does not leak onto the LAN.
+// When AWS returns, it simply carries the traffic again (fail back).
+// The LAN broker is not trusted like AWS: the device logs in with LOCAL_USER/LOCAL_PASS, and lan_callback()
+// takes only the relay and status commands; a GET, SET, config push, part frame or any other command is dropped.
+// The outage spool (spool.h) follows the AWS link alone: the samples meant for the cloud database are held back
+// until AWS returns, even while the LAN broker carries the live readings.
+// The LAN link is off while LOCAL_BROKER or LOCAL_USER (keys.h; LBRK, LUSER in config.txt) is empty.
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "common.h"
+#include "config.h"
+#include "aws.h"
+#include <PubSubClient.h>       // https://github.com/knolleary/pubsubclient 
+#include <ESP8266WiFi.h>
+
+#define  LOCAL_CONNECT_TIMEOUT   1000    // mSec; a broker on the LAN answers at once, or not at all
+#define  LOCAL_RETRY_MIN         2000    // mSec; the wait after a failure doubles from here...
+#define  LOCAL_RETRY_MAX         60000   // ...upto 1 minute
+
+// where a message goes, in order of preference
+void lan_callback (char* topic, byte* payload, unsigned int length);   // the restricted counterpart of callback()
+
+enum route {
+    ROUTE_NONE = 0,
+    ROUTE_AWS,
+    ROUTE_LOCAL
+};
+
+class Transport {
+public:
+    unsigned long local_connections = 0;  // since boot
+    unsigned long local_failures = 0;
+    unsigned long failovers = 0;          // AWS went down while the LAN link was up
+    unsigned long publish_failures = 0;   // the routed link did not take a message
+
+    void init (Config *configptr, AWS *paws);
+    void update();    // the LAN link; call it in every loop while WiFi is up. At most one attempt, bounded by LOCAL_CONNECT_TIMEOUT
+    bool publish (const char* topic, const char* payload);
+    bool publish (const char* topic, const byte* payload, unsigned int length);
+    bool connected();        // at least one link
+    bool cloud_connected();  // the AWS link
+    bool local_connected();  // the LAN link
+    byte get_route();        // the preferred link that is up now
+    bool send_echo();        // round trip probe over the AWS link; see metrics.h
+
+private:
+    Config *pC;
+    AWS *pAws;
+    bool local_up = false;
+    bool aws_was_up = false;
+    int  connection_attempts = 0;   // failures in a row
+    unsigned long backoff_start = 0;
+    unsigned long backoff_ms = 0;
+    bool try_connect();
+    void schedule_retry();
+};
+
+#endif
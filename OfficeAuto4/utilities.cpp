@@ -1,6 +1,7 @@
 // utilities.cpp
 
 #include "common.h"
+#include <FS.h>
 //////#include "utilities.h"
 
 // http://www.cplusplus.com/reference/cstring/strncpy/ 
@@ -18,7 +19,7 @@
 bool safe_strncpy (char *dest, const char *src, int length=MAX_LONG_STRING_LENGTH) 
 {
     bool truncated = false;
-    if (strlen(src) > (length-1)) {
+    if ((int)strlen(src) > (length-1)) {
         SERIAL_PRINTLN(F("***** String length is too long to copy !! TRUNCATING.... ******"));
         truncated = true;
     }
@@ -50,7 +51,7 @@ bool safe_strncpy_remove_slash (char *dest, const char *src, int length=MAX_LONG
 bool safe_strncpy_add_slash (char *dest, const char *src, int length=MAX_LONG_STRING_LENGTH) 
 {
     bool truncated = false;
-    if (strlen(src) > (length-2)) { // leave one for slash, one for null 
+    if ((int)strlen(src) > (length-2)) { // leave one for slash, one for null 
         SERIAL_PRINTLN(F("***** String length is too long to copy !! TRUNCATING.... ******"));
         truncated = true;
     }
@@ -96,3 +97,12 @@ void print_heap() {
     SERIAL_PRINT(F("Free Heap: ")); 
     SERIAL_PRINTLN(ESP.getFreeHeap()); //Low heap can cause problems  
 }
+
+// Mounts the file system on the first call; the later calls return at once. It is never unmounted:
+// the spool appends to it at any time, and every mount costs a scan of the flash.
+bool mount_file_system() {
+    static bool mounted = false;
+    if (!mounted)
+        mounted = SPIFFS.begin();
+    return mounted;
+}
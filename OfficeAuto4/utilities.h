@@ -9,5 +9,6 @@ extern bool safe_strncat (char *dest, const char *src, int length=MAX_LONG_STRIN
 extern bool safe_strncpy_remove_slash (char *dest, const char *src, int length=MAX_LONG_STRING_LENGTH); 
 extern bool safe_strncpy_add_slash (char *dest, const char *src, int length=MAX_LONG_STRING_LENGTH); 
 extern bool print_heap(); 
+extern bool mount_file_system();
 
 #endif
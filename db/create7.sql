@@ -0,0 +1,25 @@
+-- window statistics of each report (the {"W":...} messages that follow every {"D":...} message)
+-- N: number of valid readings in the window; Std: sample standard deviation
+-- the statistics are stored into the IotData row of the same device and window number (see lambda_function6.py)
+
+ALTER TABLE IotData 
+  ADD COLUMN WindowNo smallint(5) unsigned DEFAULT NULL,
+  ADD COLUMN TempN smallint(4) DEFAULT NULL,
+  ADD COLUMN TempMin float DEFAULT NULL,
+  ADD COLUMN TempMax float DEFAULT NULL,
+  ADD COLUMN TempMean float DEFAULT NULL,
+  ADD COLUMN TempStd float DEFAULT NULL,
+  ADD COLUMN HumiN smallint(4) DEFAULT NULL,
+  ADD COLUMN HumiMin float DEFAULT NULL,
+  ADD COLUMN HumiMax float DEFAULT NULL,
+  ADD COLUMN HumiMean float DEFAULT NULL,
+  ADD COLUMN HumiStd float DEFAULT NULL,
+  ADD COLUMN LightN smallint(4) DEFAULT NULL,
+  ADD COLUMN LightMin smallint(4) DEFAULT NULL,
+  ADD COLUMN LightMax smallint(4) DEFAULT NULL,
+  ADD COLUMN LightMean smallint(4) DEFAULT NULL,
+  ADD COLUMN LightStd smallint(4) DEFAULT NULL,
+  ADD INDEX DeviceWindow (DeviceId, WindowNo);
+  
+select SlNo, DeviceId, Temperature, TempN, TempMin, TempMax, TempStd, Light, LightMin, LightMax, LightStd, Timestamp 
+from IotData order by SlNo desc limit 20;
@@ -0,0 +1,11 @@
+-- acknowledged events (see OfficeAuto4/outbox.h): the sequence number K and the boot id Z of each event
+-- a retransmitted event has the same (DeviceId, Seq, BootId), and 'insert ignore' drops it (see lambda_function7.py)
+-- events without a sequence number keep Seq NULL, and the unique key does not apply to them
+
+ALTER TABLE IotEvent 
+  ADD COLUMN Seq smallint(5) unsigned DEFAULT NULL,
+  ADD COLUMN BootId smallint(5) unsigned DEFAULT NULL,
+  ADD UNIQUE KEY DeviceSeqBoot (DeviceId, Seq, BootId);
+  
+select SlNo, DeviceId, Relays, EventCode, Seq, BootId, Timestamp 
+from IotEvent order by SlNo desc limit 20;
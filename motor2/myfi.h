@@ -7,6 +7,18 @@
 #include "config.h"
 #include <ESP8266WiFi.h>
 #include <ESP8266WiFiMulti.h>
+#include "rtcStore.h"
+
+#define  FAST_CONNECT_TIMEOUT   3000   // mSec; a direct association and DHCP normally take well under a second
+
+// The last good association, kept in RTC memory: it survives a soft reset and deep sleep, but not a
+// power cycle. Only the access point is kept, not the IP lease: the address always comes from DHCP, so
+// that it is renewed as the lease requires. (The RTC counter wraps every few hours, and cannot age a lease.)
+struct wifi_record {
+    byte     bssid[6];
+    byte     channel;
+    byte     ap;         // 1,2,3: which of the configured SSIDs
+};
 
 class MyFi {
 public:
@@ -23,6 +35,8 @@ private:
     Config *pC;
     ESP8266WiFiMulti wifi_multi_client;
     bool wifi_connected;
+    bool fast_connect();
+    void save_association();
 };
 
 #endif 
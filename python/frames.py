@@ -0,0 +1,113 @@
+# Encoder/decoder for the binary frames of OfficeAuto4 (see OfficeAuto4/frames.h for the layout)
+# Decoded frames are returned in the same shape as the json messages, so the lambdas handle both alike:
+#   status frame -> {"S":"01"}     data frame -> {"D":{"S":"01","T":..,"H":..,"I":..,"L":..,"P":..,"R":..,"N":window}}
+#   history frame (spooled during an outage) -> {"Y":[[stamp,"01",T,H,I,L,P,R], ...]}; stamp is UTC, 0 if unknown
+#   window statistics frame -> {"W":{"N":window,"T":[n,min,max,mean,stddev,last],"H":[...],"L":[...]}}  T,H in tenths
+# Binary payloads reach a lambda only through a rule that base64 encodes them:
+#   SELECT encode(*, 'base64') AS bin, topic() AS topic FROM 'myorg/+/status/#'
+# Package this file along with the lambda function.
+
+import struct
+import base64
+
+FRAME_MAGIC = 0xB1
+FRAME_NO_VALUE = -32768
+
+def is_frame (payload):
+    return len(payload) >= 2 and payload[0] == FRAME_MAGIC
+
+def relay_string (mask, num_relays):
+    # the same order as Hardware::getStatus(): the last character is relay 0; the frames carry the relay count
+    return ''.join('1' if mask & (1 << i) else '0' for i in reversed(range(num_relays)))
+
+def tenths (value):
+    return None if value == FRAME_NO_VALUE else value/10.0
+
+def decode (payload):
+    if not is_frame(payload):
+        raise ValueError('not a binary frame')
+    kind = chr(payload[1])
+    if kind == 's':
+        return {'S': relay_string(payload[3], payload[2])}
+    if kind == 'd':
+        num, rel, tem, hum, hin, lig, pir, rad, win = struct.unpack('<BBhhhHHHH', payload[2:18])
+        return {'D': {'S': relay_string(rel, num), 'T': tenths(tem), 'H': tenths(hum), 'I': tenths(hin),
+                      'L': lig, 'P': pir, 'R': rad, 'N': win}}
+    if kind == 'h':
+        samples = []
+        num = payload[2]
+        for offset in range(3, len(payload)-16, 17):
+            stamp, rel, tem, hum, hin, lig, pir, rad = struct.unpack('<IBhhhHHH', payload[offset:offset+17])
+            samples.append([stamp, relay_string(rel, num), tenths(tem), tenths(hum), tenths(hin), lig, pir, rad])
+        return {'Y': samples}
+    if kind == 'w':
+        stats = {'N': struct.unpack('<H', payload[2:4])[0]}
+        for (index, key) in enumerate(('T', 'H', 'L')):
+            stats[key] = list(struct.unpack('<Hhhhhh', payload[4+12*index:16+12*index]))
+        return {'W': stats}
+    raise ValueError('unknown frame type: ' + kind)
+
+def from_event (event):
+    # unpacks a lambda event produced by the base64 rule above; json events are returned as they are
+    if 'bin' not in event:
+        return event
+    decoded = decode(base64.b64decode(event['bin']))
+    decoded['topic'] = event.get('topic', '')
+    return decoded
+
+# cloud -> device frames; publish the bytes as they are on the device's cmd topic
+def encode_commands (*commands):
+    # one command, or a batch: encode_commands('ON0', 'ON1', 'STA')
+    body = ''.join(commands).encode()
+    if len(body) == 0 or len(body) != 3*len(commands):
+        raise ValueError('commands are 3 characters each')
+    return bytes([FRAME_MAGIC, ord('C')]) + body
+
+def encode_get (param):
+    return bytes([FRAME_MAGIC, ord('G')]) + param.encode() + b'\0'
+
+def encode_set (param, value):
+    return bytes([FRAME_MAGIC, ord('S')]) + param.encode() + b'\0' + str(value).encode() + b'\0'
+
+MAX_MSG_LENGTH = 96   # common.h
+MQTT_MAX_PACKET_SIZE = 128   # PubSubClient; the whole packet, with the header and the topic
+MQTT_PACKET_OVERHEAD = 7
+PART_HEADER_LENGTH = 5
+ASSEMBLY_ARENA_SIZE = 2048   # assembler.h
+
+def max_part_data (topic):
+    # MAX_PART_DATA in assembler.h: PubSubClient silently drops a part that does not fit its packet with the topic
+    room = MQTT_MAX_PACKET_SIZE - MQTT_PACKET_OVERHEAD - len(topic.encode())
+    return min(room, MAX_MSG_LENGTH) - PART_HEADER_LENGTH
+
+def encode_parts (message, msg_id, topic, part_data=None):
+    # a long json message (a config push {"P":{...}}, a long batch) as a list of part frames, to be published
+    # in order on topic, the device's cmd topic; msg_id is 0..255, and should change from one message to the next.
+    # part_data defaults to the largest part that fits the packet on that topic
+    body = message.encode() if isinstance(message, str) else message
+    if len(body) == 0 or len(body) >= ASSEMBLY_ARENA_SIZE:
+        raise ValueError('message length must be 1..{}'.format(ASSEMBLY_ARENA_SIZE-1))
+    limit = max_part_data(topic)
+    if part_data is None:
+        part_data = limit
+    if part_data < 1 or part_data > limit:
+        raise ValueError('part data must be 1..{} bytes on this topic'.format(limit))
+    chunks = [body[i:i+part_data] for i in range(0, len(body), part_data)]
+    return [bytes([FRAME_MAGIC, ord('P'), msg_id & 0xFF, index, len(chunks)]) + chunk
+            for (index, chunk) in enumerate(chunks)]
+    
+# unit test
+if (__name__ == '__main__'):
+    data = bytes([FRAME_MAGIC, ord('d'), 2, 0b01]) + struct.pack('<hhhHHHH', 254, 613, FRAME_NO_VALUE, 512, 3, 7, 41)
+    print (len(data), decode(data))
+    print (from_event({'bin': base64.b64encode(bytes([FRAME_MAGIC, ord('s'), 4, 2])).decode(), 'topic': 'a/b/status/G0/dev'}))
+    print (encode_commands('ON0', 'ON1', 'STA'), encode_set('BIN', 1))
+    history = bytes([FRAME_MAGIC, ord('h'), 2]) + struct.pack('<IBhhhHHH', 1600000000, 1, 254, 613, 300, 512, 1, 0)*2
+    print (decode(history))
+    topic = 'intof/portico/cmd/G1/2CF432173BC0'
+    parts = encode_parts('{"P":{"HEARTBEAT_MIN":30,"TEMP_DB":0.5,"LIGHT_DB":40,"HIT_DB":2,"NIGHT_HRS":[18,30,6,0],"RADAR_TRIG":1}}', 7, topic)
+    print (len(parts), [len(p) for p in parts], [MQTT_PACKET_OVERHEAD + len(topic) + len(p) for p in parts],
+           b''.join(p[PART_HEADER_LENGTH:] for p in parts))
+    window = bytes([FRAME_MAGIC, ord('w')]) + struct.pack('<H', 41) + struct.pack('<Hhhhhh', 30, 241, 262, 250, 5, 255) \
+             + struct.pack('<Hhhhhh', 30, 600, 640, 615, 12, 630) + struct.pack('<Hhhhhh', 29, 100, 900, 400, 150, 820)
+    print (decode(window))
@@ -1,11 +1,13 @@
 # MySQL database access
 # Takes values from incoming MQTT trigger and inserts them into the DB
 # Trigger (new) :  SELECT *, topic() as topic FROM 'myorg/+/status/#'
+# Binary frames : SELECT encode(*, 'base64') AS bin, topic() AS topic FROM 'myorg/+/status/#'  (see frames.py)
 
 import sys
 #import logging
 import pymysql
 import json
+import frames
 
 rds_host = 'my.xxxxxxx.us-east-2.rds.amazonaws.com' 
 user_name = 'user'
@@ -16,8 +18,22 @@ port = 3306
 # Note how a long string can be split across multiple lines using brackets
 # Note how the double quotes can be retained all the way upto the SQL statement
 SQL = ('insert into IotData '
-       '(OrgId, GroupId, DeviceId, Relays, Temperature, Humidity, HIndex, Light, Pir, Radar) '
-       'values ({org},"{gro}","{dev}","{rel}",{tem:.1f},{hum:.1f},{hin:.1f},{lig},{pir},{rad})')
+       '(OrgId, GroupId, DeviceId, Relays, Temperature, Humidity, HIndex, Light, Pir, Radar, WindowNo) '
+       'values ({org},"{gro}","{dev}","{rel}",{tem:.1f},{hum:.1f},{hin:.1f},{lig},{pir},{rad},{win})')
+
+# samples spooled during an outage carry their own time (UTC epoch seconds; the RDS session time zone is UTC)
+SQL_HISTORY = ('insert into IotData '
+       '(OrgId, GroupId, DeviceId, Relays, Temperature, Humidity, HIndex, Light, Pir, Radar, Timestamp) '
+       'values ({org},"{gro}","{dev}","{rel}",{tem:.1f},{hum:.1f},{hin:.1f},{lig},{pir},{rad},FROM_UNIXTIME({stamp}))')
+
+# {"W":...} follows every {"D":...} from the same device; it completes the row that the data message created.
+# The row is found by the window number that both messages carry, not as the latest row of the device: the
+# messages can be handled out of order, or another data message (eg. a DAT reply) can come in between.
+# The number starts at random on every boot; the time bound keeps the rows of much older sessions out.
+SQL_STATS = ('update IotData set {cols} '
+       'where DeviceId="{dev}" and GroupId="{gro}" and WindowNo={win} '
+       'and Timestamp > now() - interval 1 hour order by SlNo desc limit 1')
+STATS_COLUMNS = {'T': 'Temp', 'H': 'Humi', 'L': 'Light'}
 
 # place holder data object
 data = {
@@ -30,7 +46,8 @@ data = {
     "HIN" : 0.0,
     "LIG" : 0,
     "PIR" : 0,
-    "RAD" : 0
+    "RAD" : 0,
+    "WIN" : "NULL"
 }
 
 # NOTE: better to put the connection handling at the top of the lambda file, so you can refer to it
@@ -50,9 +67,17 @@ def lambda_handler(event, context):
         return ("DB connection failure")
     try:
         print(json.dumps(event))
+        event = frames.from_event(event)  # binary frames are decoded into the json shape
+        if ('Y' in event):
+            return (insert_history(event))
+        if ('W' in event):
+            return (update_stats(event))
         if ('D' not in event):  # todo: process 'S', B' and 'I' packets also
             print("-- Non-data packet")
             return ("Non-data packet")
+        if (None in (event['D']['T'], event['D']['H'], event['D']['I'])):
+            print("-- Sensor failure")    # binary frames carry no NaN; failed readings decode to None
+            return ("Sensor failure")
         topic_fragments = event['topic'].split('/')
         data['DEV'] = topic_fragments[-1] # device id
         data['GRO'] = topic_fragments[-2] # group
@@ -63,6 +88,7 @@ def lambda_handler(event, context):
         data['LIG'] = event['D']['L']  # light
         data['PIR'] = event['D']['R']  # PIR hit count
         data['RAD'] = event['D']['M']  # radar hit count
+        data['WIN'] = event['D'].get('N', 'NULL')  # report window number
         with conn.cursor() as cur:
             #cur.execute('use intof_iot')
             cur.execute(get_sql())
@@ -76,11 +102,57 @@ def lambda_handler(event, context):
         print ('---- Exception ! ', e)
         return ('DB opertion failed')
         
+# {"Y":[[stamp,"01",T,H,I,L,P,R], ...]}: a batch of samples spooled by the device while it was offline;
+# T,H,I are null (None) for a failed sensor reading, in json as in a binary frame
+def insert_history(event):
+    topic_fragments = event['topic'].split('/')
+    rows = 0
+    with conn.cursor() as cur:
+        for (stamp, rel, tem, hum, hin, lig, pir, rad) in event['Y']:
+            if (stamp == 0 or None in (tem, hum, hin)):
+                print("-- Skipping a sample with unknown time or failed sensor")
+                continue
+            sqlstr = SQL_HISTORY.format (org=data['ORG'], gro=topic_fragments[-2], dev=topic_fragments[-1], rel=rel,
+                        tem=tem, hum=hum, hin=hin, lig=lig, pir=pir, rad=rad, stamp=stamp)
+            print (sqlstr)
+            cur.execute(sqlstr)
+            rows += 1
+        conn.commit()
+    return ("History rows inserted: {}".format(rows))
+    
+# {"W":{"N":window,"T":[n,min,max,mean,stddev,last]}}: statistics of one sensor over the window just reported;
+# the device sends "T", "H" and "L" in separate messages (a binary frame has all three). T and H are in tenths.
+def update_stats(event):
+    topic_fragments = event['topic'].split('/')
+    w = event['W']
+    cols = []
+    for (key, prefix) in STATS_COLUMNS.items():
+        if (key not in w):
+            continue
+        n, vmin, vmax, vmean, vstd, last = w[key]
+        values = [vmin, vmax, vmean, vstd]
+        if (n == 0):   # no valid reading in the window
+            values = ['NULL'] * 4
+        elif (key != 'L'):
+            values = [v/10.0 for v in values]
+        cols.append('{p}N={n},{p}Min={},{p}Max={},{p}Mean={},{p}Std={}'.format(*values, p=prefix, n=n))
+    if (len(cols) == 0 or 'N' not in w):
+        return ("Invalid window statistics")
+    sqlstr = SQL_STATS.format(cols=','.join(cols), gro=topic_fragments[-2], dev=topic_fragments[-1], win=w['N'])
+    print (sqlstr)
+    with conn.cursor() as cur:
+        rows = cur.execute(sqlstr)
+        conn.commit()
+    if (rows == 0):
+        print ("-- No data row for window ", w['N'])
+        return ("No data row for the window statistics")
+    return ("Window statistics stored")
+    
 def get_sql():
     # .format does not destroy the original string
     sqlstr = SQL.format (org=data['ORG'], gro=data['GRO'], dev=data['DEV'], rel=data['REL'],
                         tem=data['TEM'], hum=data['HUM'], hin=data['HIN'], lig=data['LIG'], 
-                        pir=data['PIR'], rad=data['RAD'])
+                        pir=data['PIR'], rad=data['RAD'], win=data['WIN'])
     print (sqlstr)
     return(sqlstr)
          
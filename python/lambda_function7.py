@@ -1,11 +1,14 @@
 # MySQL database access
 # Takes values from incoming MQTT trigger and inserts them into the DB
 # Trigger (new) :  SELECT *, topic() as topic FROM 'myorg/+/status/#'
+# Binary frames : SELECT encode(*, 'base64') AS bin, topic() AS topic FROM 'myorg/+/status/#'  (see frames.py)
 
 import sys
 #import logging
 import pymysql
 import json
+import boto3
+import frames
 
 rds_host = 'my.xxxxxxx.us-east-2.rds.amazonaws.com' 
 user_name = 'user'
@@ -15,9 +18,10 @@ port = 3306
 
 # Note how a long string can be split across multiple lines using brackets
 # Note how the double quotes can be retained all the way upto the SQL statement
-SQL = ('insert into IotEvent '
-       '(OrgId, GroupId, DeviceId, Relays, EventCode, EventText) '
-       'values ({org},"{gro}","{dev}","{rel}","{cod}", "{tex}")')
+# a retransmitted event is dropped by the unique key (DeviceId, Seq, BootId); see db/create8.sql
+SQL = ('insert ignore into IotEvent '
+       '(OrgId, GroupId, DeviceId, Relays, EventCode, EventText, Seq, BootId) '
+       'values ({org},"{gro}","{dev}","{rel}","{cod}", "{tex}", {seq}, {boot})')
 
 # place holder data object
 data = {
@@ -26,9 +30,22 @@ data = {
     "DEV" : "000000", 
     "REL" : "00",    # while rebooting, relay status will be 00
     "COD" : "X",
-    "TEX" : "X"
+    "TEX" : "X",
+    "SEQ" : "NULL",  # untracked events have no sequence number, and are never duplicates
+    "BOOT": "NULL"
 }
 
+# Events carrying a sequence number, {"K":12,"Z":3407,"S":"01"}, are acknowledged with {"K":12} on the device's
+# command topic once they are in the table; the device sends them again until then (see OfficeAuto4/outbox.h).
+# A retransmission whose acknowledgement was lost is acknowledged again, but not inserted twice: the table
+# has a unique key on the device, the sequence number and the boot id Z (the numbers start afresh on a boot).
+iot = boto3.client('iot-data')
+
+def acknowledge(event):
+    topic_fragments = event['topic'].split('/')
+    topic_fragments[2] = 'cmd'     # org/app/status/group/device -> org/app/cmd/group/device
+    iot.publish(topic='/'.join(topic_fragments), qos=0, payload=json.dumps({'K': event['K']}))
+
 # NOTE: better to put the connection handling at the top of the lambda file, so you can refer to it
 # from multiple functions
        
@@ -46,6 +63,7 @@ def lambda_handler(event, context):
         return ("DB connection failure")
     try:
         print(json.dumps(event))
+        event = frames.from_event(event)  # binary frames are decoded into the json shape
         if ('B' in event):      # todo: record 'I' packets also ? Or just show them on the UI ?
             print("-- 8266 restarted")
             data['COD'] = 'B'   # event code
@@ -60,14 +78,19 @@ def lambda_handler(event, context):
         # TODO: verify if the org_id in topic matches the org_id in session
         data['DEV'] = topic_fragments[-1] # device id
         data['GRO'] = topic_fragments[-2] # group id
+        data['SEQ'] = int(event['K']) if 'K' in event else 'NULL'
+        data['BOOT'] = int(event.get('Z', 0)) if 'K' in event else 'NULL'
         with conn.cursor() as cur:
             #cur.execute('use intof_iot')
-            cur.execute(get_sql())
+            if (cur.execute(get_sql()) == 0):
+                print("-- Retransmitted event")
             conn.commit()
             cur.execute("select count(*) from IotEvent")
             print ("-- Number of rows in table: ", end='')
             for row in cur:
                 print(row)
+        if ('K' in event):
+            acknowledge(event)
         return ("DB operation succeeded")
     except Exception as e:
         print ('---- Exception ! ', e)
@@ -76,7 +99,7 @@ def lambda_handler(event, context):
 def get_sql():
     # .format does not destroy the original string
     sqlstr = SQL.format (org=data['ORG'], gro=data['GRO'], dev=data['DEV'], 
-                         rel=data['REL'], cod=data['COD'], tex=data['TEX'])
+                         rel=data['REL'], cod=data['COD'], tex=data['TEX'], seq=data['SEQ'], boot=data['BOOT'])
     print (sqlstr)
     return(sqlstr)
     
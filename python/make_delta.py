@@ -0,0 +1,161 @@
+# Makes the delta between two firmware images of OfficeAuto4, for the delta OTA update (see OfficeAuto4/deltaPatcher.h)
+# Put the delta next to the full image on the OTA server; the device looks for <app_id>-<its version>.delta first,
+# and downloads <app_id>.bin when there is none. So make one delta per version still in the field.
+#
+# Usage: python make_delta.py old.bin new.bin --app myApp --base 10 --target 11 [--out folder]
+#        python make_delta.py --synthetic       (a dry run on generated images)
+# The delta is applied back to old.bin before it is written, and checked against new.bin.
+
+import os
+import sys
+import struct
+import random
+import hashlib
+import argparse
+
+MAGIC = b'ODP1'
+MIN_MATCH = 16        # shorter matches cost more as a copy (9 bytes) than as inserted bytes
+MAX_CANDIDATES = 8    # base offsets remembered for each block of MIN_MATCH bytes
+MAX_INSERT = 65535
+#-------------------------------------------------------
+
+def index_base (base):
+    # every offset of the base, keyed by the MIN_MATCH bytes that start there; the latest offsets are kept
+    table = {}
+    for offset in range(len(base) - MIN_MATCH + 1):
+        key = base[offset:offset+MIN_MATCH]
+        offsets = table.get(key)
+        if offsets is None:
+            table[key] = [offset]
+        elif len(offsets) < MAX_CANDIDATES:
+            offsets.append(offset)
+    return table
+
+def match_length (base, src, target, dest):
+    # length of the common run of base[src:] and target[dest:]; compared in slices first, for speed
+    length = 0
+    limit = min(len(base) - src, len(target) - dest)
+    step = 256
+    while step > 0:
+        while length + step <= limit and base[src+length:src+length+step] == target[dest+length:dest+length+step]:
+            length += step
+        step //= 4
+    return length
+
+def diff (base, target):
+    # greedy: the longest match at each position of the target; a run of unchanged code after a copy
+    # usually continues where the last copy ended, so that is tried first
+    table = index_base(base)
+    ops = []
+    pending = bytearray()
+    pos = 0
+    next_src = None
+    while pos < len(target):
+        best_src, best_len = None, 0
+        if next_src is not None and next_src < len(base):
+            best_src, best_len = next_src, match_length(base, next_src, target, pos)
+        if best_len < MIN_MATCH:
+            for src in table.get(target[pos:pos+MIN_MATCH], ()):
+                length = match_length(base, src, target, pos)
+                if length > best_len:
+                    best_src, best_len = src, length
+        if best_len < MIN_MATCH:
+            pending.append(target[pos])
+            pos += 1
+            continue
+        if pending:
+            ops.append(('I', bytes(pending)))
+            pending = bytearray()
+        ops.append(('C', best_src, best_len))
+        pos += best_len
+        next_src = best_src + best_len
+    if pending:
+        ops.append(('I', bytes(pending)))
+    return ops
+
+def encode (ops, base, target, base_version, target_version):
+    out = bytearray(MAGIC)
+    out += struct.pack('<HHII', base_version, target_version, len(base), len(target))
+    out += hashlib.md5(base).digest() + hashlib.md5(target).digest()
+    for op in ops:
+        if op[0] == 'C':
+            out += b'C' + struct.pack('<II', op[1], op[2])
+        else:
+            data = op[1]
+            for i in range(0, len(data), MAX_INSERT):
+                chunk = data[i:i+MAX_INSERT]
+                out += b'I' + struct.pack('<H', len(chunk)) + chunk
+    out += b'E'
+    return bytes(out)
+
+def apply (delta, base):
+    # what DeltaPatcher::apply() does on the device
+    if delta[:4] != MAGIC:
+        raise ValueError('not a delta file')
+    base_version, target_version, base_size, target_size = struct.unpack('<HHII', delta[4:16])
+    if base_size != len(base) or delta[16:32] != hashlib.md5(base).digest():
+        raise ValueError('the delta was made for a different base image')
+    out = bytearray()
+    pos = 48
+    while delta[pos:pos+1] != b'E':
+        if delta[pos:pos+1] == b'C':
+            offset, length = struct.unpack('<II', delta[pos+1:pos+9])
+            out += base[offset:offset+length]
+            pos += 9
+        elif delta[pos:pos+1] == b'I':
+            length, = struct.unpack('<H', delta[pos+1:pos+3])
+            out += delta[pos+3:pos+3+length]
+            pos += 3 + length
+        else:
+            raise ValueError('bad operation at {}'.format(pos))
+    if len(out) != target_size or hashlib.md5(out).digest() != delta[32:48]:
+        raise ValueError('the patched image does not match the target')
+    return bytes(out)
+
+def make_delta (base, target, base_version, target_version):
+    delta = encode(diff(base, target), base, target, base_version, target_version)
+    if apply(delta, base) != target:
+        raise ValueError('self check failed')
+    return delta
+
+def synthetic_images (seed=1):
+    # a 300 KB 'old' image, and a 'new' one with a few edits and an insertion that shifts the rest
+    rnd = random.Random(seed)
+    base = bytes(rnd.getrandbits(8) for _ in range(300000))
+    target = bytearray(base)
+    for _ in range(40):
+        at = rnd.randrange(len(target) - 64)
+        target[at:at+rnd.randrange(4, 64)] = bytes(rnd.getrandbits(8) for _ in range(rnd.randrange(4, 64)))
+    target[1000:1000] = bytes(rnd.getrandbits(8) for _ in range(2000))
+    return base, bytes(target)
+#-------------------------------------------------------
+
+if (__name__ == '__main__'):
+    parser = argparse.ArgumentParser(description='Make a delta OTA file for OfficeAuto4')
+    parser.add_argument('old', nargs='?', help='the .bin of the version installed on the devices')
+    parser.add_argument('new', nargs='?', help='the .bin of the new version')
+    parser.add_argument('--app', default='', help='app_id; the delta is named <app>-<base>.delta')
+    parser.add_argument('--base', type=int, default=0, help='FIRMWARE_VERSION of the old image')
+    parser.add_argument('--target', type=int, default=0, help='FIRMWARE_VERSION of the new image')
+    parser.add_argument('--out', default='.', help='output folder')
+    parser.add_argument('--synthetic', action='store_true', help='dry run on generated images')
+    args = parser.parse_args()
+
+    if args.synthetic:
+        base, target = synthetic_images()
+    elif args.old and args.new and args.app:
+        with open(args.old, 'rb') as f:
+            base = f.read()
+        with open(args.new, 'rb') as f:
+            target = f.read()
+    else:
+        parser.print_usage()
+        sys.exit(0)
+    delta = make_delta(base, target, args.base, args.target)
+    print ('base: {} bytes, target: {} bytes, delta: {} bytes ({:.1f}% of the full image)'
+           .format(len(base), len(target), len(delta), 100.0*len(delta)/len(target)))
+    if not args.synthetic:
+        file_name = os.path.join(args.out, '{}-{}.delta'.format(args.app, args.base))
+        with open(file_name, 'wb') as f:
+            f.write(delta)
+        print ('written: ' + file_name)
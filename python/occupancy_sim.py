@@ -0,0 +1,277 @@
+# Virtual time simulator for the occupancy / day-night logic in OfficeAuto4/Main.ino
+# Replays a recorded PIR/radar/LDR trace through on_motion(), ten_second_logic() and one_minute_logic()
+# without any hardware, so that auto_off_minutes, check_interval and radar_triggers can be tuned offline.
+#
+# Trace file: CSV, one line per change of sensor state (sample and hold), optional header line:
+#     time,pir,radar,light
+# time is either seconds from the start of the trace, or 'YYYY-MM-DD HH:MM:SS'.
+# light is the value reported in the "L" field of the data message (0=dark, 1023=bright).
+#
+# Usage: python occupancy_sim.py trace.csv [--start "2020-05-01 00:00"] [--auto-off 1.5,3,5]
+#        python occupancy_sim.py --synthetic 7        (one week of generated data, for a dry run)
+
+import sys
+import csv
+import time
+import random
+import argparse
+from datetime import datetime, timedelta
+
+# defaults mirror settings.h and config.h
+SENSOR_INTERVAL = 60000   # msec
+CHECK_INTERVAL = 10000    # msec
+STATUS_FREQUENCY = 5      # minutes
+AUTO_OFF_TIME_MIN = 1.5
+NIGHT_HOURS = (18, 0, 6, 30)   # start hour, start minute, end hour, end minute
+DAY_LIGHT_THRESHOLD = 300
+NIGHT_LIGHT_THRESHOLD = 100
+MAX_LIGHT = 1024
+NOISE_THRESHOLD = 10
+
+TIME_DAY, TIME_NIGHT, TIME_UNKNOWN = 0, 1, 2
+#-------------------------------------------------------
+
+def read_trace (file_name):
+    # returns a list of (msec, pir, radar, light) and the absolute start time, if the trace had one
+    rows = []
+    start = None
+    with open(file_name) as f:
+        for rec in csv.reader(f):
+            if not rec or rec[0].strip().lower() == 'time':
+                continue
+            stamp = rec[0].strip()
+            try:
+                sec = float(stamp)
+            except ValueError:
+                t = datetime.strptime(stamp, '%Y-%m-%d %H:%M:%S')
+                if start is None:
+                    start = t
+                sec = (t - start).total_seconds()
+            rows.append((int(sec*1000), int(rec[1]), int(rec[2]), int(rec[3])))
+    rows.sort()
+    return rows, start
+
+def make_synthetic_trace (days, seed=1):
+    # a person visits the room a few times a night; PIR fires in short bursts, radar stays on during the visit
+    rnd = random.Random(seed)
+    rows = []
+    t = 0
+    end = days*24*3600*1000
+    while t < end:
+        t += int(rnd.expovariate(1/(90*60.0))*1000)  # on average one visit in 90 minutes
+        hour = (t//3600000) % 24
+        light = 50 if (hour >= 18 or hour < 6) else 600
+        stay = int(rnd.uniform(1, 12)*60000)
+        leave = t + stay
+        while t < leave:
+            rows.append((t, 1, 1, light))
+            t += int(rnd.uniform(2, 6)*1000)
+            rows.append((t, 0, 1, light))
+            t += int(rnd.uniform(3, 50)*1000)
+        rows.append((t, 0, 0, light))
+    return rows
+#-------------------------------------------------------
+
+class Device:
+    # the state and logic of Main.ino, one method per Timer callback
+    def __init__(self, args, auto_off, start):
+        self.args = args
+        self.start = start
+        self.max_buckets = int(auto_off*60 / (args.check_interval/1000))  # Config::get_auto_off_ticks()
+        self.leaky_bucket = 10
+        self.occupied = False
+        self.is_night = True
+        self.sensor_reading_count = 0
+        self.light_on = False
+        self.pir = self.radar = 0
+        self.light = 0
+        # statistics
+        self.on_since = 0
+        self.on_time = 0
+        self.latencies = []
+        self.motion_since = None     # trace time at which a trigger-capable motion started
+        self.last_motion = 0         # trace time at which the last motion ended
+        self.vacancy_flagged = False
+        self.missed_vacancies = 0
+        self.premature_offs = 0
+        self.last_off = None
+        self.wasted_time = 0
+
+    def is_night_time (self, now, light_based):
+        if light_based:
+            lite = self.light
+            if lite > (MAX_LIGHT-NOISE_THRESHOLD):
+                return TIME_UNKNOWN
+            if lite < self.args.night_light:
+                return TIME_NIGHT
+            if lite > self.args.day_light:
+                return TIME_DAY
+            return TIME_UNKNOWN
+        t = self.start + timedelta(milliseconds=now)
+        nsh, nsm, neh, nem = self.args.night_hours
+        if t.hour > nsh or t.hour < neh:
+            return TIME_NIGHT
+        if t.hour == nsh and t.minute >= nsm:
+            return TIME_NIGHT
+        if t.hour == neh and t.minute <= nem:
+            return TIME_NIGHT
+        return TIME_DAY
+
+    def check_day_or_night (self, now):
+        code = self.is_night_time(now, self.args.light_based)
+        if code == TIME_NIGHT:
+            self.is_night = True
+        elif code == TIME_DAY:
+            self.is_night = False
+
+    def switch (self, now, on):
+        if on == self.light_on:
+            return
+        self.light_on = on
+        if on:
+            self.on_since = now
+            if self.last_off is not None and now - self.last_off <= self.args.grace*1000:
+                self.premature_offs += 1   # the light went off on somebody who was still there
+        else:
+            self.on_time += now - self.on_since
+            self.last_off = now
+            if self.pir == 0 and self.radar == 0:
+                self.wasted_time += now - max(self.last_motion, self.on_since)
+
+    def sense (self, now, pir, radar, light):
+        # a change in the trace; the firmware gets an interrupt for it
+        if (pir or radar) and not (self.pir or self.radar):
+            self.vacancy_flagged = False
+        if not (pir or radar) and (self.pir or self.radar):
+            self.last_motion = now
+        trigger = pir and (radar or not self.args.radar_triggers)
+        if trigger and self.motion_since is None:
+            self.motion_since = now
+        if not trigger:
+            self.motion_since = None
+        self.pir, self.radar, self.light = pir, radar, light
+
+    def on_motion (self, now):
+        if not (self.pir or self.radar):
+            return
+        if not self.is_night:
+            return
+        self.leaky_bucket = self.max_buckets
+        if self.occupied:
+            return
+        trigger_cue = self.pir
+        if self.args.radar_triggers:
+            trigger_cue = trigger_cue and self.radar
+        if trigger_cue:
+            self.occupied = True
+            if self.motion_since is not None:
+                self.latencies.append(now - self.motion_since)
+            self.switch(now, True)
+
+    def ten_second_logic (self, now):
+        if not self.is_night:
+            return
+        if self.pir or self.radar:
+            self.on_motion(now)
+            return    # the bucket is full again; as in Main.ino, it does not leak in the same tick
+        self.leaky_bucket -= 1
+        if self.leaky_bucket > 0:
+            return
+        self.leaky_bucket = self.max_buckets
+        if self.occupied:
+            self.occupied = False
+            self.switch(now, False)
+
+    def one_minute_logic (self, now):
+        self.sensor_reading_count += 1
+        if self.sensor_reading_count < self.args.status_frequency:
+            return
+        self.sensor_reading_count = 0
+        self.check_day_or_night(now)
+        if not self.is_night and self.occupied:   # handle_transition()
+            self.occupied = False
+            self.switch(now, False)
+
+    def watch_vacancy (self, now, auto_off_ms):
+        # a vacancy that outlived the auto off period by more than one check interval was missed
+        if not self.light_on or self.pir or self.radar or self.vacancy_flagged:
+            return
+        if now - max(self.last_motion, self.on_since) > auto_off_ms + self.args.check_interval:
+            self.missed_vacancies += 1
+            self.vacancy_flagged = True
+#-------------------------------------------------------
+
+def simulate (trace, args, auto_off, start):
+    dev = Device(args, auto_off, start)
+    auto_off_ms = auto_off*60000
+    # run on past the last trace line, long enough for the bucket to leak out
+    end = trace[-1][0] + int(auto_off_ms) + 2*args.check_interval if trace else 0
+    dev.check_day_or_night(0)   # init_cloud(): priming read from the time server
+    next_minute, next_check = args.sensor_interval, args.check_interval
+    index = 0
+    while True:
+        # the earliest event: a sensor edge, or a Timer event; on a tie the edge is handled first (the loop
+        # checks motion_pending() before T.update()), then the Timer events in the order of registration
+        now = min(next_minute, next_check)
+        if index < len(trace):
+            now = min(now, trace[index][0])
+        if now > end:
+            break
+        if index < len(trace) and trace[index][0] == now:
+            while index < len(trace) and trace[index][0] == now:
+                dev.sense(*trace[index])
+                index += 1
+            dev.on_motion(now)
+        if now == next_minute:
+            dev.one_minute_logic(now)
+            next_minute += args.sensor_interval
+        if now == next_check:
+            dev.ten_second_logic(now)
+            next_check += args.check_interval
+        dev.watch_vacancy(now, auto_off_ms)
+    if dev.light_on:
+        dev.switch(end, False)
+    return dev, end
+
+def report (dev, end, auto_off, wall):
+    lat = dev.latencies
+    print ('auto off: {:5.2f} min | relay on: {:7.1f} min ({:4.1f}%) | wasted: {:6.1f} min | '
+           'latency avg/max: {:5.0f}/{:5.0f} ms | missed vacancies: {:3d} | premature offs: {:3d} | speed: {:.0f}x'
+           .format(auto_off, dev.on_time/60000.0, 100.0*dev.on_time/max(end, 1), dev.wasted_time/60000.0,
+                   sum(lat)/len(lat) if lat else 0, max(lat) if lat else 0,
+                   dev.missed_vacancies, dev.premature_offs, end/1000.0/max(wall, 1e-6)))
+#-------------------------------------------------------
+
+if (__name__ == '__main__'):
+    parser = argparse.ArgumentParser(description='Replay sensor traces through the occupancy logic')
+    parser.add_argument('trace', nargs='?', help='CSV trace file: time,pir,radar,light')
+    parser.add_argument('--synthetic', type=int, default=0, help='generate a trace of this many days instead')
+    parser.add_argument('--start', default=None, help='wall clock time of the first trace line: "YYYY-MM-DD HH:MM"')
+    parser.add_argument('--auto-off', default=str(AUTO_OFF_TIME_MIN), help='minutes; a comma separated list sweeps the values')
+    parser.add_argument('--check-interval', type=int, default=CHECK_INTERVAL, help='msec')
+    parser.add_argument('--sensor-interval', type=int, default=SENSOR_INTERVAL, help='msec')
+    parser.add_argument('--status-frequency', type=int, default=STATUS_FREQUENCY, help='minutes')
+    parser.add_argument('--radar-triggers', type=int, default=0, help='1: both PIR and radar must fire')
+    parser.add_argument('--night-hours', type=int, nargs=4, default=NIGHT_HOURS, help='start hr, start min, end hr, end min')
+    parser.add_argument('--light-based', action='store_true', help='no time server: decide day/night from the LDR')
+    parser.add_argument('--day-light', type=int, default=DAY_LIGHT_THRESHOLD)
+    parser.add_argument('--night-light', type=int, default=NIGHT_LIGHT_THRESHOLD)
+    parser.add_argument('--grace', type=int, default=30, help='seconds; motion this soon after an OFF is a premature off')
+    args = parser.parse_args()
+
+    if args.synthetic > 0:
+        trace, start = make_synthetic_trace(args.synthetic), None
+    elif args.trace:
+        trace, start = read_trace(args.trace)
+    else:
+        parser.print_usage()
+        sys.exit(0)
+    if args.start:
+        start = datetime.strptime(args.start, '%Y-%m-%d %H:%M')
+    if start is None:
+        start = datetime(2020, 5, 1)
+    print ('Trace: {} events, {:.1f} hours, starting {}'.format(len(trace), (trace[-1][0] if trace else 0)/3600000.0, start))
+    for auto_off in [float(a) for a in args.auto_off.split(',')]:
+        t0 = time.time()
+        dev, end = simulate(trace, args, auto_off, start)
+        report(dev, end, auto_off, time.time()-t0)
@@ -7,6 +7,10 @@ MyFi::MyFi() {
  
 bool MyFi::init(Config* configptr) {
     this->pC = configptr;
+    if (fast_connect()) {
+        dump ();
+        return true;
+    }
     
     WiFi.mode(WIFI_OFF);  // Prevents reconnection issue (taking too long to connect) *****
     delay(1000);
@@ -45,10 +49,62 @@ bool MyFi::init(Config* configptr) {
     WiFi.config(ip,gateway,subnet);
     *------------------***/
     SERIAL_PRINTLN ("!\nWi-Fi connected.");  
+    save_association();
     dump ();
     return true; 
 } 
 
+// Connects straight to the access point of the last session, on its channel: no scan. The address comes
+// from DHCP as usual. On failure, the caller goes on to the full WiFiMulti scan.
+bool MyFi::fast_connect() {
+    wifi_record rec;
+    if (!rtc_load(RTC_SLOT_WIFI, &rec, sizeof(rec)))
+        return false;
+    const char* ssid = pC->wifi_ssid1;
+    const char* password = pC->wifi_password1;
+    if (rec.ap == 2) {
+        ssid = pC->wifi_ssid2;
+        password = pC->wifi_password2;
+    } else if (rec.ap == 3) {
+        ssid = pC->wifi_ssid3;
+        password = pC->wifi_password3;
+    }
+    SERIAL_PRINT("MyFi: Fast connect to ");
+    SERIAL_PRINTLN(ssid);
+    unsigned long start = millis();
+    WiFi.persistent(false);  // the BSSID and channel need not be written to flash on every boot
+    WiFi.mode(WIFI_STA);
+    wifi_set_sleep_type(NONE_SLEEP_T);
+    WiFi.begin(ssid, password, rec.channel, rec.bssid, true);
+    while (WiFi.status() != WL_CONNECTED) {
+        if (millis() - start > FAST_CONNECT_TIMEOUT) {
+            SERIAL_PRINTLN("MyFi: Fast connect failed; scanning..");
+            rtc_clear(RTC_SLOT_WIFI);
+            WiFi.disconnect();
+            WiFi.persistent(true);
+            return false;
+        }
+        delay(10);
+    }
+    WiFi.persistent(true);
+    save_association();  // the access point may have moved to another channel
+    SERIAL_PRINT("MyFi: Connected in mSec: ");
+    SERIAL_PRINTLN(millis() - start);
+    return true;
+}
+
+void MyFi::save_association() {
+    wifi_record rec;
+    memcpy (rec.bssid, WiFi.BSSID(), sizeof(rec.bssid));
+    rec.channel = WiFi.channel();
+    rec.ap = 1;
+    if (WiFi.SSID() == pC->wifi_ssid2)
+        rec.ap = 2;
+    else if (WiFi.SSID() == pC->wifi_ssid3)
+        rec.ap = 3;
+    rtc_save(RTC_SLOT_WIFI, &rec, sizeof(rec));
+}
+
 bool MyFi::isConnected() {
     return (WiFi.status() == WL_CONNECTED); 
 }
@@ -90,8 +146,10 @@ bool MyFi::reconnect () {
     }
     SERIAL_PRINT("MyFi: Wifi connected? : "); 
     SERIAL_PRINTLN(connected);    
-    if (connected)
+    if (connected) {
+        save_association();
         dump();  
+    }
     return(connected);
 }
 
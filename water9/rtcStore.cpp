@@ -0,0 +1,46 @@
+// rtcStore.cpp
+
+#include "rtcStore.h"
+
+#define  RTC_MAX_RECORD  128   // bytes; the largest record any slot holds
+
+// CRC-32 (the zlib polynomial), bit by bit: the records are small and rarely written
+static uint32_t crc32 (const byte* data, short length, uint32_t seed) {
+    uint32_t crc = ~seed;
+    for (short i=0; i<length; i++) {
+        crc ^= data[i];
+        for (byte b=0; b<8; b++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// the size goes into the seed, so that a record of another size does not pass the check
+bool rtc_load (short slot, void* record, short size) {
+    uint32_t buffer[1 + RTC_MAX_RECORD/4];
+    short blocks = (size+3)/4;
+    if (size > RTC_MAX_RECORD || slot + 1 + blocks > RTC_USER_BLOCKS)
+        return false;
+    if (!ESP.rtcUserMemoryRead(slot, buffer, 4*(1+blocks)))
+        return false;
+    if (buffer[0] != crc32((const byte*)&buffer[1], size, size))
+        return false;
+    memcpy (record, &buffer[1], size);
+    return true;
+}
+
+bool rtc_save (short slot, const void* record, short size) {
+    uint32_t buffer[1 + RTC_MAX_RECORD/4];
+    short blocks = (size+3)/4;
+    if (size > RTC_MAX_RECORD || slot + 1 + blocks > RTC_USER_BLOCKS)
+        return false;
+    buffer[blocks] = 0;  // the padding of the last block
+    memcpy (&buffer[1], record, size);
+    buffer[0] = crc32((const byte*)&buffer[1], size, size);
+    return ESP.rtcUserMemoryWrite(slot, buffer, 4*(1+blocks));
+}
+
+void rtc_clear (short slot) {
+    uint32_t zero = 0;   // a zero CRC over a non empty record is practically never valid
+    ESP.rtcUserMemoryWrite(slot, &zero, 4);
+}